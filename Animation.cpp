@@ -0,0 +1,124 @@
+#include "Animation.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+//---------------------------------------------------------------------------------------
+AnimationClip::AnimationClip()
+	: m_trackBegin(1, 0),
+	  m_duration(0.0f)
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+void AnimationClip::reset(size_t numJoints) {
+	m_trackBegin.assign(numJoints + 1, 0);
+	m_times.clear();
+	m_angles.clear();
+	m_cursors.assign(numJoints, 0);
+	m_duration = 0.0f;
+}
+
+//---------------------------------------------------------------------------------------
+void AnimationClip::setKeys(float time, const Pose & pose) {
+	if (pose.numJoints() != numTracks()) {
+		return;
+	}
+
+	// Merge one new key into every track while copying the clip once.
+	vector<float> times;
+	vector<float> angles;
+	times.reserve(m_times.size() + numTracks());
+	angles.reserve(m_angles.size() + 2 * numTracks());
+	for (size_t t = 0; t < numTracks(); ++t) {
+		const uint32_t begin = m_trackBegin[t];
+		const uint32_t end = m_trackBegin[t + 1];
+		const uint32_t split = uint32_t(lower_bound(m_times.begin() + begin,
+				m_times.begin() + end, time) - m_times.begin());
+		const uint32_t rest = (split < end && m_times[split] == time) ? split + 1 : split;
+
+		m_trackBegin[t] = uint32_t(times.size());
+		times.insert(times.end(), m_times.begin() + begin, m_times.begin() + split);
+		angles.insert(angles.end(), m_angles.begin() + 2 * begin, m_angles.begin() + 2 * split);
+		times.push_back(time);
+		angles.push_back(pose.angles[2 * t]);
+		angles.push_back(pose.angles[2 * t + 1]);
+		times.insert(times.end(), m_times.begin() + rest, m_times.begin() + end);
+		angles.insert(angles.end(), m_angles.begin() + 2 * rest, m_angles.begin() + 2 * end);
+	}
+	m_trackBegin[numTracks()] = uint32_t(times.size());
+	m_times.swap(times);
+	m_angles.swap(angles);
+	m_cursors.assign(numTracks(), 0);
+	m_duration = max(m_duration, time);
+}
+
+//---------------------------------------------------------------------------------------
+void AnimationClip::setKey(size_t joint, float time, float angleY, float angleZ) {
+	if (joint >= numTracks()) {
+		return;
+	}
+	const uint32_t begin = m_trackBegin[joint];
+	const uint32_t end = m_trackBegin[joint + 1];
+	const uint32_t key = uint32_t(lower_bound(m_times.begin() + begin,
+			m_times.begin() + end, time) - m_times.begin());
+	if (key < end && m_times[key] == time) {
+		m_angles[2 * key] = angleY;
+		m_angles[2 * key + 1] = angleZ;
+		return;
+	}
+
+	m_times.insert(m_times.begin() + key, time);
+	const float keyAngles[2] = { angleY, angleZ };
+	m_angles.insert(m_angles.begin() + 2 * key, keyAngles, keyAngles + 2);
+	for (size_t t = joint + 1; t <= numTracks(); ++t) {
+		++m_trackBegin[t];
+	}
+	m_cursors[joint] = 0;
+	m_duration = max(m_duration, time);
+}
+
+//---------------------------------------------------------------------------------------
+void AnimationClip::evaluate(float time, Pose & pose) {
+	if (pose.numJoints() != numTracks()) {
+		return;
+	}
+	const float * times = m_times.data();
+	const float * angles = m_angles.data();
+	float * out = pose.angles.data();
+
+	for (size_t t = 0; t < numTracks(); ++t) {
+		const uint32_t begin = m_trackBegin[t];
+		const uint32_t numKeys = m_trackBegin[t + 1] - begin;
+		if (numKeys == 0) {
+			continue;
+		}
+		const float * trackTimes = times + begin;
+
+		// Key at or before time, or 0 when time precedes every key.
+		uint32_t key = m_cursors[t];
+		if (key + 1 < numKeys && time >= trackTimes[key + 1]) {
+			++key;
+			if (key + 1 < numKeys && time >= trackTimes[key + 1]) {
+				key = uint32_t(upper_bound(trackTimes + key, trackTimes + numKeys, time)
+						- trackTimes) - 1;
+			}
+		} else if (time < trackTimes[key] && key > 0) {
+			key = uint32_t(upper_bound(trackTimes, trackTimes + key, time) - trackTimes);
+			key = key > 0 ? key - 1 : 0;
+		}
+		m_cursors[t] = key;
+
+		const float * a = angles + 2 * (begin + key);
+		if (key + 1 == numKeys || time <= trackTimes[key]) {
+			out[2 * t] = a[0];
+			out[2 * t + 1] = a[1];
+		} else {
+			const float s = (time - trackTimes[key]) / (trackTimes[key + 1] - trackTimes[key]);
+			out[2 * t] = a[0] + s * (a[2] - a[0]);
+			out[2 * t + 1] = a[1] + s * (a[3] - a[1]);
+		}
+	}
+}
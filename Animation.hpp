@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Pose.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Keyframe tracks for the joints of a JointTable: y and z angles over time, linearly
+// interpolated and held constant before the first and after the last key.  The keys of
+// every track live in two contiguous arrays, track after track, so evaluating all
+// joints at one time is a single forward pass over memory.
+class AnimationClip {
+public:
+	AnimationClip();
+
+	// Drop every key and size the clip for numJoints tracks.
+	void reset(size_t numJoints);
+
+	size_t numTracks() const { return m_cursors.size(); }
+	size_t numKeys() const { return m_times.size(); }
+
+	// Time of the latest key in seconds, 0 without keys.
+	float duration() const { return m_duration; }
+
+	// Key every joint at time with the angles of pose, replacing keys already at time.
+	// One pass over the whole clip, whatever its number of tracks.
+	void setKeys(float time, const Pose & pose);
+
+	// Key a single joint.  Shifts the keys of every later track.
+	void setKey(size_t joint, float time, float angleY, float angleZ);
+
+	// Write the angles of every track with keys at time into pose, which must be sized
+	// for numTracks() joints.  Tracks without keys leave pose alone.  Each track keeps a
+	// cursor on the key last used, so playback that moves forward from one call to the
+	// next mostly steps a key at a time; other times fall back to a binary search.
+	void evaluate(float time, Pose & pose);
+
+private:
+	// Keys of track t are [m_trackBegin[t], m_trackBegin[t + 1]), sorted by time.
+	std::vector<uint32_t> m_trackBegin;
+	std::vector<float> m_times;
+	std::vector<float> m_angles;          // Two per key, y then z, as in Pose
+	std::vector<uint32_t> m_cursors;      // Per track, key at or before the last time
+	float m_duration;
+};
@@ -0,0 +1,127 @@
+#include "AnimationBenchmark.hpp"
+
+#include "Animation.hpp"
+#include "BenchmarkTiming.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+namespace {
+
+const float SecondsPerKey = 0.5f;
+const float FrameSeconds = 1.0f / 60.0f;
+const float Tolerance = 1e-3f;
+
+// Generated angles of key k of joint j, in degrees.
+float keyAngleY(unsigned int j, unsigned int k) {
+	return 45.0f * sin(0.37f * j + 1.3f * k);
+}
+
+float keyAngleZ(unsigned int j, unsigned int k) {
+	return 30.0f * cos(0.11f * j + 0.7f * k);
+}
+
+// Largest difference between pose and the clip's angles at time.
+float maxError(const Pose & pose, unsigned int numJoints, unsigned int keysPerTrack,
+		float time) {
+	float position = min(max(time / SecondsPerKey, 0.0f), float(keysPerTrack - 1));
+	unsigned int k = min(unsigned(position), keysPerTrack - 1);
+	unsigned int next = min(k + 1, keysPerTrack - 1);
+	float s = position - float(k);
+
+	float error = 0.0f;
+	for (unsigned int j = 0; j < numJoints; ++j) {
+		float y = keyAngleY(j, k) + s * (keyAngleY(j, next) - keyAngleY(j, k));
+		float z = keyAngleZ(j, k) + s * (keyAngleZ(j, next) - keyAngleZ(j, k));
+		error = max(error, max(abs(pose.angles[2 * j] - y), abs(pose.angles[2 * j + 1] - z)));
+	}
+	return error;
+}
+
+// Best time over repetitions of evaluating clip at every time, in seconds.  A separate,
+// untimed pass then checks every result against the keys.
+double timeEvaluation(AnimationClip & clip, const vector<float> & times,
+		unsigned int repetitions, unsigned int keysPerTrack, Pose & pose, float & error) {
+	const unsigned int numJoints = unsigned(clip.numTracks());
+	double best = bestTime([&]() {
+		for (float time : times) {
+			clip.evaluate(time, pose);
+		}
+	}, repetitions);
+
+	error = 0.0f;
+	for (float time : times) {
+		clip.evaluate(time, pose);
+		error = max(error, maxError(pose, numJoints, keysPerTrack, time));
+	}
+	return best;
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+int runAnimationBenchmark(unsigned int numJoints, unsigned int keysPerTrack,
+		unsigned int repetitions) {
+	numJoints = max(numJoints, 1u);
+	keysPerTrack = max(keysPerTrack, 2u);
+	repetitions = max(repetitions, 1u);
+
+	AnimationClip clip;
+	clip.reset(numJoints);
+	Pose pose;
+	pose.angles.resize(2 * size_t(numJoints));
+	for (unsigned int k = 0; k < keysPerTrack; ++k) {
+		for (unsigned int j = 0; j < numJoints; ++j) {
+			pose.angles[2 * j] = keyAngleY(j, k);
+			pose.angles[2 * j + 1] = keyAngleZ(j, k);
+		}
+		clip.setKeys(SecondsPerKey * k, pose);
+	}
+
+	// Two loops through the clip frame by frame, and as many random times.
+	vector<float> playbackTimes;
+	for (unsigned int loop = 0; loop < 2; ++loop) {
+		for (float time = 0.0f; time <= clip.duration(); time += FrameSeconds) {
+			playbackTimes.push_back(time);
+		}
+	}
+	vector<float> randomTimes(playbackTimes.size());
+	mt19937 random(488);
+	uniform_real_distribution<float> anyTime(-SecondsPerKey, clip.duration() + SecondsPerKey);
+	for (float & time : randomTimes) {
+		time = anyTime(random);
+	}
+
+	cout << "Evaluating " << numJoints << " joints with " << keysPerTrack << " keys each ("
+		 << clip.duration() << " s), best of " << repetitions << " repetition(s)" << endl;
+	cout << left << setw(12) << "times" << right
+		 << setw(12) << "evaluations"
+		 << setw(16) << "us/evaluation"
+		 << setw(20) << "joints/s"
+		 << setw(14) << "60 FPS frame"
+		 << setw(12) << "max error" << endl;
+
+	bool allMatched = true;
+	const vector<float> * sets[2] = { &playbackTimes, &randomTimes };
+	const char * names[2] = { "playback", "random" };
+	for (int i = 0; i < 2; ++i) {
+		float error;
+		double seconds = timeEvaluation(clip, *sets[i], repetitions, keysPerTrack, pose, error);
+		double perEvaluation = seconds / double(sets[i]->size());
+		allMatched = allMatched && error <= Tolerance;
+
+		cout << left << setw(12) << names[i] << right << fixed
+			 << setw(12) << sets[i]->size()
+			 << setw(16) << setprecision(2) << perEvaluation * 1e6
+			 << setw(20) << setprecision(0) << numJoints / perEvaluation
+			 << setw(13) << setprecision(2) << 100.0 * perEvaluation / FrameSeconds << "%"
+			 << setw(12) << setprecision(6) << error
+			 << (error <= Tolerance ? "" : "  MISMATCH") << endl;
+	}
+	return allMatched ? 0 : 1;
+}
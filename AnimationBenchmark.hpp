@@ -0,0 +1,9 @@
+#pragma once
+
+// Evaluate a generated AnimationClip of numJoints tracks with keysPerTrack keys each,
+// both as 60 FPS playback (cursor steps) and at random times (binary searches).  Reports
+// joints evaluated per second, best of repetitions, and the share of a 60 FPS frame one
+// evaluation takes.  Checks every evaluated angle against the expected interpolation.
+// Returns 0 if all matched, 1 otherwise.
+int runAnimationBenchmark(unsigned int numJoints, unsigned int keysPerTrack,
+		unsigned int repetitions);
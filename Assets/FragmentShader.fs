@@ -1,9 +1,5 @@
 #version 330
 
-
-
-uniform bool picking;       // When true, render with the flat picking color.
-
 struct LightSource {
 	vec3 position;
 	vec3 rgbIntensity;
@@ -57,10 +53,6 @@ vec3 phongModel(vec3 fragPosition, vec3 fragNormal) {
 }
 
 void main() {
-    if( picking ) {
-		fragColour = vec4(material.kd, 1.0);
-	} else {
-	    fragColour = vec4(phongModel(fs_in.position_ES, fs_in.normal_ES), 1.0);
-    }
+    fragColour = vec4(phongModel(fs_in.position_ES, fs_in.normal_ES), 1.0);
 }
 
@@ -0,0 +1,11 @@
+#version 330
+
+// SceneNode::m_nodeId of the GeometryNode being drawn, written unconverted into the
+// GL_R32UI attachment of the ID buffer.
+uniform uint nodeId;
+
+out uint fragNodeId;
+
+void main() {
+	fragNodeId = nodeId;
+}
@@ -0,0 +1,12 @@
+#version 330
+
+// Model-Space coordinates.  With a compact vertex format, position is normalized
+// inside the mesh bounds and the ModelView matrix undoes that.
+in vec3 position;
+
+uniform mat4 ModelView;
+uniform mat4 Perspective;
+
+void main() {
+	gl_Position = Perspective * ModelView * vec4(position, 1.0);
+}
@@ -0,0 +1,72 @@
+#version 430
+// Model-Space coordinates.  With a compact vertex format, position is normalized
+// inside the mesh bounds (the ModelView matrix undoes that) and normal holds the
+// two octahedral components.
+in vec3 position;
+in vec3 normal;
+
+// Index of this draw's record in draws[].  Sourced from a per-instance attribute, so
+// it equals the baseInstance of the indirect command plus the instance number.
+in uint drawIndex;
+
+struct DrawData {
+	mat4 modelView;
+	mat3 normalMatrix;   // transpose(inverse(ModelView))
+	vec4 kd;
+	vec4 ks;             // w = shininess
+};
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+	DrawData draws[];
+};
+
+struct LightSource {
+    vec3 position;
+    vec3 rgbIntensity;
+};
+uniform LightSource light;
+
+uniform mat4 Perspective;
+
+// Scale applied to octahedral-encoded normals, 0 when normals are plain floats.
+uniform float octNormalScale;
+
+// Must match VertexCompression::octDecode().  Not normalized, the caller does that
+// after transforming.
+vec3 decodeNormal(vec3 n) {
+	if (octNormalScale == 0.0) {
+		return n;
+	}
+	vec2 e = clamp(n.xy * octNormalScale, -1.0, 1.0);
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0) {
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return v;
+}
+
+out VsOutFsIn {
+	vec3 position_ES; // Eye-space position
+	vec3 normal_ES;   // Eye-space normal
+	LightSource light;
+	flat vec3 kd;
+	flat vec3 ks;
+	flat float shininess;
+} vs_out;
+
+
+void main() {
+	DrawData draw = draws[drawIndex];
+	vec4 pos4 = vec4(position, 1.0);
+
+	//-- Convert position and normal to Eye-Space:
+	vs_out.position_ES = (draw.modelView * pos4).xyz;
+	vs_out.normal_ES = normalize(draw.normalMatrix * decodeNormal(normal));
+
+	vs_out.light = light;
+	vs_out.kd = draw.kd.rgb;
+	vs_out.ks = draw.ks.rgb;
+	vs_out.shininess = draw.ks.w;
+
+	gl_Position = Perspective * draw.modelView * pos4;
+}
@@ -0,0 +1,52 @@
+#version 330
+
+struct LightSource {
+	vec3 position;
+	vec3 rgbIntensity;
+};
+
+in VsOutFsIn {
+	vec3 position_ES;
+	vec3 normal_ES;
+	LightSource light;
+	flat vec3 kd;
+	flat vec3 ks;
+	flat float shininess;
+} fs_in;
+
+out vec4 fragColour;
+
+// Ambient light intensity for each RGB component.
+uniform vec3 ambientIntensity;
+
+
+vec3 phongModel(vec3 fragPosition, vec3 fragNormal) {
+	LightSource light = fs_in.light;
+
+    // Direction from fragment to light source.
+    vec3 l = normalize(light.position - fragPosition);
+
+    // Direction from fragment to viewer (origin - fragPosition).
+    vec3 v = normalize(-fragPosition.xyz);
+
+    float n_dot_l = max(dot(fragNormal, l), 0.0);
+
+	vec3 diffuse;
+	diffuse = fs_in.kd * n_dot_l;
+
+    vec3 specular = vec3(0.0);
+
+    if (n_dot_l > 0.0) {
+		// Halfway vector.
+		vec3 h = normalize(v + l);
+        float n_dot_h = max(dot(fragNormal, h), 0.0);
+
+        specular = fs_in.ks * pow(n_dot_h, fs_in.shininess);
+    }
+
+    return ambientIntensity + light.rgbIntensity * (diffuse + specular);
+}
+
+void main() {
+    fragColour = vec4(phongModel(fs_in.position_ES, fs_in.normal_ES), 1.0);
+}
@@ -0,0 +1,63 @@
+#version 330
+// Model-Space coordinates.  With a compact vertex format, position is normalized
+// inside the mesh bounds (the ModelView matrix undoes that) and normal holds the
+// two octahedral components.
+in vec3 position;
+in vec3 normal;
+
+// Per-instance attributes, one set per GeometryNode.
+in mat4 instanceModelView;
+in mat3 instanceNormalMatrix;   // transpose(inverse(ModelView))
+in vec3 instanceKd;
+in vec3 instanceKs;
+in float instanceShininess;
+
+struct LightSource {
+    vec3 position;
+    vec3 rgbIntensity;
+};
+uniform LightSource light;
+
+uniform mat4 Perspective;
+
+// Scale applied to octahedral-encoded normals, 0 when normals are plain floats.
+uniform float octNormalScale;
+
+// Must match VertexCompression::octDecode().  Not normalized, the caller does that
+// after transforming.
+vec3 decodeNormal(vec3 n) {
+	if (octNormalScale == 0.0) {
+		return n;
+	}
+	vec2 e = clamp(n.xy * octNormalScale, -1.0, 1.0);
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0) {
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return v;
+}
+
+out VsOutFsIn {
+	vec3 position_ES; // Eye-space position
+	vec3 normal_ES;   // Eye-space normal
+	LightSource light;
+	flat vec3 kd;
+	flat vec3 ks;
+	flat float shininess;
+} vs_out;
+
+
+void main() {
+	vec4 pos4 = vec4(position, 1.0);
+
+	//-- Convert position and normal to Eye-Space:
+	vs_out.position_ES = (instanceModelView * pos4).xyz;
+	vs_out.normal_ES = normalize(instanceNormalMatrix * decodeNormal(normal));
+
+	vs_out.light = light;
+	vs_out.kd = instanceKd;
+	vs_out.ks = instanceKs;
+	vs_out.shininess = instanceShininess;
+
+	gl_Position = Perspective * instanceModelView * pos4;
+}
@@ -0,0 +1,64 @@
+#version 330
+// Bind pose coordinates in the space of the scene's world transforms, see SkinnedMesh.
+in vec3 position;
+in vec3 normal;
+
+// Up to four bones per vertex.  Weights are normalized bytes summing to 1.
+in uvec4 bones;
+in vec4 weights;
+
+// Index of the GeometryNode this vertex came from, for its material.
+in uint part;
+
+struct LightSource {
+    vec3 position;
+    vec3 rgbIntensity;
+};
+uniform LightSource light;
+
+// Scene view transform, the same for every vertex.
+uniform mat4 ModelView;
+uniform mat4 Perspective;
+uniform mat3 NormalMatrix;   // transpose(inverse(ModelView))
+
+// Four texels (columns) per bone: world * inverse(bind).
+uniform samplerBuffer bonePalette;
+
+// Two texels per part: kd, then ks with shininess in w.
+uniform samplerBuffer materialPalette;
+
+out VsOutFsIn {
+	vec3 position_ES; // Eye-space position
+	vec3 normal_ES;   // Eye-space normal
+	LightSource light;
+	flat vec3 kd;
+	flat vec3 ks;
+	flat float shininess;
+} vs_out;
+
+mat4 boneMatrix(uint bone) {
+	int base = 4 * int(bone);
+	return mat4(texelFetch(bonePalette, base), texelFetch(bonePalette, base + 1),
+			texelFetch(bonePalette, base + 2), texelFetch(bonePalette, base + 3));
+}
+
+void main() {
+	// Must match SkinnedMesh::skin().  Bones stay rigid while only joints rotate, so
+	// the blended matrix transforms normals as well.
+	mat4 skin = weights.x * boneMatrix(bones.x) + weights.y * boneMatrix(bones.y)
+		+ weights.z * boneMatrix(bones.z) + weights.w * boneMatrix(bones.w);
+	vec4 pos4 = skin * vec4(position, 1.0);
+
+	//-- Convert position and normal to Eye-Space:
+	vs_out.position_ES = (ModelView * pos4).xyz;
+	vs_out.normal_ES = normalize(NormalMatrix * (mat3(skin) * normal));
+
+	vs_out.light = light;
+	int material = 2 * int(part);
+	vec4 ks = texelFetch(materialPalette, material + 1);
+	vs_out.kd = texelFetch(materialPalette, material).rgb;
+	vs_out.ks = ks.rgb;
+	vs_out.shininess = ks.w;
+
+	gl_Position = Perspective * ModelView * pos4;
+}
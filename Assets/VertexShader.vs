@@ -1,5 +1,7 @@
 #version 330
-// Model-Space coordinates
+// Model-Space coordinates.  With a compact vertex format, position is normalized
+// inside the mesh bounds (the ModelView matrix undoes that) and normal holds the
+// two octahedral components.
 in vec3 position;
 in vec3 normal;
 
@@ -16,6 +18,23 @@ uniform mat4 Perspective;
 // transformed using this matrix instead of the ModelView matrix.
 uniform mat3 NormalMatrix;
 
+// Scale applied to octahedral-encoded normals, 0 when normals are plain floats.
+uniform float octNormalScale;
+
+// Must match VertexCompression::octDecode().  Not normalized, the caller does that
+// after transforming.
+vec3 decodeNormal(vec3 n) {
+	if (octNormalScale == 0.0) {
+		return n;
+	}
+	vec2 e = clamp(n.xy * octNormalScale, -1.0, 1.0);
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0) {
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return v;
+}
+
 out VsOutFsIn {
 	vec3 position_ES; // Eye-space position
 	vec3 normal_ES;   // Eye-space normal
@@ -28,7 +47,7 @@ void main() {
 
 	//-- Convert position and normal to Eye-Space:
 	vs_out.position_ES = (ModelView * pos4).xyz;
-	vs_out.normal_ES = normalize(NormalMatrix * normal);
+	vs_out.normal_ES = normalize(NormalMatrix * decodeNormal(normal));
 
 	vs_out.light = light;
 
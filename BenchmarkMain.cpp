@@ -0,0 +1,50 @@
+// Scene-graph microbenchmarks, built as their own executable by premake4.lua.
+
+#include "SceneGraphBenchmark.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+int main( int argc, char **argv )
+{
+	std::vector<unsigned int> nodeCounts = { 63, 255, 1023, 4095 };
+	unsigned int repetitions = 10;
+	std::string format("json");
+	std::string outputFile;
+	for (int i = 1; i < argc; ++i) {
+		std::string option(argv[i]);
+		if (option == "--nodes" && i + 1 < argc) {
+			nodeCounts.clear();
+			std::istringstream counts(argv[++i]);
+			for (std::string count; getline(counts, count, ','); ) {
+				nodeCounts.push_back(unsigned(atoi(count.c_str())));
+			}
+		} else if (option == "--repetitions" && i + 1 < argc) {
+			repetitions = unsigned(atoi(argv[++i]));
+		} else if (option == "--format" && i + 1 < argc) {
+			format = argv[++i];
+		} else if (option == "--out" && i + 1 < argc) {
+			outputFile = argv[++i];
+		} else {
+			cout << "Time the scene-graph hot paths on generated puppets with:\n";
+			cout << "./A3Bench [--nodes 63,255,1023,4095] [--repetitions N] "
+				 << "[--format json|csv] [--out FILE]\n";
+			return (option == "--help") ? 0 : 1;
+		}
+	}
+
+	if (outputFile.empty()) {
+		return runSceneGraphBenchmark(nodeCounts, repetitions, format, cout);
+	}
+	std::ofstream out(outputFile);
+	if (!out) {
+		cerr << "Could not open " << outputFile << endl;
+		return 1;
+	}
+	return runSceneGraphBenchmark(nodeCounts, repetitions, format, out);
+}
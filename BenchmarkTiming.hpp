@@ -0,0 +1,20 @@
+#pragma once
+
+#include <chrono>
+
+// Best wall time of repetitions calls to run(), in seconds.  Shared by the benchmark
+// modes, which all report the fastest run to keep scheduler noise out.
+template <class Run>
+double bestTime(Run run, unsigned int repetitions) {
+	double best = 0.0;
+	for (unsigned int i = 0; i < repetitions; ++i) {
+		auto start = std::chrono::high_resolution_clock::now();
+		run();
+		auto end = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration<double>(end - start).count();
+		if (i == 0 || seconds < best) {
+			best = seconds;
+		}
+	}
+	return best;
+}
@@ -0,0 +1,114 @@
+#include "BoundingVolumes.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace glm;
+
+//---------------------------------------------------------------------------------------
+BoundingSphere BoundingSphere::fromIndexedPoints(
+		const float * positions,
+		const uint32_t * indices,
+		size_t numIndices
+) {
+	if (numIndices == 0) {
+		return BoundingSphere();
+	}
+
+	const float * first = positions + 3 * indices[0];
+	vec3 lo(first[0], first[1], first[2]);
+	vec3 hi = lo;
+	for (size_t i = 1; i < numIndices; ++i) {
+		const float * p = positions + 3 * indices[i];
+		vec3 v(p[0], p[1], p[2]);
+		lo = glm::min(lo, v);
+		hi = glm::max(hi, v);
+	}
+
+	vec3 center = 0.5f * (lo + hi);
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i < numIndices; ++i) {
+		const float * p = positions + 3 * indices[i];
+		vec3 d = vec3(p[0], p[1], p[2]) - center;
+		radiusSquared = std::max(radiusSquared, dot(d, d));
+	}
+	return BoundingSphere(center, std::sqrt(radiusSquared));
+}
+
+//---------------------------------------------------------------------------------------
+BoundingSphere BoundingSphere::merge(const BoundingSphere & a, const BoundingSphere & b) {
+	if (a.empty()) {
+		return b;
+	}
+	if (b.empty()) {
+		return a;
+	}
+
+	vec3 offset = b.center - a.center;
+	float distance = length(offset);
+	if (distance + b.radius <= a.radius) {
+		return a;
+	}
+	if (distance + a.radius <= b.radius) {
+		return b;
+	}
+
+	// Span from the far side of a to the far side of b, along the line through both
+	// centres.
+	float radius = 0.5f * (distance + a.radius + b.radius);
+	vec3 center = a.center + offset * ((radius - a.radius) / distance);
+	return BoundingSphere(center, radius);
+}
+
+//---------------------------------------------------------------------------------------
+BoundingSphere BoundingSphere::transformed(const glm::mat4 & transform) const {
+	if (empty()) {
+		return *this;
+	}
+
+	float scaleSquared = std::max(dot(vec3(transform[0]), vec3(transform[0])),
+			std::max(dot(vec3(transform[1]), vec3(transform[1])),
+					dot(vec3(transform[2]), vec3(transform[2]))));
+	return BoundingSphere(vec3(transform * vec4(center, 1.0f)),
+			radius * std::sqrt(scaleSquared));
+}
+
+//---------------------------------------------------------------------------------------
+Frustum::Frustum()
+{
+	// Accepts everything until real planes are set.
+	for (vec4 & plane : m_planes) {
+		plane = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+Frustum::Frustum(const glm::mat4 & clipFromWorld)
+{
+	// Gribb and Hartmann: a point is inside when -w <= x, y, z <= w in clip space, and
+	// each of those six inequalities is a plane in the source space.
+	const mat4 m = transpose(clipFromWorld);
+	m_planes[0] = m[3] + m[0];   // Left
+	m_planes[1] = m[3] - m[0];   // Right
+	m_planes[2] = m[3] + m[1];   // Bottom
+	m_planes[3] = m[3] - m[1];   // Top
+	m_planes[4] = m[3] + m[2];   // Near
+	m_planes[5] = m[3] - m[2];   // Far
+
+	for (vec4 & plane : m_planes) {
+		plane = plane / length(vec3(plane));
+	}
+}
+
+//---------------------------------------------------------------------------------------
+bool Frustum::intersects(const BoundingSphere & sphere) const {
+	if (sphere.empty()) {
+		return false;
+	}
+	for (const vec4 & plane : m_planes) {
+		if (dot(vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+// Sphere enclosing a mesh or a subtree of the scene.  A negative radius marks an empty
+// sphere, e.g. a subtree without any GeometryNode.
+struct BoundingSphere {
+	glm::vec3 center;
+	float radius;
+
+	BoundingSphere() : center(0.0f), radius(-1.0f) { }
+	BoundingSphere(const glm::vec3 & center, float radius) : center(center), radius(radius) { }
+
+	bool empty() const { return radius < 0.0f; }
+
+	// Sphere around the vertices that indices select from positions, which holds 3
+	// floats per vertex.  Centred on their bounding box, so not minimal, but never
+	// more than sqrt(3) times too large and cheap to compute at load time.
+	static BoundingSphere fromIndexedPoints(const float * positions, const uint32_t * indices,
+			size_t numIndices);
+
+	// Smallest sphere enclosing both a and b.
+	static BoundingSphere merge(const BoundingSphere & a, const BoundingSphere & b);
+
+	// Encloses this sphere after transform.  The radius is scaled by the largest
+	// column length of the upper 3x3, which is exact for uniform scales.
+	BoundingSphere transformed(const glm::mat4 & transform) const;
+};
+
+// Six planes of a view frustum, normals pointing inwards.
+class Frustum {
+public:
+	Frustum();
+
+	// Planes of the clip volume of clipFromWorld, e.g. perspective * view, in the
+	// space clipFromWorld maps from.
+	explicit Frustum(const glm::mat4 & clipFromWorld);
+
+	// False only if sphere lies entirely outside one of the planes.  Conservative near
+	// the frustum's edges and corners, where a sphere may be kept although it is
+	// outside.
+	bool intersects(const BoundingSphere & sphere) const;
+
+private:
+	glm::vec4 m_planes[6];   // xyz = unit normal, w = distance; inside when >= 0
+};
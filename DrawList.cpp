@@ -0,0 +1,56 @@
+#include "DrawList.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+//---------------------------------------------------------------------------------------
+void DrawList::build(const FlatSceneGraph & flatSceneGraph, const MeshRegistry & meshRegistry) {
+	clear();
+
+	for (unsigned int i : flatSceneGraph.geometryIndices) {
+		const GeometryNode * geometryNode =
+				static_cast<const GeometryNode *>(flatSceneGraph.nodes[i]);
+
+		RenderItem item;
+		item.batchInfo = meshRegistry.batchInfo(geometryNode->meshHandle);
+		item.node = geometryNode;
+		item.worldTransform = &flatSceneGraph.worldTransforms[i];
+		item.materialIndex = findOrAddMaterial(geometryNode->material);
+		item.nodeId = geometryNode->m_nodeId;
+		item.flatIndex = i;
+		item.sortKey = makeSortKey(0, unsigned(geometryNode->meshHandle), item.materialIndex);
+		items.push_back(item);
+	}
+
+	// Stable, so equal keys keep scene order.
+	stable_sort(items.begin(), items.end(), [](const RenderItem & a, const RenderItem & b) {
+		return a.sortKey < b.sortKey;
+	});
+}
+
+//---------------------------------------------------------------------------------------
+void DrawList::clear() {
+	items.clear();
+	materials.clear();
+}
+
+//---------------------------------------------------------------------------------------
+uint64_t DrawList::makeSortKey(unsigned int program, unsigned int mesh, unsigned int material) {
+	return (uint64_t(program & 0xff) << 56)
+		 | (uint64_t(mesh & 0xffffff) << 32)
+		 | uint64_t(material);
+}
+
+//---------------------------------------------------------------------------------------
+unsigned int DrawList::findOrAddMaterial(const Material & material) {
+	// Scenes only have a handful of distinct materials, a linear scan is enough.
+	for (unsigned int i = 0; i < materials.size(); ++i) {
+		const Material & m = materials[i];
+		if (m.kd == material.kd && m.ks == material.ks && m.shininess == material.shininess) {
+			return i;
+		}
+	}
+	materials.push_back(material);
+	return unsigned(materials.size() - 1);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "cs488-framework/MeshConsolidator.hpp"
+
+#include "FlatSceneGraph.hpp"
+#include "GeometryNode.hpp"
+#include "Material.hpp"
+#include "MeshRegistry.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// One GeometryNode draw.  Everything except the world matrix is fixed until the scene
+// structure changes.
+struct RenderItem {
+	uint64_t sortKey;
+	BatchInfo batchInfo;
+	const GeometryNode * node;
+	const glm::mat4 * worldTransform;   // Points into FlatSceneGraph::worldTransforms
+	unsigned int materialIndex;         // Index into DrawList::materials
+	unsigned int nodeId;
+	unsigned int flatIndex;             // Index of node in the FlatSceneGraph
+};
+
+// GeometryNodes of a FlatSceneGraph as render items sorted by (program, mesh,
+// material), so consecutive items can skip state that has not changed.
+class DrawList {
+public:
+	// Rebuild from scratch.  Must be called again whenever the FlatSceneGraph is rebuilt,
+	// since items point into its world transform array.
+	void build(const FlatSceneGraph & flatSceneGraph, const MeshRegistry & meshRegistry);
+	void clear();
+
+	// Packs 8 bits of program, 24 bits of mesh handle and 32 bits of material, most
+	// significant first.
+	static uint64_t makeSortKey(unsigned int program, unsigned int mesh,
+			unsigned int material);
+
+	std::vector<RenderItem> items;
+
+	// Distinct materials referenced by items.
+	std::vector<Material> materials;
+
+private:
+	unsigned int findOrAddMaterial(const Material & material);
+};
@@ -0,0 +1,186 @@
+#include "FlatSceneGraph.hpp"
+
+#include "MatrixKernels.hpp"
+
+#include <utility>
+
+using namespace glm;
+
+//---------------------------------------------------------------------------------------
+FlatSceneGraph::FlatSceneGraph()
+	: m_boundsDirty(true)
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+void FlatSceneGraph::build(SceneNode * root) {
+	clear();
+	if (root == nullptr) {
+		return;
+	}
+
+	// Iterative pre-order DFS.  Children are pushed in reverse so they are visited in
+	// the same order as the recursive renderer.
+	std::vector<std::pair<SceneNode *, int>> stack;
+	stack.push_back(std::make_pair(root, -1));
+	while (!stack.empty()) {
+		SceneNode * node = stack.back().first;
+		int parent = stack.back().second;
+		stack.pop_back();
+
+		int index = static_cast<int>(nodes.size());
+		nodes.push_back(node);
+		parentIndex.push_back(parent);
+		localTransforms.push_back(node->get_transform());
+		if (node->m_nodeType == NodeType::GeometryNode) {
+			geometryIndices.push_back(index);
+		}
+
+		for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+			stack.push_back(std::make_pair(*it, index));
+		}
+	}
+
+	// Parents precede their descendants, so a reverse pass accumulates subtree sizes.
+	const size_t n = nodes.size();
+	std::vector<unsigned int> subtreeSize(n, 1);
+	subtreeGeometry.assign(n, 0);
+	for (unsigned int i : geometryIndices) {
+		subtreeGeometry[i] = 1;
+	}
+	for (size_t i = n; i-- > 1;) {
+		subtreeSize[parentIndex[i]] += subtreeSize[i];
+		subtreeGeometry[parentIndex[i]] += subtreeGeometry[i];
+	}
+	subtreeEnd.resize(n);
+	for (size_t i = 0; i < n; ++i) {
+		subtreeEnd[i] = unsigned(i) + subtreeSize[i];
+	}
+
+	meshBounds.assign(n, BoundingSphere());
+	subtreeBounds.assign(n, BoundingSphere());
+
+	worldTransforms.resize(n);
+	updateWorldTransforms();
+}
+
+//---------------------------------------------------------------------------------------
+void FlatSceneGraph::clear() {
+	parentIndex.clear();
+	localTransforms.clear();
+	worldTransforms.clear();
+	nodes.clear();
+	geometryIndices.clear();
+	subtreeEnd.clear();
+	subtreeGeometry.clear();
+	meshBounds.clear();
+	subtreeBounds.clear();
+	m_boundsDirty = true;
+}
+
+//---------------------------------------------------------------------------------------
+void FlatSceneGraph::syncLocalTransforms() {
+	const size_t n = nodes.size();
+	for (size_t i = 0; i < n; ++i) {
+		localTransforms[i] = nodes[i]->get_transform();
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void FlatSceneGraph::updateWorldTransforms() {
+	const size_t n = nodes.size();
+	MatrixKernels::evaluateHierarchy(parentIndex.data(), localTransforms.data(),
+			worldTransforms.data(), n);
+	m_boundsDirty = true;
+}
+
+//---------------------------------------------------------------------------------------
+unsigned int FlatSceneGraph::updateDirtyWorldTransforms() {
+	const size_t n = nodes.size();
+	const int * parent = parentIndex.data();
+	mat4 * local = localTransforms.data();
+	mat4 * world = worldTransforms.data();
+
+	// Dirtiness always covers whole subtrees and parents come first, so world[parent]
+	// is up to date by the time any dirty child reads it.
+	unsigned int recomputed = 0;
+	for (size_t i = 0; i < n; ++i) {
+		SceneNode * node = nodes[i];
+		if (!node->m_worldDirty) {
+			continue;
+		}
+		local[i] = node->get_transform();
+		world[i] = (parent[i] < 0) ? local[i] : world[parent[i]] * local[i];
+		node->m_worldTransform = world[i];
+		node->m_worldDirty = false;
+		++recomputed;
+	}
+
+	SceneNode::worldRecomputeCount += recomputed;
+	if (recomputed > 0) {
+		m_boundsDirty = true;
+	}
+	return recomputed;
+}
+
+//---------------------------------------------------------------------------------------
+void FlatSceneGraph::setMeshBounds(unsigned int index, const BoundingSphere & bounds) {
+	meshBounds[index] = bounds;
+	m_boundsDirty = true;
+}
+
+//---------------------------------------------------------------------------------------
+bool FlatSceneGraph::updateSubtreeBounds() {
+	if (!m_boundsDirty) {
+		return false;
+	}
+
+	const size_t n = nodes.size();
+	for (size_t i = 0; i < n; ++i) {
+		subtreeBounds[i] = meshBounds[i].transformed(worldTransforms[i]);
+	}
+	// Every descendant of i has a larger index, so all of them have been merged into i
+	// by the time i is merged into its parent.
+	for (size_t i = n; i-- > 0;) {
+		nodes[i]->m_subtreeBounds = subtreeBounds[i];
+		if (parentIndex[i] >= 0) {
+			BoundingSphere & parentBounds = subtreeBounds[parentIndex[i]];
+			parentBounds = BoundingSphere::merge(parentBounds, subtreeBounds[i]);
+		}
+	}
+
+	m_boundsDirty = false;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+CullResult FlatSceneGraph::cull(const Frustum & frustum, std::vector<char> & visible) const {
+	CullResult result;
+	const size_t n = nodes.size();
+	visible.assign(n, 0);
+
+	size_t i = 0;
+	while (i < n) {
+		if (subtreeGeometry[i] == 0) {
+			// Nothing to draw down here, not worth a test.
+			i = subtreeEnd[i];
+		} else if (!frustum.intersects(subtreeBounds[i])) {
+			++result.subtreesCulled;
+			result.geometryCulled += subtreeGeometry[i];
+			i = subtreeEnd[i];
+		} else {
+			if (nodes[i]->m_nodeType == NodeType::GeometryNode) {
+				visible[i] = 1;
+				++result.geometryVisible;
+			}
+			++i;
+		}
+	}
+	return result;
+}
+
+//---------------------------------------------------------------------------------------
+size_t FlatSceneGraph::size() const {
+	return nodes.size();
+}
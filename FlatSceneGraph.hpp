@@ -0,0 +1,77 @@
+#pragma once
+
+#include "SceneNode.hpp"
+#include "BoundingVolumes.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Outcome of FlatSceneGraph::cull().
+struct CullResult {
+	unsigned int subtreesCulled = 0;   // Subtrees rejected with a single sphere test
+	unsigned int geometryCulled = 0;   // GeometryNodes inside those subtrees
+	unsigned int geometryVisible = 0;
+};
+
+// Structure-of-arrays copy of a SceneNode hierarchy.  Nodes are stored in depth-first
+// pre-order, so every parent precedes its children and world transforms can be
+// evaluated with one linear pass instead of a recursive walk over child lists.
+class FlatSceneGraph {
+public:
+	FlatSceneGraph();
+
+	// Compile the tree rooted at root.  Must be called again whenever nodes are
+	// added or removed.
+	void build(SceneNode * root);
+	void clear();
+
+	// Copy each node's local transform into the contiguous local array.
+	void syncLocalTransforms();
+
+	// world[i] = world[parent[i]] * local[i], evaluated in a single forward pass by
+	// MatrixKernels::evaluateHierarchy().
+	void updateWorldTransforms();
+
+	// Same loop, but only for nodes whose world transform cache is dirty.  Refreshes
+	// the SceneNode caches as well and returns the number of nodes recomputed.
+	unsigned int updateDirtyWorldTransforms();
+
+	// Model-space bounds of the mesh drawn by GeometryNode index.  Stays with the node
+	// until the next build().
+	void setMeshBounds(unsigned int index, const BoundingSphere & bounds);
+
+	// Recompute subtreeBounds if any world transform or mesh bound changed since the
+	// last call, with one reverse pass that merges every node into its parent.  Copies
+	// the result to SceneNode::m_subtreeBounds.  Returns false if nothing changed.
+	bool updateSubtreeBounds();
+
+	// Set visible[i] for every GeometryNode i whose subtree bounds all intersect
+	// frustum, which must be in the space of worldTransforms.  A rejected subtree is
+	// skipped whole.  Expects subtreeBounds to be up to date.
+	CullResult cull(const Frustum & frustum, std::vector<char> & visible) const;
+
+	size_t size() const;
+
+	// Parallel arrays, indexed by flat node index.
+	std::vector<int> parentIndex;             // -1 for the root
+	std::vector<glm::mat4> localTransforms;
+	std::vector<glm::mat4> worldTransforms;   // Model space, excludes view/puppet transforms
+	std::vector<SceneNode *> nodes;
+
+	// Flat indices of every GeometryNode, in draw order.
+	std::vector<unsigned int> geometryIndices;
+
+	// Subtree of node i: flat indices [i, subtreeEnd[i]), holding subtreeGeometry[i]
+	// GeometryNodes.
+	std::vector<unsigned int> subtreeEnd;
+	std::vector<unsigned int> subtreeGeometry;
+
+	// Model-space mesh bounds, empty for nodes that draw nothing, and world-space bounds
+	// of each node's whole subtree.
+	std::vector<BoundingSphere> meshBounds;
+	std::vector<BoundingSphere> subtreeBounds;
+
+private:
+	bool m_boundsDirty;
+};
@@ -8,7 +8,9 @@ GeometryNode::GeometryNode(
 		const std::string & name
 )
 	: SceneNode(name),
-	  meshId(meshId)
+	  meshId(meshId),
+	  meshHandle(-1),
+	  lodLevel(0)
 {
 	m_nodeType = NodeType::GeometryNode;
 }
@@ -16,4 +16,11 @@ public:
 	// Mesh Identifier. This must correspond to an object name of
 	// a loaded .obj file.
 	std::string meshId;
+
+	// Index into MeshRegistry, set by MeshRegistry::resolve().  -1 until resolved.
+	int meshHandle;
+
+	// Level of detail drawn last frame.  Kept between frames so that selection can
+	// apply hysteresis.
+	mutable unsigned int lodLevel;
 };
@@ -0,0 +1,129 @@
+#include "IdBuffer.hpp"
+
+#include "cs488-framework/GlErrorCheck.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+//---------------------------------------------------------------------------------------
+IdBuffer::IdBuffer()
+	: m_framebuffer(0),
+	  m_idRenderbuffer(0),
+	  m_depthRenderbuffer(0),
+	  m_width(0),
+	  m_height(0)
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+void IdBuffer::resize(int width, int height) {
+	if (m_framebuffer != 0 && width == m_width && height == m_height) {
+		return;
+	}
+	destroy();
+	m_width = width;
+	m_height = height;
+
+	glGenRenderbuffers(1, &m_idRenderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_idRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, width, height);
+
+	glGenRenderbuffers(1, &m_depthRenderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+			m_idRenderbuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+			m_depthRenderbuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		cerr << "ID buffer framebuffer is incomplete" << endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	CHECK_GL_ERRORS;
+}
+
+//---------------------------------------------------------------------------------------
+void IdBuffer::destroy() {
+	if (m_framebuffer != 0) {
+		glDeleteFramebuffers(1, &m_framebuffer);
+		GLuint renderbuffers[] = { m_idRenderbuffer, m_depthRenderbuffer };
+		glDeleteRenderbuffers(2, renderbuffers);
+	}
+	m_framebuffer = m_idRenderbuffer = m_depthRenderbuffer = 0;
+	m_width = m_height = 0;
+}
+
+//---------------------------------------------------------------------------------------
+void IdBuffer::beginPass() {
+	glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_width, m_height);
+
+	// Integer attachments must be cleared with glClearBuffer*, not glClearColor.
+	const GLuint noId[4] = { NoId, 0, 0, 0 };
+	const GLfloat farDepth = 1.0f;
+	glClearBufferuiv(GL_COLOR, 0, noId);
+	glClearBufferfv(GL_DEPTH, 0, &farDepth);
+
+	CHECK_GL_ERRORS;
+}
+
+//---------------------------------------------------------------------------------------
+void IdBuffer::endPass() {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2],
+			m_savedViewport[3]);
+}
+
+//---------------------------------------------------------------------------------------
+std::vector<uint32_t> IdBuffer::readDistinctIds(int x, int y, int width, int height) const {
+	int x0 = std::max(x, 0);
+	int y0 = std::max(y, 0);
+	int x1 = std::min(x + width, m_width);
+	int y1 = std::min(y + height, m_height);
+	if (x1 <= x0 || y1 <= y0) {
+		return vector<uint32_t>();
+	}
+
+	vector<uint32_t> ids(size_t(x1 - x0) * size_t(y1 - y0));
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glReadPixels(x0, y0, x1 - x0, y1 - y0, GL_RED_INTEGER, GL_UNSIGNED_INT, ids.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	CHECK_GL_ERRORS;
+
+	sort(ids.begin(), ids.end());
+	ids.erase(unique(ids.begin(), ids.end()), ids.end());
+	if (!ids.empty() && ids.back() == NoId) {
+		ids.pop_back();
+	}
+	return ids;
+}
+
+//---------------------------------------------------------------------------------------
+void IdBuffer::readIdToPixelBuffer(int x, int y) const {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	CHECK_GL_ERRORS;
+}
+
+//---------------------------------------------------------------------------------------
+int IdBuffer::width() const {
+	return m_width;
+}
+
+//---------------------------------------------------------------------------------------
+int IdBuffer::height() const {
+	return m_height;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "cs488-framework/OpenGLImport.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Offscreen framebuffer with a GL_R32UI colour attachment and a depth buffer.  An ID
+// pass writes each fragment's SceneNode::m_nodeId, so picks read back exact integer
+// ids instead of ids packed into 8-bit colour channels.
+class IdBuffer {
+public:
+	// Cleared value, where no GeometryNode was drawn.
+	static const uint32_t NoId = 0xffffffffu;
+
+	IdBuffer();
+
+	// (Re)allocate the attachments for a width x height framebuffer.  Does nothing if
+	// the size is unchanged.
+	void resize(int width, int height);
+	void destroy();
+
+	// Bind the buffer for drawing over its whole area, and clear ids to NoId and depth
+	// to far.  The clear honours the scissor test, so an enabled scissor box limits the
+	// pass to that region.
+	void beginPass();
+
+	// Rebind the default framebuffer and the viewport beginPass() replaced.
+	void endPass();
+
+	// Read the ids of a rectangle (clamped to the buffer) in one transfer, and return
+	// the distinct ones other than NoId in ascending order.
+	std::vector<uint32_t> readDistinctIds(int x, int y, int width, int height) const;
+
+	// Start an asynchronous copy of the id at (x, y) into the buffer bound to
+	// GL_PIXEL_PACK_BUFFER, at offset 0.
+	void readIdToPixelBuffer(int x, int y) const;
+
+	int width() const;
+	int height() const;
+
+private:
+	GLuint m_framebuffer;
+	GLuint m_idRenderbuffer;
+	GLuint m_depthRenderbuffer;
+	int m_width;
+	int m_height;
+	GLint m_savedViewport[4];
+};
@@ -0,0 +1,117 @@
+#include "JointDriftCheck.hpp"
+
+#include "JointNode.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace glm;
+using namespace std;
+
+namespace {
+
+// Same as Puppet::applyJointTransform().
+const float Sensitivity = 0.2f;
+
+// A few float ULPs on unit-length columns.
+const double Tolerance = 1e-5;
+
+struct DriftErrors {
+	double orthonormality = 0.0;   // Largest entry of |R^T R - I|
+	double angles = 0.0;           // Largest entry of |R - Rz(z) Ry(y)|
+};
+
+// Rotation part of m, which must carry no scale.
+DriftErrors measure(const mat4 & m, double angleY, double angleZ) {
+	DriftErrors errors;
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			double dot = 0.0;
+			for (int k = 0; k < 3; ++k) {
+				dot += double(m[i][k]) * double(m[j][k]);
+			}
+			errors.orthonormality = max(errors.orthonormality, abs(dot - (i == j ? 1.0 : 0.0)));
+		}
+	}
+
+	// Rz(z) * Ry(y) in double precision, column-major like glm.
+	const double ry = angleY * M_PI / 180.0;
+	const double rz = angleZ * M_PI / 180.0;
+	const double cy = cos(ry), sy = sin(ry), cz = cos(rz), sz = sin(rz);
+	const double expected[3][3] = {
+		{ cz * cy, sz * cy, -sy },
+		{ -sz, cz, 0.0 },
+		{ cz * sy, sz * sy, cy }
+	};
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			errors.angles = max(errors.angles, abs(double(m[i][j]) - expected[i][j]));
+		}
+	}
+	return errors;
+}
+
+void report(const char * name, const DriftErrors & errors) {
+	cout << left << setw(32) << name << right << scientific << setprecision(3)
+		 << setw(16) << errors.orthonormality
+		 << setw(16) << errors.angles << endl;
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+int runJointDriftCheck(unsigned int numEvents) {
+	JointNode joint("joint");
+	SceneNode accumulated("accumulated");
+	joint.translate(vec3(1.0f, 2.0f, 3.0f));
+	accumulated.translate(vec3(1.0f, 2.0f, 3.0f));
+
+	// A drag wanders back and forth, mostly about z like the middle button, with the
+	// head's y rotation mixed in.  Rotations are applied the way the joint composes
+	// them, z after y, so both nodes should describe the same rotation.
+	mt19937 random(488);
+	uniform_int_distribution<int> mouseDelta(-6, 6);
+	DriftErrors worstJoint, worstAccumulated;
+	for (unsigned int event = 0; event < numEvents; ++event) {
+		const float degrees = Sensitivity * float(mouseDelta(random));
+		if (event % 8 == 7) {
+			// Undo the z angle, turn about y, redo it.
+			const float z = float(accumulated.current_angle_z);
+			accumulated.rotate('z', -z);
+			accumulated.rotate('y', degrees);
+			accumulated.rotate('z', z);
+			joint.rotate('y', degrees);
+		} else {
+			accumulated.rotate('z', degrees);
+			joint.rotate('z', degrees);
+		}
+
+		if ((event + 1) % 1024 == 0 || event + 1 == numEvents) {
+			DriftErrors j = measure(joint.get_transform(), joint.current_angle_y,
+					joint.current_angle_z);
+			DriftErrors a = measure(accumulated.get_transform(), accumulated.current_angle_y,
+					accumulated.current_angle_z);
+			worstJoint.orthonormality = max(worstJoint.orthonormality, j.orthonormality);
+			worstJoint.angles = max(worstJoint.angles, j.angles);
+			worstAccumulated.orthonormality = max(worstAccumulated.orthonormality,
+					a.orthonormality);
+			worstAccumulated.angles = max(worstAccumulated.angles, a.angles);
+		}
+	}
+
+	cout << "Largest error over " << numEvents << " mouse-move rotations" << endl;
+	cout << left << setw(32) << "node" << right
+		 << setw(16) << "orthonormality"
+		 << setw(16) << "vs angles" << endl;
+	report("JointNode (from angles)", worstJoint);
+	report("SceneNode (accumulated)", worstAccumulated);
+
+	bool ok = worstJoint.orthonormality <= Tolerance && worstJoint.angles <= Tolerance;
+	cout << (ok ? "JointNode within tolerance" : "JointNode DRIFTED") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// Long-drag stress check.  Turns a JointNode through numEvents small mouse-move
+// rotations about z and y, and a plain SceneNode through the same rotations
+// accumulated matrix by matrix for comparison.  Reports how far the rotation part of
+// each local transform is from orthonormal and from the rotation its tracked angles
+// describe.  Returns 0 if the JointNode stays within float precision, 1 otherwise.
+int runJointDriftCheck(unsigned int numEvents);
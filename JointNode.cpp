@@ -2,6 +2,12 @@
 
 #include "JointNode.hpp"
 
+#include "cs488-framework/MathUtils.hpp"
+
+#include <glm/gtx/transform.hpp>
+
+using namespace glm;
+
 //---------------------------------------------------------------------------------------
 JointNode::JointNode(const std::string& name)
 	: SceneNode(name)
@@ -26,3 +32,60 @@ void JointNode::set_joint_y(double min, double init, double max) {
 	m_joint_y.init = init;
 	m_joint_y.max = max;
 }
+
+//---------------------------------------------------------------------------------------
+void JointNode::set_angles(double angleY, double angleZ) {
+	if (angleY == current_angle_y && angleZ == current_angle_z) {
+		return;
+	}
+	current_angle_y = angleY;
+	current_angle_z = angleZ;
+	m_transDirty = true;
+	mark_dirty();
+}
+
+//---------------------------------------------------------------------------------------
+const glm::mat4 & JointNode::get_rest_transform() const {
+	return m_restTransform;
+}
+
+//---------------------------------------------------------------------------------------
+void JointNode::rotate(char axis, float angle) {
+	switch (axis) {
+		case 'y':
+			set_angles(current_angle_y + angle, current_angle_z);
+			break;
+		case 'z':
+			set_angles(current_angle_y, current_angle_z + angle);
+			break;
+		default:
+			m_restTransform = glm::rotate(degreesToRadians(angle), vec3(1, 0, 0))
+				* m_restTransform;
+			m_transDirty = true;
+			mark_dirty();
+			break;
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void JointNode::scale(const glm::vec3 & amount) {
+	m_restTransform = glm::scale(amount) * m_restTransform;
+	m_transDirty = true;
+	mark_dirty();
+}
+
+//---------------------------------------------------------------------------------------
+void JointNode::translate(const glm::vec3 & amount) {
+	m_restTransform = glm::translate(amount) * m_restTransform;
+	m_transDirty = true;
+	mark_dirty();
+}
+
+//---------------------------------------------------------------------------------------
+// One matrix from the angles, never accumulated, so it stays orthonormal (over the rest
+// transform) however many edits led to the angles.
+void JointNode::rebuild_transform() const {
+	trans = glm::rotate(degreesToRadians(float(current_angle_z)), vec3(0, 0, 1))
+		* glm::rotate(degreesToRadians(float(current_angle_y)), vec3(0, 1, 0))
+		* m_restTransform;
+}
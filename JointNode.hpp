@@ -12,10 +12,27 @@ public:
 	void set_joint_x(double min, double init, double max);
 	void set_joint_y(double min, double init, double max);
 
+	// The local transform is rotate(current_angle_z, z) * rotate(current_angle_y, y) *
+	// rest transform, rebuilt from the angles on the next get_transform() after they
+	// change.  Rotations about y and z only add to the angles; translate(), scale() and
+	// rotations about x build the rest transform, which the scene file sets up.
+	void set_angles(double angleY, double angleZ);
+	const glm::mat4 & get_rest_transform() const;
+
+	virtual void rotate(char axis, float angle) override;
+	virtual void scale(const glm::vec3 & amount) override;
+	virtual void translate(const glm::vec3 & amount) override;
+
 	struct JointRange {
 		double min, init, max;
 	};
 
 
 	JointRange m_joint_x, m_joint_y;
+
+protected:
+	virtual void rebuild_transform() const override;
+
+private:
+	glm::mat4 m_restTransform;
 };
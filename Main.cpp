@@ -1,13 +1,122 @@
 // Term-Winter 2021
 
 #include "puppet.hpp"
+#include "ObjDecoderBenchmark.hpp"
+#include "AnimationBenchmark.hpp"
+#include "JointDriftCheck.hpp"
+#include "MeshCacheBenchmark.hpp"
+#include "MatrixKernelBenchmark.hpp"
+#include "SkinningBenchmark.hpp"
+#include "VertexQuantizationReport.hpp"
 
 #include <iostream>
 using namespace std;
 
 int main( int argc, char **argv ) 
 {
-	if (argc > 1) {
+	if (argc > 1 && std::string(argv[1]) == "--bench-obj") {
+		// Decoder throughput and correctness check, no window needed.
+		std::vector<std::string> objFiles;
+		unsigned int repetitions = 5;
+		for (int i = 2; i < argc; ++i) {
+			if (std::string(argv[i]) == "--repetitions" && i + 1 < argc) {
+				repetitions = unsigned(atoi(argv[++i]));
+			} else {
+				objFiles.push_back(argv[i]);
+			}
+		}
+		return runObjDecoderBenchmark(objFiles, repetitions);
+
+	} else if (argc > 1 && std::string(argv[1]) == "--bench-mesh-cache") {
+		// Startup from .obj text against the binary mesh cache, on a generated mesh.
+		unsigned int repetitions = 3;
+		if (argc > 3 && std::string(argv[2]) == "--repetitions") {
+			repetitions = unsigned(atoi(argv[3]));
+		}
+		return runMeshCacheBenchmark(repetitions);
+
+	} else if (argc > 1 && std::string(argv[1]) == "--bench-animation") {
+		// Keyframe evaluation throughput over generated joints.
+		unsigned int numJoints = 10000;
+		unsigned int keysPerTrack = 16;
+		unsigned int repetitions = 5;
+		for (int i = 2; i + 1 < argc; ++i) {
+			std::string option(argv[i]);
+			if (option == "--joints") {
+				numJoints = unsigned(atoi(argv[++i]));
+			} else if (option == "--keys") {
+				keysPerTrack = unsigned(atoi(argv[++i]));
+			} else if (option == "--repetitions") {
+				repetitions = unsigned(atoi(argv[++i]));
+			}
+		}
+		return runAnimationBenchmark(numJoints, keysPerTrack, repetitions);
+
+	} else if (argc > 1 && std::string(argv[1]) == "--check-joint-drift") {
+		// Joint transforms after a very long drag.
+		unsigned int numEvents = 1000000;
+		if (argc > 3 && std::string(argv[2]) == "--events") {
+			numEvents = unsigned(atoi(argv[3]));
+		}
+		return runJointDriftCheck(numEvents);
+
+	} else if (argc > 1 && std::string(argv[1]) == "--bench-matrix") {
+		// Batched matrix kernels on every instruction set, checked against glm.
+		unsigned int count = 100000;
+		unsigned int repetitions = 5;
+		for (int i = 2; i + 1 < argc; ++i) {
+			std::string option(argv[i]);
+			if (option == "--count") {
+				count = unsigned(atoi(argv[++i]));
+			} else if (option == "--repetitions") {
+				repetitions = unsigned(atoi(argv[++i]));
+			}
+		}
+		return runMatrixKernelBenchmark(count, repetitions);
+
+	} else if (argc > 1 && std::string(argv[1]) == "--bench-skinning") {
+		// Rigid parts against GPU and CPU skinning of one scene.
+		if (argc < 3) {
+			cerr << "Usage: ./A3 --bench-skinning scene.lua [--repetitions N]" << endl;
+			return 1;
+		}
+		unsigned int repetitions = 100;
+		if (argc > 4 && std::string(argv[3]) == "--repetitions") {
+			repetitions = unsigned(atoi(argv[4]));
+		}
+		return runSkinningBenchmark(argv[2], repetitions);
+
+	} else if (argc > 1 && std::string(argv[1]) == "--render-batch") {
+		// Poses and cameras of a job file rendered to images, without a window.
+		if (argc < 4) {
+			cerr << "Usage: ./A3 --render-batch scene.lua jobs.txt [--out DIR] [--size WxH]"
+				 << endl;
+			return 1;
+		}
+		std::string outputDirectory("renders");
+		int width = 256;
+		int height = 256;
+		for (int i = 4; i + 1 < argc; ++i) {
+			std::string option(argv[i]);
+			if (option == "--out") {
+				outputDirectory = argv[++i];
+			} else if (option == "--size") {
+				sscanf(argv[++i], "%dx%d", &width, &height);
+			}
+		}
+		OffscreenContext context;
+		if (!context.create(width, height)) {
+			return 1;
+		}
+		Puppet puppet(argv[2]);
+		return puppet.renderBatch(context, argv[3], outputDirectory);
+
+	} else if (argc > 1 && std::string(argv[1]) == "--quantization-error") {
+		// Memory and accuracy of the compact vertex formats.
+		std::vector<std::string> objFiles(argv + 2, argv + argc);
+		return runQuantizationErrorReport(objFiles);
+
+	} else if (argc > 1) {
 		std::string luaSceneFile(argv[1]);
 		std::string title("3D Puppet - [");
 		title += luaSceneFile;
@@ -19,6 +128,22 @@ int main( int argc, char **argv )
 		cout << "Must supply Lua file as First argument to program.\n";
         cout << "For example:\n";
         cout << "./A3 Assets/simpleScene.lua\n";
+        cout << "Or benchmark the .obj decoders with:\n";
+        cout << "./A3 --bench-obj [--repetitions N] [file.obj ...]\n";
+        cout << "Or compare startup from .obj text against the mesh cache with:\n";
+        cout << "./A3 --bench-mesh-cache [--repetitions N]\n";
+        cout << "Or benchmark keyframe animation with:\n";
+        cout << "./A3 --bench-animation [--joints N] [--keys N] [--repetitions N]\n";
+        cout << "Or check joint transforms for drift with:\n";
+        cout << "./A3 --check-joint-drift [--events N]\n";
+        cout << "Or benchmark the matrix kernels with:\n";
+        cout << "./A3 --bench-matrix [--count N] [--repetitions N]\n";
+        cout << "Or benchmark skinning against the rigid parts of a scene with:\n";
+        cout << "./A3 --bench-skinning Assets/spider_main.lua [--repetitions N]\n";
+        cout << "Or render the poses and cameras of a job file to images, without a window:\n";
+        cout << "./A3 --render-batch Assets/spider_main.lua jobs.txt [--out DIR] [--size WxH]\n";
+        cout << "Or report compact vertex format errors with:\n";
+        cout << "./A3 --quantization-error [file.obj ...]\n";
 	}
 
 	return 0;
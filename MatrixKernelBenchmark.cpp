@@ -0,0 +1,185 @@
+#include "MatrixKernelBenchmark.hpp"
+
+#include "BenchmarkTiming.hpp"
+#include "MatrixKernels.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace glm;
+using namespace std;
+
+namespace {
+
+// Largest allowed difference from glm, in float epsilons of the largest entry.  Fused
+// multiply-adds round differently; normal matrices are computed with another formula
+// than glm::inverse(), and hierarchy errors add up with depth.
+const double ProductTolerance = 8.0;
+const double NormalTolerance = 64.0;
+const double HierarchyTolerance = 64.0;
+
+// Random rotation, non-uniform scale in [0.5, 2] and translation, like scene nodes.
+mat4 randomTransform(mt19937 & random) {
+	uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	uniform_real_distribution<float> scale(0.5f, 2.0f);
+	vec3 axis(unit(random), unit(random), unit(random));
+	if (dot(axis, axis) < 1e-4f) {
+		axis = vec3(0.0f, 1.0f, 0.0f);
+	}
+	return glm::translate(vec3(unit(random), unit(random), unit(random)) * 5.0f)
+		* glm::rotate(3.14159265f * unit(random), normalize(axis))
+		* glm::scale(vec3(scale(random), scale(random), scale(random)));
+}
+
+// Largest entry difference between a and b over the largest entry of b, in epsilons.
+template <class T>
+double relativeError(const T * a, const T * b, size_t n, size_t floatsPerItem) {
+	double worst = 0.0;
+	for (size_t i = 0; i < n; ++i) {
+		const float * x = reinterpret_cast<const float *>(&a[i]);
+		const float * y = reinterpret_cast<const float *>(&b[i]);
+		double largest = 0.0;
+		double difference = 0.0;
+		for (size_t k = 0; k < floatsPerItem; ++k) {
+			largest = max(largest, double(abs(y[k])));
+			difference = max(difference, double(abs(x[k] - y[k])));
+		}
+		if (!(difference <= largest)) {
+			// Non-finite results
+			return INFINITY;
+		}
+		worst = max(worst, difference / (largest * FLT_EPSILON));
+	}
+	return worst;
+}
+
+void reportRow(const char * kernel, const char * isa, size_t count, double seconds,
+		double error, double tolerance, bool & allWithin) {
+	cout << left << setw(20) << kernel << setw(10) << isa << right << fixed
+		 << setw(14) << setprecision(1) << count / seconds * 1e-6;
+	if (error < 0.0) {
+		cout << setw(14) << "-" << endl;
+		return;
+	}
+	bool within = error <= tolerance;
+	allWithin = allWithin && within;
+	cout << setw(14) << setprecision(2) << error << (within ? "" : "  OUT OF TOLERANCE")
+		 << endl;
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+int runMatrixKernelBenchmark(unsigned int count, unsigned int repetitions) {
+	count = max(count, 1u);
+	repetitions = max(repetitions, 1u);
+
+	mt19937 random(488);
+	vector<mat4> a(count), b(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		a[i] = randomTransform(random);
+		b[i] = randomTransform(random);
+	}
+	const mat4 view = randomTransform(random);
+
+	// Pre-order forest with parents at most 8 nodes back, like a shallow scene graph.
+	vector<int> parent(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		parent[i] = (i % 64 == 0) ? -1
+			: int(i) - 1 - int(random() % min(i % 64, 8u));
+	}
+
+	// glm references, timed as the baseline.
+	vector<mat4> broadcastReference(count), pairsReference(count), hierarchyReference(count);
+	vector<NormalMatrix> normalReference(count);
+	double broadcastGlm = bestTime([&]() {
+		for (unsigned int i = 0; i < count; ++i) {
+			broadcastReference[i] = view * b[i];
+		}
+	}, repetitions);
+	double pairsGlm = bestTime([&]() {
+		for (unsigned int i = 0; i < count; ++i) {
+			pairsReference[i] = a[i] * b[i];
+		}
+	}, repetitions);
+	double hierarchyGlm = bestTime([&]() {
+		for (unsigned int i = 0; i < count; ++i) {
+			hierarchyReference[i] = parent[i] < 0 ? b[i] : hierarchyReference[parent[i]] * b[i];
+		}
+	}, repetitions);
+	double normalGlm = bestTime([&]() {
+		for (unsigned int i = 0; i < count; ++i) {
+			mat3 normalMatrix = glm::transpose(glm::inverse(mat3(a[i])));
+			for (int c = 0; c < 3; ++c) {
+				normalReference[i].columns[c] = vec4(normalMatrix[c], 0.0f);
+			}
+		}
+	}, repetitions);
+
+	cout << "Kernels over " << count << " matrices, best of " << repetitions
+		 << " repetition(s), errors in float epsilons" << endl;
+	cout << left << setw(20) << "kernel" << setw(10) << "isa" << right
+		 << setw(14) << "Mmatrices/s"
+		 << setw(14) << "max error" << endl;
+
+	bool allWithin = true;
+	reportRow("view * m", "glm", count, broadcastGlm, -1.0, 0.0, allWithin);
+	reportRow("a * b", "glm", count, pairsGlm, -1.0, 0.0, allWithin);
+	reportRow("hierarchy", "glm", count, hierarchyGlm, -1.0, 0.0, allWithin);
+	reportRow("normal matrix", "glm", count, normalGlm, -1.0, 0.0, allWithin);
+
+	const MatrixKernels::Isa detected = MatrixKernels::activeIsa();
+	const MatrixKernels::Isa isas[] = {
+		MatrixKernels::Isa::Scalar,
+		MatrixKernels::Isa::Sse,
+		MatrixKernels::Isa::Avx2
+	};
+	vector<mat4> out(count);
+	vector<NormalMatrix> normals(count);
+	for (MatrixKernels::Isa isa : isas) {
+		if (!MatrixKernels::setIsa(isa)) {
+			continue;
+		}
+		const char * name = MatrixKernels::isaName(isa);
+
+		double seconds = bestTime([&]() {
+			MatrixKernels::multiply(view, b.data(), out.data(), count);
+		}, repetitions);
+		reportRow("view * m", name, count, seconds,
+				relativeError(out.data(), broadcastReference.data(), count, 16),
+				ProductTolerance, allWithin);
+
+		seconds = bestTime([&]() {
+			MatrixKernels::multiply(a.data(), b.data(), out.data(), count);
+		}, repetitions);
+		reportRow("a * b", name, count, seconds,
+				relativeError(out.data(), pairsReference.data(), count, 16),
+				ProductTolerance, allWithin);
+
+		seconds = bestTime([&]() {
+			MatrixKernels::evaluateHierarchy(parent.data(), b.data(), out.data(), count);
+		}, repetitions);
+		reportRow("hierarchy", name, count, seconds,
+				relativeError(out.data(), hierarchyReference.data(), count, 16),
+				HierarchyTolerance, allWithin);
+
+		seconds = bestTime([&]() {
+			MatrixKernels::normalMatrices(a.data(), normals.data(), count);
+		}, repetitions);
+		reportRow("normal matrix", name, count, seconds,
+				relativeError(normals.data(), normalReference.data(), count, 12),
+				NormalTolerance, allWithin);
+	}
+	MatrixKernels::setIsa(detected);
+
+	cout << "Selected at runtime: " << MatrixKernels::isaName(detected) << endl;
+	return allWithin ? 0 : 1;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// Time every MatrixKernels kernel on each instruction set the CPU supports, and scalar
+// glm for reference, over count generated transforms.  Reports millions of matrices
+// per second (best of repetitions) and the largest difference from glm in units of
+// float epsilon, relative to the size of the entries.  Returns 0 if every kernel was
+// within tolerance, 1 otherwise.
+int runMatrixKernelBenchmark(unsigned int count, unsigned int repetitions);
@@ -0,0 +1,447 @@
+#include "MatrixKernels.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MATRIX_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace glm;
+using namespace std;
+
+//---------------------------------------------------------------------------------------
+glm::mat3 NormalMatrix::toMat3() const {
+	return mat3(vec3(columns[0]), vec3(columns[1]), vec3(columns[2]));
+}
+
+namespace {
+
+typedef void (*MultiplyBroadcastFunction)(const mat4 &, const mat4 *, mat4 *, size_t);
+typedef void (*MultiplyPairsFunction)(const mat4 *, const mat4 *, mat4 *, size_t);
+typedef void (*HierarchyFunction)(const int *, const mat4 *, mat4 *, size_t);
+typedef void (*NormalMatricesFunction)(const mat4 *, NormalMatrix *, size_t);
+
+struct KernelTable {
+	MultiplyBroadcastFunction multiplyBroadcast;
+	MultiplyPairsFunction multiplyPairs;
+	HierarchyFunction hierarchy;
+	NormalMatricesFunction normalMatrices;
+};
+
+//-- Scalar ------------------------------------------------------------------------------
+
+// Same summation order as glm, so the result is bit-identical.
+inline void multiplyScalar(const float * a, const float * b, float * out) {
+	float result[16];
+	for (int j = 0; j < 4; ++j) {
+		for (int r = 0; r < 4; ++r) {
+			result[4 * j + r] = a[r] * b[4 * j] + a[4 + r] * b[4 * j + 1]
+				+ a[8 + r] * b[4 * j + 2] + a[12 + r] * b[4 * j + 3];
+		}
+	}
+	for (int i = 0; i < 16; ++i) {
+		out[i] = result[i];
+	}
+}
+
+// Columns of the inverse transpose are the cross products of the other two columns,
+// over the determinant.
+inline void normalMatrixScalar(const float * m, float * out) {
+	const float * c0 = m;
+	const float * c1 = m + 4;
+	const float * c2 = m + 8;
+	float cross[3][3] = {
+		{ c1[1] * c2[2] - c1[2] * c2[1], c1[2] * c2[0] - c1[0] * c2[2], c1[0] * c2[1] - c1[1] * c2[0] },
+		{ c2[1] * c0[2] - c2[2] * c0[1], c2[2] * c0[0] - c2[0] * c0[2], c2[0] * c0[1] - c2[1] * c0[0] },
+		{ c0[1] * c1[2] - c0[2] * c1[1], c0[2] * c1[0] - c0[0] * c1[2], c0[0] * c1[1] - c0[1] * c1[0] }
+	};
+	float invDet = 1.0f / (c0[0] * cross[0][0] + c0[1] * cross[0][1] + c0[2] * cross[0][2]);
+	for (int c = 0; c < 3; ++c) {
+		out[4 * c] = cross[c][0] * invDet;
+		out[4 * c + 1] = cross[c][1] * invDet;
+		out[4 * c + 2] = cross[c][2] * invDet;
+		out[4 * c + 3] = 0.0f;
+	}
+}
+
+void multiplyBroadcastScalar(const mat4 & a, const mat4 * b, mat4 * out, size_t n) {
+	const mat4 left = a;   // a may be one of the matrices being overwritten
+	for (size_t i = 0; i < n; ++i) {
+		multiplyScalar(&left[0][0], &b[i][0][0], &out[i][0][0]);
+	}
+}
+
+void multiplyPairsScalar(const mat4 * a, const mat4 * b, mat4 * out, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		multiplyScalar(&a[i][0][0], &b[i][0][0], &out[i][0][0]);
+	}
+}
+
+void hierarchyScalar(const int * parent, const mat4 * local, mat4 * world, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		if (parent[i] < 0) {
+			world[i] = local[i];
+		} else {
+			multiplyScalar(&world[parent[i]][0][0], &local[i][0][0], &world[i][0][0]);
+		}
+	}
+}
+
+void normalMatricesScalar(const mat4 * m, NormalMatrix * out, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		normalMatrixScalar(&m[i][0][0], &out[i].columns[0][0]);
+	}
+}
+
+const KernelTable ScalarKernels = {
+	multiplyBroadcastScalar,
+	multiplyPairsScalar,
+	hierarchyScalar,
+	normalMatricesScalar
+};
+
+#if MATRIX_KERNELS_X86
+
+//-- SSE ---------------------------------------------------------------------------------
+
+// Multiplies and adds in glm's order, without fusing, so the result is bit-identical.
+inline void multiplySse(__m128 a0, __m128 a1, __m128 a2, __m128 a3, const float * b,
+		float * out) {
+	__m128 columns[4];
+	for (int j = 0; j < 4; ++j) {
+		__m128 column = _mm_loadu_ps(b + 4 * j);
+		__m128 sum = _mm_mul_ps(a0, _mm_shuffle_ps(column, column, 0x00));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_shuffle_ps(column, column, 0x55)));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_shuffle_ps(column, column, 0xAA)));
+		columns[j] = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_shuffle_ps(column, column, 0xFF)));
+	}
+	for (int j = 0; j < 4; ++j) {
+		_mm_storeu_ps(out + 4 * j, columns[j]);
+	}
+}
+
+void multiplyBroadcastSse(const mat4 & a, const mat4 * b, mat4 * out, size_t n) {
+	const float * left = &a[0][0];
+	const __m128 a0 = _mm_loadu_ps(left);
+	const __m128 a1 = _mm_loadu_ps(left + 4);
+	const __m128 a2 = _mm_loadu_ps(left + 8);
+	const __m128 a3 = _mm_loadu_ps(left + 12);
+	for (size_t i = 0; i < n; ++i) {
+		multiplySse(a0, a1, a2, a3, &b[i][0][0], &out[i][0][0]);
+	}
+}
+
+void multiplyPairsSse(const mat4 * a, const mat4 * b, mat4 * out, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		const float * left = &a[i][0][0];
+		multiplySse(_mm_loadu_ps(left), _mm_loadu_ps(left + 4), _mm_loadu_ps(left + 8),
+				_mm_loadu_ps(left + 12), &b[i][0][0], &out[i][0][0]);
+	}
+}
+
+void hierarchySse(const int * parent, const mat4 * local, mat4 * world, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		if (parent[i] < 0) {
+			world[i] = local[i];
+			continue;
+		}
+		const float * left = &world[parent[i]][0][0];
+		multiplySse(_mm_loadu_ps(left), _mm_loadu_ps(left + 4), _mm_loadu_ps(left + 8),
+				_mm_loadu_ps(left + 12), &local[i][0][0], &world[i][0][0]);
+	}
+}
+
+// Lane-wise cross products and determinant of four matrices held as
+// x/y/z components of their three columns.  Overwrites the columns with the result.
+inline void normalMatricesLanesSse(__m128 x[3], __m128 y[3], __m128 z[3]) {
+	__m128 cx[3], cy[3], cz[3];
+	for (int c = 0; c < 3; ++c) {
+		const int p = (c + 1) % 3;
+		const int q = (c + 2) % 3;
+		cx[c] = _mm_sub_ps(_mm_mul_ps(y[p], z[q]), _mm_mul_ps(z[p], y[q]));
+		cy[c] = _mm_sub_ps(_mm_mul_ps(z[p], x[q]), _mm_mul_ps(x[p], z[q]));
+		cz[c] = _mm_sub_ps(_mm_mul_ps(x[p], y[q]), _mm_mul_ps(y[p], x[q]));
+	}
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[0], cx[0]), _mm_mul_ps(y[0], cy[0])),
+			_mm_mul_ps(z[0], cz[0]));
+	__m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+	for (int c = 0; c < 3; ++c) {
+		x[c] = _mm_mul_ps(cx[c], invDet);
+		y[c] = _mm_mul_ps(cy[c], invDet);
+		z[c] = _mm_mul_ps(cz[c], invDet);
+	}
+}
+
+void normalMatricesSse(const mat4 * m, NormalMatrix * out, size_t n) {
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		// Transpose column c of four matrices into x, y and z of four lanes.
+		__m128 x[3], y[3], z[3];
+		for (int c = 0; c < 3; ++c) {
+			__m128 r0 = _mm_loadu_ps(&m[i][c][0]);
+			__m128 r1 = _mm_loadu_ps(&m[i + 1][c][0]);
+			__m128 r2 = _mm_loadu_ps(&m[i + 2][c][0]);
+			__m128 r3 = _mm_loadu_ps(&m[i + 3][c][0]);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			x[c] = r0;
+			y[c] = r1;
+			z[c] = r2;
+		}
+		normalMatricesLanesSse(x, y, z);
+		for (int c = 0; c < 3; ++c) {
+			__m128 r0 = x[c];
+			__m128 r1 = y[c];
+			__m128 r2 = z[c];
+			__m128 r3 = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(&out[i].columns[c][0], r0);
+			_mm_storeu_ps(&out[i + 1].columns[c][0], r1);
+			_mm_storeu_ps(&out[i + 2].columns[c][0], r2);
+			_mm_storeu_ps(&out[i + 3].columns[c][0], r3);
+		}
+	}
+	normalMatricesScalar(m + i, out + i, n - i);
+}
+
+const KernelTable SseKernels = {
+	multiplyBroadcastSse,
+	multiplyPairsSse,
+	hierarchySse,
+	normalMatricesSse
+};
+
+//-- AVX2 + FMA --------------------------------------------------------------------------
+
+#define MATRIX_KERNELS_AVX2 __attribute__((target("avx2,fma")))
+
+// Two output columns per 256-bit register: a's columns are repeated in both halves and
+// each half broadcasts the elements of its own column of b.
+MATRIX_KERNELS_AVX2
+inline void multiplyAvx2(__m256 a0, __m256 a1, __m256 a2, __m256 a3, const float * b,
+		float * out) {
+	__m256 b01 = _mm256_loadu_ps(b);
+	__m256 b23 = _mm256_loadu_ps(b + 8);
+	__m256 r01 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, 0x00));
+	__m256 r23 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b23, b23, 0x00));
+	r01 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b01, b01, 0x55), r01);
+	r23 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b23, b23, 0x55), r23);
+	r01 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b01, b01, 0xAA), r01);
+	r23 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b23, b23, 0xAA), r23);
+	r01 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b01, b01, 0xFF), r01);
+	r23 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b23, b23, 0xFF), r23);
+	_mm256_storeu_ps(out, r01);
+	_mm256_storeu_ps(out + 8, r23);
+}
+
+MATRIX_KERNELS_AVX2
+inline __m256 broadcastColumn(const float * column) {
+	return _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(column));
+}
+
+MATRIX_KERNELS_AVX2
+void multiplyBroadcastAvx2(const mat4 & a, const mat4 * b, mat4 * out, size_t n) {
+	const float * left = &a[0][0];
+	const __m256 a0 = broadcastColumn(left);
+	const __m256 a1 = broadcastColumn(left + 4);
+	const __m256 a2 = broadcastColumn(left + 8);
+	const __m256 a3 = broadcastColumn(left + 12);
+	for (size_t i = 0; i < n; ++i) {
+		multiplyAvx2(a0, a1, a2, a3, &b[i][0][0], &out[i][0][0]);
+	}
+}
+
+MATRIX_KERNELS_AVX2
+void multiplyPairsAvx2(const mat4 * a, const mat4 * b, mat4 * out, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		const float * left = &a[i][0][0];
+		multiplyAvx2(broadcastColumn(left), broadcastColumn(left + 4),
+				broadcastColumn(left + 8), broadcastColumn(left + 12), &b[i][0][0],
+				&out[i][0][0]);
+	}
+}
+
+MATRIX_KERNELS_AVX2
+void hierarchyAvx2(const int * parent, const mat4 * local, mat4 * world, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		if (parent[i] < 0) {
+			world[i] = local[i];
+			continue;
+		}
+		const float * left = &world[parent[i]][0][0];
+		multiplyAvx2(broadcastColumn(left), broadcastColumn(left + 4),
+				broadcastColumn(left + 8), broadcastColumn(left + 12), &local[i][0][0],
+				&world[i][0][0]);
+	}
+}
+
+// _MM_TRANSPOSE4_PS within each 128-bit half.
+MATRIX_KERNELS_AVX2
+inline void transposeHalves(__m256 & r0, __m256 & r1, __m256 & r2, __m256 & r3) {
+	__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+	__m256 t1 = _mm256_unpacklo_ps(r2, r3);
+	__m256 t2 = _mm256_unpackhi_ps(r0, r1);
+	__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+	r0 = _mm256_shuffle_ps(t0, t1, 0x44);
+	r1 = _mm256_shuffle_ps(t0, t1, 0xEE);
+	r2 = _mm256_shuffle_ps(t2, t3, 0x44);
+	r3 = _mm256_shuffle_ps(t2, t3, 0xEE);
+}
+
+MATRIX_KERNELS_AVX2
+inline __m256 loadHalves(const float * low, const float * high) {
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)),
+			_mm_loadu_ps(high), 1);
+}
+
+MATRIX_KERNELS_AVX2
+inline void storeHalves(float * low, float * high, __m256 value) {
+	_mm_storeu_ps(low, _mm256_castps256_ps128(value));
+	_mm_storeu_ps(high, _mm256_extractf128_ps(value, 1));
+}
+
+// Eight matrices at a time, i..i+3 in the low halves and i+4..i+7 in the high halves.
+MATRIX_KERNELS_AVX2
+void normalMatricesAvx2(const mat4 * m, NormalMatrix * out, size_t n) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 x[3], y[3], z[3];
+		for (int c = 0; c < 3; ++c) {
+			__m256 r0 = loadHalves(&m[i][c][0], &m[i + 4][c][0]);
+			__m256 r1 = loadHalves(&m[i + 1][c][0], &m[i + 5][c][0]);
+			__m256 r2 = loadHalves(&m[i + 2][c][0], &m[i + 6][c][0]);
+			__m256 r3 = loadHalves(&m[i + 3][c][0], &m[i + 7][c][0]);
+			transposeHalves(r0, r1, r2, r3);
+			x[c] = r0;
+			y[c] = r1;
+			z[c] = r2;
+		}
+
+		__m256 cx[3], cy[3], cz[3];
+		for (int c = 0; c < 3; ++c) {
+			const int p = (c + 1) % 3;
+			const int q = (c + 2) % 3;
+			cx[c] = _mm256_fmsub_ps(y[p], z[q], _mm256_mul_ps(z[p], y[q]));
+			cy[c] = _mm256_fmsub_ps(z[p], x[q], _mm256_mul_ps(x[p], z[q]));
+			cz[c] = _mm256_fmsub_ps(x[p], y[q], _mm256_mul_ps(y[p], x[q]));
+		}
+		__m256 det = _mm256_fmadd_ps(z[0], cz[0],
+				_mm256_fmadd_ps(y[0], cy[0], _mm256_mul_ps(x[0], cx[0])));
+		__m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+		for (int c = 0; c < 3; ++c) {
+			__m256 r0 = _mm256_mul_ps(cx[c], invDet);
+			__m256 r1 = _mm256_mul_ps(cy[c], invDet);
+			__m256 r2 = _mm256_mul_ps(cz[c], invDet);
+			__m256 r3 = _mm256_setzero_ps();
+			transposeHalves(r0, r1, r2, r3);
+			storeHalves(&out[i].columns[c][0], &out[i + 4].columns[c][0], r0);
+			storeHalves(&out[i + 1].columns[c][0], &out[i + 5].columns[c][0], r1);
+			storeHalves(&out[i + 2].columns[c][0], &out[i + 6].columns[c][0], r2);
+			storeHalves(&out[i + 3].columns[c][0], &out[i + 7].columns[c][0], r3);
+		}
+	}
+	normalMatricesSse(m + i, out + i, n - i);
+}
+
+const KernelTable Avx2Kernels = {
+	multiplyBroadcastAvx2,
+	multiplyPairsAvx2,
+	hierarchyAvx2,
+	normalMatricesAvx2
+};
+
+#endif // MATRIX_KERNELS_X86
+
+const KernelTable * kernelTable(MatrixKernels::Isa isa) {
+	switch (isa) {
+#if MATRIX_KERNELS_X86
+		case MatrixKernels::Isa::Avx2:
+			return &Avx2Kernels;
+		case MatrixKernels::Isa::Sse:
+			return &SseKernels;
+#endif
+		default:
+			return &ScalarKernels;
+	}
+}
+
+MatrixKernels::Isa detectIsa() {
+#if MATRIX_KERNELS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return MatrixKernels::Isa::Avx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return MatrixKernels::Isa::Sse;
+	}
+#endif
+	return MatrixKernels::Isa::Scalar;
+}
+
+struct Dispatch {
+	Dispatch() : isa(detectIsa()), kernels(kernelTable(isa)) {}
+
+	MatrixKernels::Isa isa;
+	const KernelTable * kernels;
+};
+
+Dispatch & dispatch() {
+	static Dispatch instance;
+	return instance;
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+MatrixKernels::Isa MatrixKernels::activeIsa() {
+	return dispatch().isa;
+}
+
+//---------------------------------------------------------------------------------------
+const char * MatrixKernels::isaName(Isa isa) {
+	switch (isa) {
+		case Isa::Sse:
+			return "SSE";
+		case Isa::Avx2:
+			return "AVX2+FMA";
+		default:
+			return "scalar";
+	}
+}
+
+//---------------------------------------------------------------------------------------
+bool MatrixKernels::isaSupported(Isa isa) {
+	return int(isa) <= int(detectIsa());
+}
+
+//---------------------------------------------------------------------------------------
+bool MatrixKernels::setIsa(Isa isa) {
+	if (!isaSupported(isa)) {
+		return false;
+	}
+	dispatch().isa = isa;
+	dispatch().kernels = kernelTable(isa);
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+void MatrixKernels::multiply(const glm::mat4 & a, const glm::mat4 * b, glm::mat4 * out,
+		size_t n) {
+	dispatch().kernels->multiplyBroadcast(a, b, out, n);
+}
+
+//---------------------------------------------------------------------------------------
+void MatrixKernels::multiply(const glm::mat4 * a, const glm::mat4 * b, glm::mat4 * out,
+		size_t n) {
+	dispatch().kernels->multiplyPairs(a, b, out, n);
+}
+
+//---------------------------------------------------------------------------------------
+void MatrixKernels::evaluateHierarchy(const int * parent, const glm::mat4 * local,
+		glm::mat4 * world, size_t n) {
+	dispatch().kernels->hierarchy(parent, local, world, n);
+}
+
+//---------------------------------------------------------------------------------------
+void MatrixKernels::normalMatrices(const glm::mat4 * m, NormalMatrix * out, size_t n) {
+	dispatch().kernels->normalMatrices(m, out, n);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Inverse transpose of the upper 3x3 of a transform, with each column padded to a vec4
+// as in InstanceData.  w is 0.
+struct NormalMatrix {
+	glm::vec4 columns[3];
+
+	glm::mat3 toMat3() const;
+};
+
+// Batched 4x4 transform kernels over contiguous arrays.  Each kernel has a scalar, an
+// SSE and an AVX2 + FMA version; the fastest one the CPU supports is picked on first
+// use.  SSE products round exactly like glm's mat4 product.  AVX2 products fuse the
+// multiply-adds and may differ from glm in the last bits.
+namespace MatrixKernels {
+
+enum class Isa {
+	Scalar,
+	Sse,
+	Avx2
+};
+
+Isa activeIsa();
+const char * isaName(Isa isa);
+bool isaSupported(Isa isa);
+
+// Use isa for every later call, for benchmarks and comparisons.  Returns false, and
+// changes nothing, if the CPU lacks it.
+bool setIsa(Isa isa);
+
+// out[i] = a * b[i].  out may alias b.
+void multiply(const glm::mat4 & a, const glm::mat4 * b, glm::mat4 * out, size_t n);
+
+// out[i] = a[i] * b[i].  out may alias a or b.
+void multiply(const glm::mat4 * a, const glm::mat4 * b, glm::mat4 * out, size_t n);
+
+// world[i] = local[i] if parent[i] < 0, else world[parent[i]] * local[i].  Parents
+// must come before their children, as in a FlatSceneGraph.
+void evaluateHierarchy(const int * parent, const glm::mat4 * local, glm::mat4 * world,
+		size_t n);
+
+// out[i] = transpose(inverse(mat3(m[i]))).  Singular matrices give non-finite values.
+void normalMatrices(const glm::mat4 * m, NormalMatrix * out, size_t n);
+
+} // namespace MatrixKernels
@@ -0,0 +1,309 @@
+#include "MeshCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char MeshCacheMagic[8] = { 'P', '3', 'D', 'M', 'E', 'S', 'H', '\0' };
+const size_t MeshIdLength = 64;
+
+struct MeshCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t numSources;
+	uint32_t numBatches;
+	uint32_t numIndices;
+	uint64_t numVertices;
+};
+
+struct MeshCacheSource {
+	uint64_t pathHash;
+	uint64_t size;
+	int64_t mtime;
+};
+
+struct MeshCacheBatch {
+	char meshId[MeshIdLength];
+	uint32_t level;       // 0 for the full mesh
+	float error;
+	uint32_t startIndex;
+	uint32_t numIndices;
+};
+
+// FNV-1a, only used to tell source paths apart.
+uint64_t hashPath(const string & path) {
+	uint64_t hash = 14695981039346656037ull;
+	for (unsigned char c : path) {
+		hash = (hash ^ c) * 1099511628211ull;
+	}
+	return hash;
+}
+
+bool describeSource(const string & path, MeshCacheSource & source) {
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) {
+		return false;
+	}
+	source.pathHash = hashPath(path);
+	source.size = uint64_t(info.st_size);
+	source.mtime = int64_t(info.st_mtime);
+	return true;
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+MeshCache::MeshCache()
+	: m_mapping(nullptr),
+	  m_mappingSize(0),
+	  m_positions(nullptr),
+	  m_normals(nullptr),
+	  m_numVertices(0),
+	  m_indices(nullptr),
+	  m_numIndices(0)
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+MeshCache::~MeshCache() {
+	close();
+}
+
+//---------------------------------------------------------------------------------------
+bool MeshCache::open(const std::string & cachePath, const std::vector<std::string> & sourceFiles) {
+	close();
+
+	int fd = ::open(cachePath.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(MeshCacheHeader)) {
+		::close(fd);
+		return false;
+	}
+	m_mappingSize = size_t(info.st_size);
+	m_mapping = mmap(nullptr, m_mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (m_mapping == MAP_FAILED) {
+		m_mapping = nullptr;
+		m_mappingSize = 0;
+		return false;
+	}
+
+	const char * data = static_cast<const char *>(m_mapping);
+	const MeshCacheHeader * header = reinterpret_cast<const MeshCacheHeader *>(data);
+	if (memcmp(header->magic, MeshCacheMagic, sizeof(MeshCacheMagic)) != 0
+			|| header->version != Version
+			|| header->numSources != sourceFiles.size()) {
+		close();
+		return false;
+	}
+
+	size_t sourcesOffset = sizeof(MeshCacheHeader);
+	size_t batchesOffset = sourcesOffset + header->numSources * sizeof(MeshCacheSource);
+	size_t positionsOffset = batchesOffset + header->numBatches * sizeof(MeshCacheBatch);
+	size_t vertexBytes = size_t(header->numVertices) * 3 * sizeof(float);
+	size_t indexBytes = size_t(header->numIndices) * sizeof(uint32_t);
+	if (positionsOffset + 2 * vertexBytes + indexBytes != m_mappingSize) {
+		close();
+		return false;
+	}
+
+	// Stale if any source .obj changed since the cache was written.
+	const MeshCacheSource * sources =
+			reinterpret_cast<const MeshCacheSource *>(data + sourcesOffset);
+	for (size_t i = 0; i < sourceFiles.size(); ++i) {
+		MeshCacheSource current;
+		if (!describeSource(sourceFiles[i], current)
+				|| current.pathHash != sources[i].pathHash
+				|| current.size != sources[i].size
+				|| current.mtime != sources[i].mtime) {
+			close();
+			return false;
+		}
+	}
+
+	const MeshCacheBatch * batches =
+			reinterpret_cast<const MeshCacheBatch *>(data + batchesOffset);
+	for (uint32_t i = 0; i < header->numBatches; ++i) {
+		string meshId(batches[i].meshId, strnlen(batches[i].meshId, MeshIdLength));
+		BatchInfo batchInfo = { batches[i].startIndex, batches[i].numIndices };
+		if (batches[i].level == 0) {
+			m_batchInfoMap[meshId] = batchInfo;
+			continue;
+		}
+		// Levels are written finest first.
+		vector<LodBatch> & lods = m_lodBatchMap[meshId];
+		if (batches[i].level != lods.size() + 1) {
+			close();
+			return false;
+		}
+		lods.push_back(LodBatch{ batchInfo, batches[i].error });
+	}
+
+	m_numVertices = size_t(header->numVertices);
+	m_positions = reinterpret_cast<const float *>(data + positionsOffset);
+	m_normals = reinterpret_cast<const float *>(data + positionsOffset + vertexBytes);
+	m_numIndices = size_t(header->numIndices);
+	m_indices = reinterpret_cast<const uint32_t *>(data + positionsOffset + 2 * vertexBytes);
+
+	// Vertex data is read once, front to back, for the VBO upload.
+	madvise(m_mapping, m_mappingSize, MADV_SEQUENTIAL);
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+void MeshCache::close() {
+	if (m_mapping) {
+		munmap(m_mapping, m_mappingSize);
+	}
+	m_mapping = nullptr;
+	m_mappingSize = 0;
+	m_positions = nullptr;
+	m_normals = nullptr;
+	m_numVertices = 0;
+	m_indices = nullptr;
+	m_numIndices = 0;
+	m_batchInfoMap.clear();
+	m_lodBatchMap.clear();
+}
+
+//---------------------------------------------------------------------------------------
+bool MeshCache::isOpen() const {
+	return m_mapping != nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+const float * MeshCache::getVertexPositionDataPtr() const {
+	return m_positions;
+}
+
+//---------------------------------------------------------------------------------------
+const float * MeshCache::getVertexNormalDataPtr() const {
+	return m_normals;
+}
+
+//---------------------------------------------------------------------------------------
+size_t MeshCache::getNumVertexPositionBytes() const {
+	return m_numVertices * 3 * sizeof(float);
+}
+
+//---------------------------------------------------------------------------------------
+size_t MeshCache::getNumVertexNormalBytes() const {
+	return m_numVertices * 3 * sizeof(float);
+}
+
+//---------------------------------------------------------------------------------------
+const uint32_t * MeshCache::getIndexDataPtr() const {
+	return m_indices;
+}
+
+//---------------------------------------------------------------------------------------
+size_t MeshCache::getNumIndices() const {
+	return m_numIndices;
+}
+
+//---------------------------------------------------------------------------------------
+void MeshCache::getBatchInfoMap(BatchInfoMap & batchInfoMap) const {
+	batchInfoMap = m_batchInfoMap;
+}
+
+//---------------------------------------------------------------------------------------
+void MeshCache::getLodBatchMap(LodBatchMap & lodBatchMap) const {
+	lodBatchMap = m_lodBatchMap;
+}
+
+//---------------------------------------------------------------------------------------
+bool MeshCache::write(
+		const std::string & cachePath,
+		const std::vector<std::string> & sourceFiles,
+		const BatchInfoMap & batchInfoMap,
+		const LodBatchMap & lodBatchMap,
+		const float * positions,
+		const float * normals,
+		size_t numVertices,
+		const uint32_t * indices,
+		size_t numIndices
+) {
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic));
+	header.version = Version;
+	header.numSources = uint32_t(sourceFiles.size());
+	header.numBatches = uint32_t(batchInfoMap.size());
+	for (const auto & entry : lodBatchMap) {
+		header.numBatches += uint32_t(entry.second.size());
+	}
+	header.numIndices = uint32_t(numIndices);
+	header.numVertices = numVertices;
+
+	vector<MeshCacheSource> sources(sourceFiles.size());
+	for (size_t i = 0; i < sourceFiles.size(); ++i) {
+		if (!describeSource(sourceFiles[i], sources[i])) {
+			return false;
+		}
+	}
+
+	vector<MeshCacheBatch> batches;
+	auto addBatch = [&batches](const string & meshId, uint32_t level, float error,
+			const BatchInfo & batchInfo) {
+		if (meshId.size() >= MeshIdLength) {
+			return false;
+		}
+		MeshCacheBatch batch;
+		memset(&batch, 0, sizeof(batch));
+		memcpy(batch.meshId, meshId.data(), meshId.size());
+		batch.level = level;
+		batch.error = error;
+		batch.startIndex = batchInfo.startIndex;
+		batch.numIndices = batchInfo.numIndices;
+		batches.push_back(batch);
+		return true;
+	};
+	for (const auto & entry : batchInfoMap) {
+		if (!addBatch(entry.first, 0, 0.0f, entry.second)) {
+			return false;
+		}
+	}
+	for (const auto & entry : lodBatchMap) {
+		for (size_t level = 0; level < entry.second.size(); ++level) {
+			const LodBatch & lod = entry.second[level];
+			if (!addBatch(entry.first, uint32_t(level + 1), lod.error, lod.batchInfo)) {
+				return false;
+			}
+		}
+	}
+
+	// Write to a temporary name first so an interrupted write never leaves a
+	// truncated cache behind.
+	const size_t vertexBytes = numVertices * 3 * sizeof(float);
+	const size_t indexBytes = numIndices * sizeof(uint32_t);
+	string tempPath = cachePath + ".tmp";
+	FILE * file = fopen(tempPath.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(sources.data(), sizeof(MeshCacheSource), sources.size(), file) == sources.size();
+	ok = ok && fwrite(batches.data(), sizeof(MeshCacheBatch), batches.size(), file) == batches.size();
+	ok = ok && fwrite(positions, 1, vertexBytes, file) == vertexBytes;
+	ok = ok && fwrite(normals, 1, vertexBytes, file) == vertexBytes;
+	ok = ok && fwrite(indices, 1, indexBytes, file) == indexBytes;
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok || rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
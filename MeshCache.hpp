@@ -0,0 +1,86 @@
+#pragma once
+
+#include "cs488-framework/MeshConsolidator.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Simplified level of detail of a mesh: an index range into the same vertices as the
+// full mesh, and its largest distance from the full mesh in model units.
+struct LodBatch {
+	BatchInfo batchInfo;
+	float error;
+};
+
+// Coarser levels of each meshId, finest first.  Level 0, the full mesh, lives in the
+// BatchInfoMap.
+typedef std::unordered_map<std::string, std::vector<LodBatch>> LodBatchMap;
+
+// Versioned binary cache of preprocessed mesh data, so that startup can upload vertex
+// and index data straight from a memory-mapped file instead of parsing and
+// optimising .obj text.
+//
+// File layout (native byte order):
+//   MeshCacheHeader
+//   MeshCacheSource[numSources]   identifies each .obj the cache was built from
+//   MeshCacheBatch[numBatches]    meshId, level of detail, error, startIndex, numIndices
+//                                 into the index array
+//   float positions[3 * numVertices]
+//   float normals[3 * numVertices]
+//   uint32_t indices[numIndices]
+//
+// A cache is only used if every source file still has the recorded size and
+// modification time, so editing an .obj rebuilds it on the next launch.
+class MeshCache {
+public:
+	static const uint32_t Version = 3;
+
+	MeshCache();
+	~MeshCache();
+
+	// Map cachePath read-only and validate it against sourceFiles (same files, same
+	// order).  Returns false if the file is missing, stale, or of another version.
+	bool open(const std::string & cachePath, const std::vector<std::string> & sourceFiles);
+	void close();
+	bool isOpen() const;
+
+	// Same accessors as MeshConsolidator.  Pointers are into the mapping and stay valid
+	// until close().
+	const float * getVertexPositionDataPtr() const;
+	const float * getVertexNormalDataPtr() const;
+	size_t getNumVertexPositionBytes() const;
+	size_t getNumVertexNormalBytes() const;
+	const uint32_t * getIndexDataPtr() const;
+	size_t getNumIndices() const;
+	void getBatchInfoMap(BatchInfoMap & batchInfoMap) const;
+	void getLodBatchMap(LodBatchMap & lodBatchMap) const;
+
+	// Write indexed mesh data.  positions and normals hold 3 * numVertices floats each,
+	// and indices hold the ranges of both batch maps.  Returns false on I/O error.
+	static bool write(
+			const std::string & cachePath,
+			const std::vector<std::string> & sourceFiles,
+			const BatchInfoMap & batchInfoMap,
+			const LodBatchMap & lodBatchMap,
+			const float * positions,
+			const float * normals,
+			size_t numVertices,
+			const uint32_t * indices,
+			size_t numIndices
+	);
+
+private:
+	void * m_mapping;
+	size_t m_mappingSize;
+
+	const float * m_positions;
+	const float * m_normals;
+	size_t m_numVertices;
+	const uint32_t * m_indices;
+	size_t m_numIndices;
+	BatchInfoMap m_batchInfoMap;
+	LodBatchMap m_lodBatchMap;
+};
@@ -0,0 +1,160 @@
+#include "MeshCacheBenchmark.hpp"
+
+#include "cs488-framework/MeshConsolidator.hpp"
+
+#include "BenchmarkTiming.hpp"
+#include "MeshCache.hpp"
+#include "MeshLoader.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// About a million triangles, some 75 MB of .obj text.
+const unsigned int Rings = 512;
+const unsigned int Segments = 1024;
+
+void reportRow(const char * path, double seconds, double objSeconds) {
+	cout << left << setw(48) << path << right << fixed
+		 << setw(12) << setprecision(2) << seconds * 1e3
+		 << setw(10) << setprecision(2) << objSeconds / seconds << "x" << endl;
+}
+
+bool sameMesh(const LoadedMesh & a, const LoadedMesh & b) {
+	return a.numVertices == b.numVertices && a.numIndices == b.numIndices
+		&& memcmp(a.positions, b.positions, 3 * a.numVertices * sizeof(float)) == 0
+		&& memcmp(a.normals, b.normals, 3 * a.numVertices * sizeof(float)) == 0
+		&& memcmp(a.indices, b.indices, a.numIndices * sizeof(uint32_t)) == 0;
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+std::string writeDenseSphere(unsigned int rings, unsigned int segments) {
+	char path[] = "/tmp/puppet-dense-sphereXXXXXX.obj";
+	int fd = mkstemps(path, 4);
+	if (fd < 0) {
+		return string();
+	}
+	FILE * file = fdopen(fd, "w");
+	if (!file) {
+		close(fd);
+		unlink(path);
+		return string();
+	}
+
+	fprintf(file, "o dense_sphere\n");
+	for (unsigned int r = 0; r <= rings; ++r) {
+		double theta = M_PI * double(r) / rings;
+		for (unsigned int s = 0; s < segments; ++s) {
+			double phi = 2.0 * M_PI * double(s) / segments;
+			fprintf(file, "v %f %f %f\n",
+					sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+		}
+	}
+	for (unsigned int r = 0; r <= rings; ++r) {
+		double theta = M_PI * double(r) / rings;
+		for (unsigned int s = 0; s < segments; ++s) {
+			double phi = 2.0 * M_PI * double(s) / segments;
+			fprintf(file, "vn %f %f %f\n",
+					sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+		}
+	}
+	for (unsigned int r = 0; r < rings; ++r) {
+		for (unsigned int s = 0; s < segments; ++s) {
+			unsigned int a = r * segments + s + 1;
+			unsigned int b = r * segments + (s + 1) % segments + 1;
+			unsigned int c = a + segments;
+			unsigned int d = b + segments;
+			fprintf(file, "f %u//%u %u//%u %u//%u\n", a, a, c, c, b, b);
+			fprintf(file, "f %u//%u %u//%u %u//%u\n", b, b, c, c, d, d);
+		}
+	}
+
+	if (fclose(file) != 0) {
+		unlink(path);
+		return string();
+	}
+	return path;
+}
+
+//---------------------------------------------------------------------------------------
+int runMeshCacheBenchmark(unsigned int repetitions) {
+	repetitions = max(repetitions, 1u);
+
+	const string objPath = writeDenseSphere(Rings, Segments);
+	if (objPath.empty()) {
+		cerr << "Could not write a generated .obj file" << endl;
+		return 1;
+	}
+	const string cachePath = objPath + ".meshcache";
+	const vector<string> sourceFiles(1, objPath);
+
+	// MeshLoader looks meshIds up as <directory>/<meshId>.obj.
+	const size_t slash = objPath.rfind('/');
+	MeshLoader loader;
+	loader.addSearchPath(objPath.substr(0, slash));
+	const string meshId = objPath.substr(slash + 1, objPath.size() - slash - 5);
+
+	struct stat status;
+	stat(objPath.c_str(), &status);
+	cout << "Generated sphere of " << 2 * Rings * Segments << " triangles, "
+		 << setprecision(1) << fixed << status.st_size / 1048576.0 << " MB of .obj text, "
+		 << "best of " << repetitions << " repetition(s)" << endl;
+	cout << left << setw(48) << "path" << right << setw(12) << "ms" << setw(11)
+		 << "speedup" << endl;
+
+	double objSeconds = bestTime([&]() {
+		MeshConsolidator consolidator{ objPath };
+	}, repetitions);
+	reportRow("OBJ decode + MeshConsolidator", objSeconds, objSeconds);
+
+	// Simplifying a million triangles takes far longer than the rest and only happens
+	// once per edit of the .obj, so the miss is timed once.
+	unique_ptr<LoadedMesh> decoded;
+	double missSeconds = bestTime([&]() {
+		unlink(cachePath.c_str());
+		decoded = loader.load(meshId);
+	}, 1);
+	reportRow("Cache miss: decode, optimise, LODs, write", missSeconds, objSeconds);
+	const MeshOptimizationStats & stats = decoded->optimizationStats;
+	cout << "  optimised " << stats.soupVertices << " -> " << stats.weldedVertices
+		 << " vertices, ACMR " << setprecision(3) << stats.acmrBefore << " -> "
+		 << stats.acmrAfter << endl;
+
+	double writeSeconds = bestTime([&]() {
+		MeshCache::write(cachePath, sourceFiles, decoded->batchInfoMap,
+				decoded->lodBatchMap, decoded->positions, decoded->normals,
+				decoded->numVertices, decoded->indices, decoded->numIndices);
+	}, repetitions);
+	reportRow("MeshCache::write", writeSeconds, objSeconds);
+
+	unique_ptr<LoadedMesh> cached;
+	double hitSeconds = bestTime([&]() {
+		cached = loader.load(meshId);
+	}, repetitions);
+	reportRow("Cache hit: mmap open", hitSeconds, objSeconds);
+
+	const bool matched = cached && cached->fromCache && sameMesh(*decoded, *cached);
+	cout << (matched ? "Mapped cache matches the decoded mesh"
+			: "MISMATCH between the mapped cache and the decoded mesh") << endl;
+
+	cached.reset();
+	unlink(cachePath.c_str());
+	unlink(objPath.c_str());
+	return matched ? 0 : 1;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+// Startup cost of a large generated .obj mesh both ways: decoding the text and building
+// the arrays with MeshConsolidator, as the framework does, against writing a MeshCache
+// once and memory-mapping it on every later launch.  Also reports the full cache miss
+// of MeshLoader (decode, optimise, levels of detail and write), timed once, with the
+// vertex counts and ACMR before and after optimisation; the rest are best of repetitions.
+// Checks that the mapped cache holds what was written.  Returns 0 if it did, 1 otherwise.
+int runMeshCacheBenchmark(unsigned int repetitions);
+
+// Writes a latitude/longitude sphere of 2 * rings * segments triangles in the same
+// "v//vn" layout as Assets/sphere.obj to a new file under /tmp, and returns its path.
+// The caller removes the file.  Returns an empty string on failure.
+std::string writeDenseSphere(unsigned int rings, unsigned int segments);
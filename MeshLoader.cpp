@@ -0,0 +1,119 @@
+#include "MeshLoader.hpp"
+
+#include "ObjFastDecoder.hpp"
+#include "MeshSimplifier.hpp"
+
+#include <iostream>
+
+#include <sys/stat.h>
+
+using namespace glm;
+using namespace std;
+
+//---------------------------------------------------------------------------------------
+void MeshLoader::addSearchPath(const std::string & directory) {
+	if (directory.empty()) {
+		return;
+	}
+	if (directory.back() == '/') {
+		searchPaths.push_back(directory);
+	} else {
+		searchPaths.push_back(directory + "/");
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void MeshLoader::addSearchPaths(const char * pathList) {
+	if (pathList == nullptr) {
+		return;
+	}
+	string paths(pathList);
+	size_t begin = 0;
+	while (begin <= paths.size()) {
+		size_t end = paths.find(':', begin);
+		if (end == string::npos) {
+			end = paths.size();
+		}
+		addSearchPath(paths.substr(begin, end - begin));
+		begin = end + 1;
+	}
+}
+
+//---------------------------------------------------------------------------------------
+std::string MeshLoader::findMeshFile(const std::string & meshId) const {
+	for (const string & directory : searchPaths) {
+		string path = directory + meshId + ".obj";
+		struct stat info;
+		if (stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+			return path;
+		}
+	}
+	return string();
+}
+
+//---------------------------------------------------------------------------------------
+std::unique_ptr<LoadedMesh> MeshLoader::load(const std::string & meshId) const {
+	string path = findMeshFile(meshId);
+	if (path.empty()) {
+		return nullptr;
+	}
+
+	unique_ptr<LoadedMesh> mesh(new LoadedMesh());
+	mesh->path = path;
+
+	const vector<string> sourceFiles(1, path);
+	const string cachePath = path + ".meshcache";
+
+	unique_ptr<MeshCache> cache(new MeshCache());
+	if (cache->open(cachePath, sourceFiles)) {
+		cache->getBatchInfoMap(mesh->batchInfoMap);
+		cache->getLodBatchMap(mesh->lodBatchMap);
+		mesh->positions = cache->getVertexPositionDataPtr();
+		mesh->normals = cache->getVertexNormalDataPtr();
+		mesh->numVertices = cache->getNumVertexPositionBytes() / (3 * sizeof(float));
+		mesh->indices = cache->getIndexDataPtr();
+		mesh->numIndices = cache->getNumIndices();
+		mesh->fromCache = true;
+		mesh->optimizationStats = MeshOptimizationStats();
+		mesh->cache = move(cache);
+	} else {
+		string objectName;
+		vector<vec3> positions, normals;
+		ObjFastDecoder::decode(path.c_str(), objectName, positions, normals);
+
+		IndexedMesh & optimized = mesh->optimizedMesh;
+		mesh->optimizationStats = MeshOptimizer::optimize(
+				reinterpret_cast<const float *>(positions.data()),
+				reinterpret_cast<const float *>(normals.data()),
+				positions.size(), optimized);
+
+		mesh->batchInfoMap[objectName] = BatchInfo{ 0, unsigned(optimized.indices.size()) };
+
+		// Levels of detail reuse the full mesh's vertices, so they only add indices.
+		vector<SimplifiedLevel> levels = MeshSimplifier::buildLevels(
+				reinterpret_cast<const float *>(optimized.positions.data()),
+				optimized.positions.size(), optimized.indices.data(), optimized.indices.size());
+		for (const SimplifiedLevel & level : levels) {
+			BatchInfo batchInfo = { unsigned(optimized.indices.size()),
+					unsigned(level.indices.size()) };
+			mesh->lodBatchMap[objectName].push_back(LodBatch{ batchInfo, level.error });
+			optimized.indices.insert(optimized.indices.end(), level.indices.begin(),
+					level.indices.end());
+		}
+
+		mesh->positions = reinterpret_cast<const float *>(optimized.positions.data());
+		mesh->normals = reinterpret_cast<const float *>(optimized.normals.data());
+		mesh->numVertices = optimized.positions.size();
+		mesh->indices = optimized.indices.data();
+		mesh->numIndices = optimized.indices.size();
+		mesh->fromCache = false;
+
+		if (!MeshCache::write(cachePath, sourceFiles, mesh->batchInfoMap, mesh->lodBatchMap,
+				mesh->positions, mesh->normals, mesh->numVertices,
+				mesh->indices, mesh->numIndices)) {
+			cerr << "Could not write mesh cache " << cachePath << endl;
+		}
+	}
+
+	return mesh;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "cs488-framework/MeshConsolidator.hpp"
+
+#include "MeshCache.hpp"
+#include "MeshOptimizer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// CPU-side indexed mesh data of one .obj file.  Points either into a memory-mapped
+// MeshCache or into the optimised arrays, whichever this object owns.
+struct LoadedMesh {
+	std::string path;
+	BatchInfoMap batchInfoMap;    // Index ranges, relative to this file's indices
+	LodBatchMap lodBatchMap;      // Simplified levels, stored after the full meshes
+	const float * positions;
+	const float * normals;
+	size_t numVertices;
+	const uint32_t * indices;     // Relative to this file's vertices
+	size_t numIndices;
+	bool fromCache;
+
+	// Only filled in when the .obj was decoded and optimised rather than read from
+	// the cache.
+	MeshOptimizationStats optimizationStats;
+
+	std::unique_ptr<MeshCache> cache;
+	IndexedMesh optimizedMesh;
+};
+
+// Finds and loads the .obj file of a meshId on demand.  A meshId 'foo' is looked up
+// as 'foo.obj' in each search path in turn, and each file gets its own binary cache
+// ('foo.obj.meshcache') next to it.  Decoded files are welded and reordered by
+// MeshOptimizer, and get their levels of detail from MeshSimplifier, before they are
+// cached.
+class MeshLoader {
+public:
+	// Directories are searched in the order they were added.
+	void addSearchPath(const std::string & directory);
+
+	// Add every entry of a ':' separated list, e.g. the value of an environment
+	// variable.  Does nothing for a null or empty list.
+	void addSearchPaths(const char * pathList);
+
+	// Returns the path of meshId's .obj file, or an empty string if there is none.
+	std::string findMeshFile(const std::string & meshId) const;
+
+	// Returns nullptr if no file was found for meshId.  Throws std::runtime_error if the
+	// file cannot be decoded.
+	std::unique_ptr<LoadedMesh> load(const std::string & meshId) const;
+
+	std::vector<std::string> searchPaths;
+};
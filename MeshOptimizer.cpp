@@ -0,0 +1,294 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+using namespace glm;
+using namespace std;
+
+namespace {
+
+// Position and normal bits of one vertex.
+struct VertexKey {
+	uint32_t bits[6];
+
+	bool operator==(const VertexKey & other) const {
+		return memcmp(bits, other.bits, sizeof(bits)) == 0;
+	}
+};
+
+struct VertexKeyHash {
+	size_t operator()(const VertexKey & key) const {
+		// FNV-1a over the six words.
+		uint64_t hash = 14695981039346656037ull;
+		for (uint32_t word : key.bits) {
+			hash = (hash ^ word) * 1099511628211ull;
+		}
+		return size_t(hash);
+	}
+};
+
+// Forsyth's scoring constants, as published.
+const float CacheDecayPower = 1.5f;
+const float LastTriangleScore = 0.75f;
+const float ValenceBoostScale = 2.0f;
+const float ValenceBoostPower = 0.5f;
+
+float vertexScore(int cachePosition, uint32_t remainingTriangles) {
+	if (remainingTriangles == 0) {
+		// Nothing left to draw with this vertex.
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			// Used by the triangle just emitted.  A fixed score, so the next triangle
+			// does not just reuse the same edge and produce long thin strips.
+			score = LastTriangleScore;
+		} else {
+			const float scaler = 1.0f / (MeshOptimizer::OptimizeCacheSize - 3);
+			score = pow(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+		}
+	}
+
+	// Favour vertices with few triangles left, so they are finished off and stop
+	// occupying the cache.
+	score += ValenceBoostScale * pow(float(remainingTriangles), -ValenceBoostPower);
+	return score;
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+MeshOptimizationStats MeshOptimizer::optimize(
+		const float * positions,
+		const float * normals,
+		size_t numVertices,
+		IndexedMesh & mesh
+) {
+	MeshOptimizationStats stats;
+	stats.soupVertices = numVertices;
+
+	weldVertices(positions, normals, numVertices, mesh);
+	stats.weldedVertices = mesh.positions.size();
+	stats.acmrBefore = computeAcmr(mesh.indices.data(), mesh.indices.size(),
+			mesh.positions.size());
+
+	optimizeVertexCache(mesh.indices, mesh.positions.size());
+	optimizeVertexFetch(mesh);
+	stats.acmrAfter = computeAcmr(mesh.indices.data(), mesh.indices.size(),
+			mesh.positions.size());
+
+	return stats;
+}
+
+//---------------------------------------------------------------------------------------
+void MeshOptimizer::weldVertices(
+		const float * positions,
+		const float * normals,
+		size_t numVertices,
+		IndexedMesh & mesh
+) {
+	mesh.positions.clear();
+	mesh.normals.clear();
+	mesh.indices.clear();
+	mesh.indices.reserve(numVertices);
+
+	unordered_map<VertexKey, uint32_t, VertexKeyHash> uniqueVertices;
+	uniqueVertices.reserve(numVertices);
+
+	for (size_t i = 0; i < numVertices; ++i) {
+		VertexKey key;
+		memcpy(&key.bits[0], positions + 3 * i, 3 * sizeof(float));
+		memcpy(&key.bits[3], normals + 3 * i, 3 * sizeof(float));
+
+		auto inserted = uniqueVertices.insert(make_pair(key, uint32_t(mesh.positions.size())));
+		if (inserted.second) {
+			mesh.positions.push_back(vec3(positions[3 * i], positions[3 * i + 1],
+					positions[3 * i + 2]));
+			mesh.normals.push_back(vec3(normals[3 * i], normals[3 * i + 1],
+					normals[3 * i + 2]));
+		}
+		mesh.indices.push_back(inserted.first->second);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t> & indices, size_t numVertices) {
+	const size_t numTriangles = indices.size() / 3;
+	if (numTriangles == 0) {
+		return;
+	}
+
+	// Triangles using each vertex, as one array of per-vertex lists.  remaining[v] is
+	// the length of v's list; emitted triangles are swapped past the end.
+	vector<uint32_t> adjacencyOffsets(numVertices + 1, 0);
+	for (uint32_t index : indices) {
+		++adjacencyOffsets[index + 1];
+	}
+	for (size_t v = 0; v < numVertices; ++v) {
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	}
+	vector<uint32_t> adjacency(indices.size());
+	vector<uint32_t> remaining(numVertices, 0);
+	for (size_t i = 0; i < indices.size(); ++i) {
+		uint32_t v = indices[i];
+		adjacency[adjacencyOffsets[v] + remaining[v]++] = uint32_t(i / 3);
+	}
+
+	vector<float> vertexScores(numVertices);
+	for (size_t v = 0; v < numVertices; ++v) {
+		vertexScores[v] = vertexScore(-1, remaining[v]);
+	}
+
+	vector<float> triangleScores(numTriangles);
+	vector<bool> emitted(numTriangles, false);
+	long best = -1;
+	float bestScore = -1.0f;
+	for (size_t t = 0; t < numTriangles; ++t) {
+		triangleScores[t] = vertexScores[indices[3 * t]]
+				+ vertexScores[indices[3 * t + 1]]
+				+ vertexScores[indices[3 * t + 2]];
+		if (triangleScores[t] > bestScore) {
+			bestScore = triangleScores[t];
+			best = long(t);
+		}
+	}
+
+	vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	uint32_t cache[OptimizeCacheSize + 3];
+	unsigned int cacheCount = 0;
+	size_t deadEndCursor = 0;
+
+	while (result.size() < indices.size()) {
+		if (best < 0) {
+			// No triangle touches the cache.  Restart from the first one not yet emitted,
+			// which keeps this linear instead of rescanning every triangle.
+			while (emitted[deadEndCursor]) {
+				++deadEndCursor;
+			}
+			best = long(deadEndCursor);
+		}
+
+		const uint32_t * triangle = &indices[3 * best];
+		emitted[best] = true;
+		for (int k = 0; k < 3; ++k) {
+			uint32_t v = triangle[k];
+			result.push_back(v);
+
+			uint32_t * list = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t i = 0; i < remaining[v]; ++i) {
+				if (list[i] == uint32_t(best)) {
+					list[i] = list[remaining[v] - 1];
+					break;
+				}
+			}
+			--remaining[v];
+		}
+
+		// Most recently used first: the new triangle, then the previous contents.
+		uint32_t newCache[OptimizeCacheSize + 3];
+		unsigned int newCount = 0;
+		for (int k = 0; k < 3; ++k) {
+			uint32_t v = triangle[k];
+			if (find(newCache, newCache + newCount, v) == newCache + newCount) {
+				newCache[newCount++] = v;
+			}
+		}
+		for (unsigned int i = 0; i < cacheCount; ++i) {
+			uint32_t v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+				newCache[newCount++] = v;
+			}
+		}
+
+		// Rescore everything that moved, including vertices pushed out of the cache.
+		for (unsigned int i = 0; i < newCount; ++i) {
+			uint32_t v = newCache[i];
+			int position = (i < OptimizeCacheSize) ? int(i) : -1;
+
+			float score = vertexScore(position, remaining[v]);
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			const uint32_t * list = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t j = 0; j < remaining[v]; ++j) {
+				triangleScores[list[j]] += delta;
+			}
+		}
+
+		// The next triangle is the best one touching the cache.
+		best = -1;
+		bestScore = -1.0f;
+		cacheCount = (newCount < OptimizeCacheSize) ? newCount : OptimizeCacheSize;
+		for (unsigned int i = 0; i < cacheCount; ++i) {
+			uint32_t v = newCache[i];
+			cache[i] = v;
+
+			const uint32_t * list = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t j = 0; j < remaining[v]; ++j) {
+				if (triangleScores[list[j]] > bestScore) {
+					bestScore = triangleScores[list[j]];
+					best = long(list[j]);
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+//---------------------------------------------------------------------------------------
+void MeshOptimizer::optimizeVertexFetch(IndexedMesh & mesh) {
+	const uint32_t Unassigned = 0xffffffffu;
+	vector<uint32_t> remap(mesh.positions.size(), Unassigned);
+
+	vector<vec3> positions;
+	vector<vec3> normals;
+	positions.reserve(mesh.positions.size());
+	normals.reserve(mesh.normals.size());
+
+	for (uint32_t & index : mesh.indices) {
+		if (remap[index] == Unassigned) {
+			remap[index] = uint32_t(positions.size());
+			positions.push_back(mesh.positions[index]);
+			normals.push_back(mesh.normals[index]);
+		}
+		index = remap[index];
+	}
+
+	mesh.positions.swap(positions);
+	mesh.normals.swap(normals);
+}
+
+//---------------------------------------------------------------------------------------
+float MeshOptimizer::computeAcmr(
+		const uint32_t * indices,
+		size_t numIndices,
+		size_t numVertices,
+		unsigned int cacheSize
+) {
+	const size_t numTriangles = numIndices / 3;
+	if (numTriangles == 0) {
+		return 0.0f;
+	}
+
+	// A vertex is in the FIFO if fewer than cacheSize misses happened since it was
+	// last loaded.
+	vector<size_t> loadedAt(numVertices, 0);
+	size_t misses = 0;
+	size_t time = cacheSize + 1;
+	for (size_t i = 0; i < numIndices; ++i) {
+		uint32_t index = indices[i];
+		if (time - loadedAt[index] > cacheSize) {
+			loadedAt[index] = time++;
+			++misses;
+		}
+	}
+	return float(misses) / float(numTriangles);
+}
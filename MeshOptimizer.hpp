@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Indexed triangle list.  Every three indices form one triangle.
+struct IndexedMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<uint32_t> indices;
+};
+
+// Vertex counts and average cache miss ratios (post-transform cache misses per
+// triangle) before and after MeshOptimizer::optimize().  "Before" is the welded mesh
+// in its original triangle order; unindexed triangle soup always has an ACMR of 3.
+struct MeshOptimizationStats {
+	size_t soupVertices;
+	size_t weldedVertices;
+	float acmrBefore;
+	float acmrAfter;
+};
+
+// Preprocessing that turns decoded .obj triangle soup into an indexed mesh that is
+// cheap for the GPU to transform and fetch.
+class MeshOptimizer {
+public:
+	// Cache size assumed by the triangle ordering.  Larger than most real caches, which
+	// is fine: the ordering degrades gracefully on smaller ones.
+	static const unsigned int OptimizeCacheSize = 32;
+
+	// FIFO size used to report ACMR, close to what current hardware behaves like.
+	static const unsigned int AcmrCacheSize = 16;
+
+	// Weld, reorder triangles for the post-transform cache, then reorder vertices for
+	// fetch locality.  positions and normals hold 3 * numVertices floats each.
+	static MeshOptimizationStats optimize(const float * positions, const float * normals,
+			size_t numVertices, IndexedMesh & mesh);
+
+	// Merge vertices whose position and normal are bitwise identical.
+	static void weldVertices(const float * positions, const float * normals,
+			size_t numVertices, IndexedMesh & mesh);
+
+	// Tom Forsyth's linear-speed vertex cache optimisation: greedily emit the triangle
+	// whose vertices score highest given an LRU cache model.
+	static void optimizeVertexCache(std::vector<uint32_t> & indices, size_t numVertices);
+
+	// Renumber vertices in order of first use, so vertex fetch walks memory forwards.
+	static void optimizeVertexFetch(IndexedMesh & mesh);
+
+	// Average cache misses per triangle of indices through a FIFO of cacheSize entries.
+	static float computeAcmr(const uint32_t * indices, size_t numIndices, size_t numVertices,
+			unsigned int cacheSize = AcmrCacheSize);
+};
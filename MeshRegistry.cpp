@@ -0,0 +1,89 @@
+#include "MeshRegistry.hpp"
+
+#include "GeometryNode.hpp"
+
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+//---------------------------------------------------------------------------------------
+void MeshRegistry::addMeshes(const BatchInfoMap & batchInfoMap) {
+	for (const auto & entry : batchInfoMap) {
+		addMesh(entry.first, entry.second);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+int MeshRegistry::addMesh(const std::string & meshId, const BatchInfo & batchInfo) {
+	auto it = m_handles.find(meshId);
+	if (it != m_handles.end()) {
+		batches[it->second] = batchInfo;
+		return it->second;
+	}
+
+	int handle = int(batches.size());
+	batches.push_back(batchInfo);
+	meshIds.push_back(meshId);
+	positionTransforms.push_back(glm::mat4());
+	bounds.push_back(BoundingSphere());
+	lods.push_back(std::vector<LodBatch>());
+	m_handles[meshId] = handle;
+	return handle;
+}
+
+//---------------------------------------------------------------------------------------
+void MeshRegistry::setPositionTransform(int handle, const glm::mat4 & transform) {
+	positionTransforms[handle] = transform;
+}
+
+//---------------------------------------------------------------------------------------
+void MeshRegistry::setBounds(int handle, const BoundingSphere & sphere) {
+	bounds[handle] = sphere;
+}
+
+//---------------------------------------------------------------------------------------
+void MeshRegistry::setLods(int handle, const std::vector<LodBatch> & levels) {
+	lods[handle] = levels;
+}
+
+//---------------------------------------------------------------------------------------
+int MeshRegistry::findHandle(const std::string & meshId) const {
+	auto it = m_handles.find(meshId);
+	return (it == m_handles.end()) ? InvalidHandle : it->second;
+}
+
+//---------------------------------------------------------------------------------------
+void MeshRegistry::resolve(SceneNode * root) const {
+	if (root == nullptr) {
+		return;
+	}
+
+	set<string> unknownMeshIds;
+
+	vector<SceneNode *> stack(1, root);
+	while (!stack.empty()) {
+		SceneNode * node = stack.back();
+		stack.pop_back();
+
+		if (node->m_nodeType == NodeType::GeometryNode) {
+			GeometryNode * geometryNode = static_cast<GeometryNode *>(node);
+			geometryNode->meshHandle = findHandle(geometryNode->meshId);
+			if (geometryNode->meshHandle == InvalidHandle) {
+				unknownMeshIds.insert(geometryNode->meshId);
+			}
+		}
+		for (SceneNode * child : node->children) {
+			stack.push_back(child);
+		}
+	}
+
+	if (!unknownMeshIds.empty()) {
+		string message = "Scene references unknown meshId(s):";
+		for (const string & meshId : unknownMeshIds) {
+			message += " '" + meshId + "'";
+		}
+		throw runtime_error(message);
+	}
+}
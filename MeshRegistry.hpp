@@ -0,0 +1,71 @@
+#pragma once
+
+#include "cs488-framework/MeshConsolidator.hpp"
+
+#include "MeshCache.hpp"
+
+#include "SceneNode.hpp"
+#include "BoundingVolumes.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Dense table of the meshes uploaded to the GPU.  A mesh handle is an index into
+// batches, resolved once per GeometryNode so the render loop never hashes a meshId.
+// The registry does not reference any scene, so several scenes can share one.
+class MeshRegistry {
+public:
+	static const int InvalidHandle = -1;
+
+	// Register every mesh of a MeshConsolidator batch table.
+	void addMeshes(const BatchInfoMap & batchInfoMap);
+
+	// Returns the handle of meshId, registering it if it is new.  The position transform
+	// starts out as the identity and the bounds empty.
+	int addMesh(const std::string & meshId, const BatchInfo & batchInfo);
+
+	// Transform from stored vertex positions to model space, e.g. the dequantization of
+	// a compact vertex format.  Applied on top of each GeometryNode's model matrix.
+	void setPositionTransform(int handle, const glm::mat4 & transform);
+
+	// Model-space sphere around the mesh's vertices, used for frustum culling.
+	void setBounds(int handle, const BoundingSphere & bounds);
+
+	// Simplified levels of the mesh, finest first, not counting the full mesh.
+	void setLods(int handle, const std::vector<LodBatch> & levels);
+
+	// Returns InvalidHandle if meshId has not been registered.
+	int findHandle(const std::string & meshId) const;
+
+	// Set GeometryNode::meshHandle for every GeometryNode under root.  Throws
+	// std::runtime_error naming every meshId that is not registered.
+	void resolve(SceneNode * root) const;
+
+	const BatchInfo & batchInfo(int handle) const { return batches[handle]; }
+	const std::string & meshId(int handle) const { return meshIds[handle]; }
+	const glm::mat4 & positionTransform(int handle) const { return positionTransforms[handle]; }
+	const BoundingSphere & meshBounds(int handle) const { return bounds[handle]; }
+
+	// Level 0 is the full mesh.
+	unsigned int numLodLevels(int handle) const { return unsigned(lods[handle].size()) + 1; }
+	const BatchInfo & lodBatchInfo(int handle, unsigned int level) const {
+		return (level == 0) ? batches[handle] : lods[handle][level - 1].batchInfo;
+	}
+	float lodError(int handle, unsigned int level) const {
+		return (level == 0) ? 0.0f : lods[handle][level - 1].error;
+	}
+	size_t size() const { return batches.size(); }
+
+	// Parallel arrays, indexed by mesh handle.
+	std::vector<BatchInfo> batches;
+	std::vector<std::string> meshIds;
+	std::vector<glm::mat4> positionTransforms;
+	std::vector<BoundingSphere> bounds;
+	std::vector<std::vector<LodBatch>> lods;
+
+private:
+	std::unordered_map<std::string, int> m_handles;
+};
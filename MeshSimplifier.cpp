@@ -0,0 +1,376 @@
+#include "MeshSimplifier.hpp"
+
+#include "MeshOptimizer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+using namespace glm;
+using namespace std;
+
+namespace {
+
+// Symmetric 4x4 quadric, upper triangle, plus the area it was accumulated over so
+// errors can be reported as mean squared distances.
+struct Quadric {
+	double a[10];
+	double area;
+
+	Quadric() : area(0.0) {
+		fill(a, a + 10, 0.0);
+	}
+
+	// Plane n.p + d = 0 with unit n, weighted by w.
+	void addPlane(const dvec3 & n, double d, double w) {
+		a[0] += w * n.x * n.x;  a[1] += w * n.x * n.y;  a[2] += w * n.x * n.z;  a[3] += w * n.x * d;
+		a[4] += w * n.y * n.y;  a[5] += w * n.y * n.z;  a[6] += w * n.y * d;
+		a[7] += w * n.z * n.z;  a[8] += w * n.z * d;
+		a[9] += w * d * d;
+		area += w;
+	}
+
+	void add(const Quadric & other) {
+		for (int i = 0; i < 10; ++i) {
+			a[i] += other.a[i];
+		}
+		area += other.area;
+	}
+
+	// Weighted sum of squared distances from p to the planes.
+	double evaluate(const dvec3 & p) const {
+		return a[0] * p.x * p.x + 2.0 * a[1] * p.x * p.y + 2.0 * a[2] * p.x * p.z + 2.0 * a[3] * p.x
+			 + a[4] * p.y * p.y + 2.0 * a[5] * p.y * p.z + 2.0 * a[6] * p.y
+			 + a[7] * p.z * p.z + 2.0 * a[8] * p.z
+			 + a[9];
+	}
+};
+
+// Collapse of vertex 'from' onto vertex 'to'.  Only valid while both vertices still
+// have the versions they had when it was queued.
+struct Collapse {
+	double cost;
+	uint32_t from, to;
+	uint32_t fromVersion, toVersion;
+
+	bool operator<(const Collapse & other) const {
+		// Cheapest first out of std::priority_queue.
+		return cost > other.cost;
+	}
+};
+
+struct VertexKey {
+	float position[3];
+
+	bool operator==(const VertexKey & other) const {
+		return memcmp(position, other.position, sizeof(position)) == 0;
+	}
+};
+
+struct VertexKeyHash {
+	size_t operator()(const VertexKey & key) const {
+		uint32_t bits[3];
+		memcpy(bits, key.position, sizeof(bits));
+		uint64_t hash = 14695981039346656037ull;
+		for (uint32_t word : bits) {
+			hash = (hash ^ word) * 1099511628211ull;
+		}
+		return size_t(hash);
+	}
+};
+
+inline uint64_t edgeKey(uint32_t a, uint32_t b) {
+	return (a < b) ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+}
+
+class Simplifier {
+public:
+	Simplifier(const float * positions, size_t numVertices, const uint32_t * indices,
+			size_t numIndices);
+
+	// Collapse until at most targetTriangles remain or nothing more can collapse.
+	void collapseTo(size_t targetTriangles);
+
+	size_t liveTriangles() const { return m_liveTriangles; }
+	float error() const { return float(std::sqrt(m_maxError)); }
+	void liveIndices(vector<uint32_t> & indices) const;
+
+private:
+	void lockBordersAndSeams();
+	void queueEdges(uint32_t vertex);
+	void queueCollapse(uint32_t from, uint32_t to);
+	double collapseCost(uint32_t from, uint32_t to) const;
+	bool flipsTriangle(uint32_t from, uint32_t to) const;
+	void collapse(uint32_t from, uint32_t to);
+
+	vector<dvec3> m_positions;
+	vector<uint32_t> m_triangles;               // 3 indices per triangle, updated in place
+	vector<char> m_triangleAlive;
+	vector<vector<uint32_t>> m_vertexTriangles;  // May list dead triangles
+	vector<Quadric> m_quadrics;
+	vector<uint32_t> m_versions;
+	vector<char> m_locked;
+	vector<char> m_removed;
+	priority_queue<Collapse> m_queue;
+	size_t m_liveTriangles;
+	double m_maxError;                           // Mean squared distance
+};
+
+//---------------------------------------------------------------------------------------
+Simplifier::Simplifier(
+		const float * positions,
+		size_t numVertices,
+		const uint32_t * indices,
+		size_t numIndices
+)
+	: m_positions(numVertices),
+	  m_triangles(indices, indices + numIndices),
+	  m_triangleAlive(numIndices / 3, 1),
+	  m_vertexTriangles(numVertices),
+	  m_quadrics(numVertices),
+	  m_versions(numVertices, 0),
+	  m_locked(numVertices, 0),
+	  m_removed(numVertices, 0),
+	  m_liveTriangles(numIndices / 3),
+	  m_maxError(0.0)
+{
+	for (size_t v = 0; v < numVertices; ++v) {
+		m_positions[v] = dvec3(positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]);
+	}
+
+	// Every vertex starts with the planes of the triangles around it, weighted by
+	// area so that slivers do not dominate.
+	for (size_t t = 0; t < m_liveTriangles; ++t) {
+		const uint32_t * triangle = &m_triangles[3 * t];
+		dvec3 p0 = m_positions[triangle[0]];
+		dvec3 n = cross(m_positions[triangle[1]] - p0, m_positions[triangle[2]] - p0);
+		double doubleArea = length(n);
+		if (doubleArea > 0.0) {
+			n /= doubleArea;
+			for (int k = 0; k < 3; ++k) {
+				m_quadrics[triangle[k]].addPlane(n, -dot(n, p0), 0.5 * doubleArea);
+			}
+		}
+		for (int k = 0; k < 3; ++k) {
+			m_vertexTriangles[triangle[k]].push_back(uint32_t(t));
+		}
+	}
+
+	lockBordersAndSeams();
+
+	for (uint32_t v = 0; v < numVertices; ++v) {
+		queueEdges(v);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void Simplifier::lockBordersAndSeams() {
+	unordered_map<uint64_t, unsigned int> edgeUse;
+	for (size_t t = 0; t < m_triangleAlive.size(); ++t) {
+		const uint32_t * triangle = &m_triangles[3 * t];
+		for (int k = 0; k < 3; ++k) {
+			++edgeUse[edgeKey(triangle[k], triangle[(k + 1) % 3])];
+		}
+	}
+	for (const auto & entry : edgeUse) {
+		if (entry.second != 2) {
+			m_locked[uint32_t(entry.first >> 32)] = 1;
+			m_locked[uint32_t(entry.first)] = 1;
+		}
+	}
+
+	unordered_map<VertexKey, uint32_t, VertexKeyHash> firstAtPosition;
+	for (uint32_t v = 0; v < m_positions.size(); ++v) {
+		VertexKey key = { { float(m_positions[v].x), float(m_positions[v].y),
+				float(m_positions[v].z) } };
+		auto inserted = firstAtPosition.insert(make_pair(key, v));
+		if (!inserted.second) {
+			m_locked[v] = 1;
+			m_locked[inserted.first->second] = 1;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void Simplifier::queueEdges(uint32_t vertex) {
+	for (uint32_t t : m_vertexTriangles[vertex]) {
+		if (!m_triangleAlive[t]) {
+			continue;
+		}
+		for (int k = 0; k < 3; ++k) {
+			uint32_t other = m_triangles[3 * t + k];
+			if (other != vertex) {
+				queueCollapse(vertex, other);
+				queueCollapse(other, vertex);
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void Simplifier::queueCollapse(uint32_t from, uint32_t to) {
+	if (m_locked[from]) {
+		return;
+	}
+	Collapse collapse;
+	collapse.cost = collapseCost(from, to);
+	collapse.from = from;
+	collapse.to = to;
+	collapse.fromVersion = m_versions[from];
+	collapse.toVersion = m_versions[to];
+	m_queue.push(collapse);
+}
+
+//---------------------------------------------------------------------------------------
+double Simplifier::collapseCost(uint32_t from, uint32_t to) const {
+	Quadric q = m_quadrics[from];
+	q.add(m_quadrics[to]);
+	if (q.area <= 0.0) {
+		return 0.0;
+	}
+	return std::max(q.evaluate(m_positions[to]), 0.0) / q.area;
+}
+
+//---------------------------------------------------------------------------------------
+// True if moving 'from' onto 'to' would turn any surviving triangle around it over or
+// make it degenerate.
+bool Simplifier::flipsTriangle(uint32_t from, uint32_t to) const {
+	for (uint32_t t : m_vertexTriangles[from]) {
+		if (!m_triangleAlive[t]) {
+			continue;
+		}
+		const uint32_t * triangle = &m_triangles[3 * t];
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+			// Collapses away.
+			continue;
+		}
+
+		dvec3 p[3], q[3];
+		for (int k = 0; k < 3; ++k) {
+			p[k] = m_positions[triangle[k]];
+			q[k] = (triangle[k] == from) ? m_positions[to] : p[k];
+		}
+		dvec3 before = cross(p[1] - p[0], p[2] - p[0]);
+		dvec3 after = cross(q[1] - q[0], q[2] - q[0]);
+		double afterLength = length(after);
+		if (afterLength <= 1e-12 * (length(before) + 1e-30)) {
+			return true;
+		}
+		// Reject anything turned by more than about 75 degrees.
+		if (dot(before, after) < 0.25 * length(before) * afterLength) {
+			return true;
+		}
+	}
+	return false;
+}
+
+//---------------------------------------------------------------------------------------
+void Simplifier::collapse(uint32_t from, uint32_t to) {
+	m_quadrics[to].add(m_quadrics[from]);
+	m_removed[from] = 1;
+	++m_versions[from];
+	++m_versions[to];
+
+	for (uint32_t t : m_vertexTriangles[from]) {
+		if (!m_triangleAlive[t]) {
+			continue;
+		}
+		uint32_t * triangle = &m_triangles[3 * t];
+		bool hasTo = triangle[0] == to || triangle[1] == to || triangle[2] == to;
+		if (hasTo) {
+			m_triangleAlive[t] = 0;
+			--m_liveTriangles;
+			continue;
+		}
+		for (int k = 0; k < 3; ++k) {
+			if (triangle[k] == from) {
+				triangle[k] = to;
+			}
+		}
+		m_vertexTriangles[to].push_back(t);
+	}
+	m_vertexTriangles[from].clear();
+
+	// Drop dead triangles from the survivor's list so it does not keep growing.
+	vector<uint32_t> & list = m_vertexTriangles[to];
+	list.erase(remove_if(list.begin(), list.end(), [this](uint32_t t) {
+		return !m_triangleAlive[t];
+	}), list.end());
+
+	// Every collapse touching 'to' is now stale; requeue them with the merged quadric.
+	queueEdges(to);
+}
+
+//---------------------------------------------------------------------------------------
+void Simplifier::collapseTo(size_t targetTriangles) {
+	while (m_liveTriangles > targetTriangles && !m_queue.empty()) {
+		Collapse next = m_queue.top();
+		m_queue.pop();
+		if (m_removed[next.from] || m_removed[next.to]
+				|| next.fromVersion != m_versions[next.from]
+				|| next.toVersion != m_versions[next.to]) {
+			continue;
+		}
+		if (flipsTriangle(next.from, next.to)) {
+			// Requeued when a neighbour collapses and the geometry around it changes.
+			continue;
+		}
+		collapse(next.from, next.to);
+		m_maxError = std::max(m_maxError, next.cost);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void Simplifier::liveIndices(vector<uint32_t> & indices) const {
+	indices.clear();
+	indices.reserve(3 * m_liveTriangles);
+	for (size_t t = 0; t < m_triangleAlive.size(); ++t) {
+		if (m_triangleAlive[t]) {
+			indices.insert(indices.end(), &m_triangles[3 * t], &m_triangles[3 * t] + 3);
+		}
+	}
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+std::vector<SimplifiedLevel> MeshSimplifier::buildLevels(
+		const float * positions,
+		size_t numVertices,
+		const uint32_t * indices,
+		size_t numIndices
+) {
+	vector<SimplifiedLevel> levels;
+	size_t previousTriangles = numIndices / 3;
+	if (previousTriangles < 2 * MinTriangles) {
+		return levels;
+	}
+
+	Simplifier simplifier(positions, numVertices, indices, numIndices);
+	while (levels.size() + 1 < MaxLevels) {
+		size_t target = size_t(previousTriangles * LevelRatio);
+		if (target < MinTriangles) {
+			break;
+		}
+		simplifier.collapseTo(target);
+
+		// A level that barely shrank is not worth the index memory, and the next one
+		// would not shrink either.
+		size_t triangles = simplifier.liveTriangles();
+		if (triangles > previousTriangles * (1.0f + LevelRatio) / 2.0f) {
+			break;
+		}
+
+		SimplifiedLevel level;
+		simplifier.liveIndices(level.indices);
+		level.error = simplifier.error();
+		MeshOptimizer::optimizeVertexCache(level.indices, numVertices);
+		levels.push_back(move(level));
+		previousTriangles = triangles;
+	}
+	return levels;
+}
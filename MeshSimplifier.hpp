@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One simplified version of an indexed mesh.  Indices refer to the vertices of the
+// original mesh, so every level shares one vertex buffer.
+struct SimplifiedLevel {
+	std::vector<uint32_t> indices;
+	float error;   // Largest RMS distance to the original surface, in model units
+};
+
+// Quadric error metric simplification (Garland and Heckbert) by edge collapse onto an
+// existing endpoint, so no vertices are created.  Vertices on open borders and on
+// attribute seams (several vertices at one position) are locked, which keeps
+// silhouettes of open meshes and normal discontinuities intact.
+class MeshSimplifier {
+public:
+	// Levels of detail per mesh, including the original.
+	static const unsigned int MaxLevels = 4;
+
+	// Each level aims for half the triangles of the one before.
+	static constexpr float LevelRatio = 0.5f;
+
+	// Meshes this small are not worth simplifying further.
+	static const size_t MinTriangles = 32;
+
+	// Up to MaxLevels - 1 successively coarser levels of the mesh, produced by one run of
+	// collapses.  Stops early once the mesh gets too small or collapses stop making
+	// progress.  positions holds 3 * numVertices floats.  Each level's triangles are
+	// reordered for the vertex cache.
+	static std::vector<SimplifiedLevel> buildLevels(const float * positions,
+			size_t numVertices, const uint32_t * indices, size_t numIndices);
+};
@@ -0,0 +1,125 @@
+#include "ObjDecoderBenchmark.hpp"
+
+#include "cs488-framework/ObjFileDecoder.hpp"
+
+#include "BenchmarkTiming.hpp"
+#include "MeshCacheBenchmark.hpp"
+#include "ObjFastDecoder.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace glm;
+using namespace std;
+
+namespace {
+
+typedef void (*DecodeFunction)(const char *, string &, vector<vec3> &, vector<vec3> &);
+
+void decodeWithObjFileDecoder(const char * path, string & objectName,
+		vector<vec3> & positions, vector<vec3> & normals) {
+	ObjFileDecoder::decode(path, objectName, positions, normals);
+}
+
+void decodeWithObjFastDecoder(const char * path, string & objectName,
+		vector<vec3> & positions, vector<vec3> & normals) {
+	ObjFastDecoder::decode(path, objectName, positions, normals);
+}
+
+// Best wall time of repetitions decodes, in seconds.  The last decode is left in the
+// output arguments.
+double timeDecode(DecodeFunction decode, const string & path, unsigned int repetitions,
+		string & objectName, vector<vec3> & positions, vector<vec3> & normals) {
+	return bestTime([&]() {
+		objectName.clear();
+		decode(path.c_str(), objectName, positions, normals);
+	}, repetitions);
+}
+
+bool sameVertexData(const vector<vec3> & a, const vector<vec3> & b) {
+	return a.size() == b.size()
+		&& (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(vec3)) == 0);
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+int runObjDecoderBenchmark(const std::vector<std::string> & objFiles,
+		unsigned int repetitions) {
+	if (repetitions == 0) {
+		repetitions = 1;
+	}
+
+	vector<string> files = objFiles;
+	string generatedFile;
+	if (files.empty()) {
+		generatedFile = writeDenseSphere(512, 1024);
+		if (generatedFile.empty()) {
+			cerr << "Could not write a generated .obj file" << endl;
+			return 1;
+		}
+		files.push_back(generatedFile);
+	}
+
+	cout << "Decoding each file " << repetitions << " time(s), best time reported" << endl;
+	cout << left << setw(40) << "file" << right
+		 << setw(10) << "MB"
+		 << setw(16) << "ObjFileDecoder"
+		 << setw(16) << "ObjFastDecoder"
+		 << setw(10) << "speedup"
+		 << "  identical" << endl;
+
+	bool allIdentical = true;
+	for (const string & path : files) {
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0) {
+			cerr << "Cannot read " << path << endl;
+			allIdentical = false;
+			continue;
+		}
+		double megabytes = double(info.st_size) / (1024.0 * 1024.0);
+
+		string streamName, fastName;
+		vector<vec3> streamPositions, streamNormals, fastPositions, fastNormals;
+		double streamSeconds, fastSeconds;
+		try {
+			streamSeconds = timeDecode(decodeWithObjFileDecoder, path, repetitions,
+					streamName, streamPositions, streamNormals);
+			fastSeconds = timeDecode(decodeWithObjFastDecoder, path, repetitions,
+					fastName, fastPositions, fastNormals);
+		} catch (const std::exception & error) {
+			cerr << "Failed to decode " << path << ": " << error.what() << endl;
+			allIdentical = false;
+			continue;
+		} catch (...) {
+			cerr << "Failed to decode " << path << endl;
+			allIdentical = false;
+			continue;
+		}
+
+		bool identical = streamName == fastName
+				&& sameVertexData(streamPositions, fastPositions)
+				&& sameVertexData(streamNormals, fastNormals);
+		allIdentical = allIdentical && identical;
+
+		cout << left << setw(40) << (path == generatedFile ? "(generated dense sphere)" : path)
+			 << right << fixed << setprecision(2)
+			 << setw(10) << megabytes
+			 << setw(11) << megabytes / streamSeconds << " MB/s"
+			 << setw(11) << megabytes / fastSeconds << " MB/s"
+			 << setw(9) << streamSeconds / fastSeconds << "x"
+			 << "  " << (identical ? "yes" : "NO") << endl;
+	}
+
+	if (!generatedFile.empty()) {
+		unlink(generatedFile.c_str());
+	}
+	return allIdentical ? 0 : 1;
+}
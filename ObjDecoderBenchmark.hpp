@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Decode each .obj file with both ObjFileDecoder and ObjFastDecoder, report their
+// throughput in MB/s (best of repetitions) and check that both produce bit-identical
+// positions, normals and object names.  With no files, a dense generated sphere is
+// used instead.  Returns 0 if every file matched, 1 otherwise.
+int runObjDecoderBenchmark(const std::vector<std::string> & objFiles,
+		unsigned int repetitions);
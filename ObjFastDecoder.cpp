@@ -0,0 +1,337 @@
+#include "ObjFastDecoder.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace glm;
+using namespace std;
+
+namespace {
+
+// Exactly representable powers of ten, for the fast float path.
+const double PowersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+inline bool isSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Returns a pointer to the next '\n' at or after p, or end.
+inline const char * findLineEnd(const char * p, const char * end) {
+#if defined(__SSE2__)
+	const __m128i newlines = _mm_set1_epi8('\n');
+	while (end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newlines));
+		if (mask != 0) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 16;
+	}
+#endif
+	const void * newline = memchr(p, '\n', size_t(end - p));
+	return newline ? static_cast<const char *>(newline) : end;
+}
+
+inline const char * skipSpaces(const char * p, const char * end) {
+	while (p != end && isSpace(*p)) {
+		++p;
+	}
+	return p;
+}
+
+// strtof() on a token that is not null terminated.
+bool parseFloatSlow(const char *& p, const char * end, float & value) {
+	char buffer[128];
+	size_t length = 0;
+	while (p + length != end && !isSpace(p[length]) && length < sizeof(buffer) - 1) {
+		buffer[length] = p[length];
+		++length;
+	}
+	buffer[length] = '\0';
+
+	char * parsedEnd;
+	value = strtof(buffer, &parsedEnd);
+	if (parsedEnd == buffer) {
+		return false;
+	}
+	p += parsedEnd - buffer;
+	return true;
+}
+
+// Parses a decimal float at p and advances p past it.  Plain decimals of up to 15
+// significant digits and no exponent, which is what exporters write, are converted
+// with one exact double divide (Clinger's fast path) and are then correctly rounded.
+// Everything else goes through strtof().
+bool parseFloat(const char *& p, const char * end, float & value) {
+	const char * start = p;
+	const char * q = p;
+
+	bool negative = false;
+	if (q != end && (*q == '-' || *q == '+')) {
+		negative = (*q == '-');
+		++q;
+	}
+
+	uint64_t mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+	bool anyDigits = false;
+
+	while (q != end && isDigit(*q)) {
+		mantissa = mantissa * 10 + uint64_t(*q - '0');
+		significantDigits += (mantissa != 0);
+		anyDigits = true;
+		++q;
+		if (significantDigits > 15) {
+			return parseFloatSlow(p, end, value);
+		}
+	}
+	if (q != end && *q == '.') {
+		++q;
+		while (q != end && isDigit(*q)) {
+			mantissa = mantissa * 10 + uint64_t(*q - '0');
+			significantDigits += (mantissa != 0);
+			--exponent;
+			anyDigits = true;
+			++q;
+			if (significantDigits > 15) {
+				return parseFloatSlow(p, end, value);
+			}
+		}
+	}
+	if (!anyDigits || (q != end && (*q == 'e' || *q == 'E'
+			|| *q == 'x' || *q == 'X' || *q == 'p' || *q == 'P'))) {
+		// Exponents, hex floats, inf and nan are rare enough to leave to strtof().
+		p = start;
+		return parseFloatSlow(p, end, value);
+	}
+	if (exponent < -22) {
+		return parseFloatSlow(p, end, value);
+	}
+
+	// mantissa < 10^15 < 2^53 and 10^-exponent are both exact doubles, so the quotient
+	// is the correctly rounded double of the decimal.
+	double d = double(mantissa) / PowersOfTen[-exponent];
+
+	// Rounding that double to float again can only differ from rounding the decimal
+	// directly when the double landed exactly halfway between two floats.  Also leave
+	// anything outside the normal float range to strtof().
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(bits));
+	if ((bits & 0x1fffffffull) == 0x10000000ull
+			|| (d != 0.0 && (d < 1.1754943508222875e-38 || d > 3.4028234663852886e38))) {
+		return parseFloatSlow(p, end, value);
+	}
+
+	value = float(negative ? -d : d);
+	p = q;
+	return true;
+}
+
+// Parses an unsigned decimal index at p and advances p past it.
+bool parseIndex(const char *& p, const char * end, unsigned int & value) {
+	if (p == end || !isDigit(*p)) {
+		return false;
+	}
+	uint64_t result = 0;
+	while (p != end && isDigit(*p)) {
+		result = result * 10 + uint64_t(*p - '0');
+		if (result > 0xffffffffull) {
+			return false;
+		}
+		++p;
+	}
+	value = unsigned(result);
+	return true;
+}
+
+bool parseVec3(const char * p, const char * end, vec3 & v) {
+	for (int i = 0; i < 3; ++i) {
+		p = skipSpaces(p, end);
+		if (!parseFloat(p, end, v[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// One face corner: "v", "v/vt", "v//vn" or "v/vt/vn".  Indices are 1-based, 0 means
+// absent.
+bool parseCorner(const char *& p, const char * end, unsigned int & position,
+		unsigned int & normal) {
+	normal = 0;
+	if (!parseIndex(p, end, position)) {
+		return false;
+	}
+	if (p == end || *p != '/') {
+		return true;
+	}
+	++p;
+	unsigned int uv;
+	if (p != end && *p != '/') {
+		if (!parseIndex(p, end, uv)) {
+			return false;
+		}
+	}
+	if (p == end || *p != '/') {
+		return true;
+	}
+	++p;
+	return parseIndex(p, end, normal);
+}
+
+void throwError(const char * objFilePath, const char * message) {
+	string error = string(message) + " " + objFilePath;
+	throw runtime_error(error);
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+void ObjFastDecoder::decode(
+		const char * objFilePath,
+		std::string & objectName,
+		std::vector<glm::vec3> & positions,
+		std::vector<glm::vec3> & normals
+) {
+	int fd = open(objFilePath, O_RDONLY);
+	if (fd < 0) {
+		throwError(objFilePath, "Unable to open .obj file");
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throwError(objFilePath, "Unable to stat .obj file");
+	}
+
+	size_t size = size_t(info.st_size);
+	if (size == 0) {
+		close(fd);
+		decode("", 0, objectName, positions, normals);
+		return;
+	}
+
+	void * mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		throwError(objFilePath, "Unable to map .obj file");
+	}
+	madvise(mapping, size, MADV_SEQUENTIAL);
+
+	try {
+		decode(static_cast<const char *>(mapping), size, objectName, positions, normals);
+	} catch (const runtime_error & error) {
+		munmap(mapping, size);
+		throw runtime_error(string(error.what()) + " in " + objFilePath);
+	}
+	munmap(mapping, size);
+}
+
+//---------------------------------------------------------------------------------------
+void ObjFastDecoder::decode(
+		const char * data,
+		size_t size,
+		std::string & objectName,
+		std::vector<glm::vec3> & positions,
+		std::vector<glm::vec3> & normals
+) {
+	positions.clear();
+	normals.clear();
+
+	vector<vec3> filePositions;
+	vector<vec3> fileNormals;
+	vector<unsigned int> positionIndices;
+	vector<unsigned int> normalIndices;
+
+	// Rough guess from typical line lengths, saves most of the regrowth on big files.
+	filePositions.reserve(size / 96);
+	fileNormals.reserve(size / 96);
+	positionIndices.reserve(size / 32);
+	normalIndices.reserve(size / 32);
+
+	const char * p = data;
+	const char * end = data + size;
+	while (p < end) {
+		const char * lineEnd = findLineEnd(p, end);
+		const char * q = p;
+		p = lineEnd + 1;
+
+		if (lineEnd - q < 2) {
+			continue;
+		}
+
+		if (q[0] == 'v' && q[1] == ' ') {
+			vec3 v;
+			if (!parseVec3(q + 2, lineEnd, v)) {
+				throw runtime_error("Malformed vertex position");
+			}
+			filePositions.push_back(v);
+		} else if (q[0] == 'v' && q[1] == 'n' && lineEnd - q > 2 && q[2] == ' ') {
+			vec3 n;
+			if (!parseVec3(q + 3, lineEnd, n)) {
+				throw runtime_error("Malformed vertex normal");
+			}
+			fileNormals.push_back(n);
+		} else if (q[0] == 'f' && q[1] == ' ') {
+			q += 2;
+			for (int i = 0; i < 3; ++i) {
+				unsigned int position, normal;
+				q = skipSpaces(q, lineEnd);
+				if (!parseCorner(q, lineEnd, position, normal)) {
+					throw runtime_error("Malformed face");
+				}
+				positionIndices.push_back(position);
+				normalIndices.push_back(normal);
+			}
+		} else if (q[0] == 'o' && q[1] == ' ') {
+			q = skipSpaces(q + 2, lineEnd);
+			const char * nameEnd = q;
+			while (nameEnd != lineEnd && !isSpace(*nameEnd)) {
+				++nameEnd;
+			}
+			objectName.assign(q, nameEnd);
+		}
+	}
+
+	positions.resize(positionIndices.size());
+	normals.resize(positionIndices.size());
+	for (size_t i = 0; i < positionIndices.size(); ++i) {
+		unsigned int index = positionIndices[i];
+		if (index == 0 || index > filePositions.size()) {
+			throw runtime_error("Vertex position index out of range");
+		}
+		positions[i] = filePositions[index - 1];
+	}
+	for (size_t i = 0; i < normalIndices.size(); i += 3) {
+		for (size_t j = i; j < i + 3; ++j) {
+			unsigned int index = normalIndices[j];
+			if (index == 0) {
+				vec3 faceNormal = cross(positions[i + 1] - positions[i],
+						positions[i + 2] - positions[i]);
+				normals[j] = normalize(faceNormal);
+			} else if (index > fileNormals.size()) {
+				throw runtime_error("Vertex normal index out of range");
+			} else {
+				normals[j] = fileNormals[index - 1];
+			}
+		}
+	}
+}
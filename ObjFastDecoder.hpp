@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// Drop-in replacement for ObjFileDecoder::decode() built for large files.  The whole
+// file is memory-mapped, line ends are found 16 bytes at a time with SSE2 where
+// available, and numbers are parsed in place without iostreams.
+//
+// Output matches ObjFileDecoder exactly: one position and one normal per face corner,
+// in face order, and every float rounds exactly as strtof() would.  Like
+// ObjFileDecoder, only the first three corners of a face are used.  Faces without
+// normal indices get their flat face normal.
+class ObjFastDecoder {
+public:
+	// Throws std::runtime_error if the file cannot be read or has an index out of range.
+	static void decode(
+			const char * objFilePath,
+			std::string & objectName,
+			std::vector<glm::vec3> & positions,
+			std::vector<glm::vec3> & normals
+	);
+
+	// Same, on a buffer already in memory.  The buffer need not be null terminated.
+	static void decode(
+			const char * data,
+			size_t size,
+			std::string & objectName,
+			std::vector<glm::vec3> & positions,
+			std::vector<glm::vec3> & normals
+	);
+};
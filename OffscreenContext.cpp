@@ -0,0 +1,184 @@
+#include "OffscreenContext.hpp"
+
+#include "cs488-framework/GlErrorCheck.hpp"
+
+#include <cstring>
+#include <iostream>
+
+#if defined(__linux__)
+#define OFFSCREEN_CONTEXT_EGL 1
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+using namespace std;
+
+//---------------------------------------------------------------------------------------
+OffscreenContext::OffscreenContext()
+	: m_display(nullptr),
+	  m_context(nullptr),
+	  m_framebuffer(0),
+	  m_colourRenderbuffer(0),
+	  m_depthRenderbuffer(0),
+	  m_width(0),
+	  m_height(0)
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+OffscreenContext::~OffscreenContext() {
+	destroy();
+}
+
+//---------------------------------------------------------------------------------------
+bool OffscreenContext::create(int width, int height) {
+#if OFFSCREEN_CONTEXT_EGL
+	destroy();
+
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+					eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	const char * extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (getPlatformDisplay && extensions
+			&& strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY,
+				nullptr);
+	}
+	if (display == EGL_NO_DISPLAY) {
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	EGLint major = 0, minor = 0;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		cerr << "No EGL display for offscreen rendering" << endl;
+		return false;
+	}
+	m_display = display;
+
+	// The context is made current without a surface, so any config that renders
+	// desktop GL will do.  The surfaceless platform has no window configs, which are
+	// what eglChooseConfig() looks for by default.
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, 0,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs)
+			|| numConfigs == 0 || !eglBindAPI(EGL_OPENGL_API)) {
+		cerr << "EGL " << major << "." << minor << " has no desktop OpenGL config" << endl;
+		destroy();
+		return false;
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT) {
+		cerr << "Could not create an OpenGL 3.3 core context with EGL" << endl;
+		destroy();
+		return false;
+	}
+	m_context = context;
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		cerr << "EGL cannot make a context current without a surface" << endl;
+		destroy();
+		return false;
+	}
+
+	// Same loader the windowed path initialises in CS488Window::launch().
+	if (gl3wInit() != 0) {
+		cerr << "Could not load OpenGL entry points" << endl;
+		destroy();
+		return false;
+	}
+
+	m_width = width;
+	m_height = height;
+
+	glGenRenderbuffers(1, &m_colourRenderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colourRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &m_depthRenderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+			m_colourRenderbuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+			m_depthRenderbuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		cerr << "Offscreen framebuffer is incomplete" << endl;
+		destroy();
+		return false;
+	}
+	glViewport(0, 0, width, height);
+
+	CHECK_GL_ERRORS;
+	return true;
+#else
+	(void)width;
+	(void)height;
+	cerr << "Offscreen rendering needs EGL, which this platform does not have" << endl;
+	return false;
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+void OffscreenContext::destroy() {
+#if OFFSCREEN_CONTEXT_EGL
+	if (m_framebuffer != 0) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &m_framebuffer);
+		GLuint renderbuffers[] = { m_colourRenderbuffer, m_depthRenderbuffer };
+		glDeleteRenderbuffers(2, renderbuffers);
+	}
+	if (m_context) {
+		eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(m_display, m_context);
+	}
+	if (m_display) {
+		eglTerminate(m_display);
+	}
+#endif
+	m_display = nullptr;
+	m_context = nullptr;
+	m_framebuffer = m_colourRenderbuffer = m_depthRenderbuffer = 0;
+	m_width = m_height = 0;
+}
+
+//---------------------------------------------------------------------------------------
+void OffscreenContext::readPixels(std::vector<uint8_t> & pixels) const {
+	const size_t rowBytes = 3 * size_t(m_width);
+	m_rows.resize(rowBytes * m_height);
+	pixels.resize(m_rows.size());
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, m_rows.data());
+	CHECK_GL_ERRORS;
+
+	// GL returns the bottom row first.
+	for (int y = 0; y < m_height; ++y) {
+		memcpy(&pixels[rowBytes * y], &m_rows[rowBytes * (m_height - 1 - y)], rowBytes);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+std::string OffscreenContext::renderer() const {
+	const GLubyte * name = glGetString(GL_RENDERER);
+	return name ? reinterpret_cast<const char *>(name) : "unknown";
+}
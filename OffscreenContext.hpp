@@ -0,0 +1,43 @@
+#pragma once
+
+#include "cs488-framework/OpenGLImport.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A GL context with no window, for rendering without a display.  Uses EGL on Mesa's
+// surfaceless platform when it exists, which needs neither an X server nor a GPU (set
+// LIBGL_ALWAYS_SOFTWARE=1 for llvmpipe), and the default EGL display otherwise.
+// Everything is drawn into an RGBA8 framebuffer with a depth buffer, bound for the
+// lifetime of the context.
+class OffscreenContext {
+public:
+	OffscreenContext();
+	~OffscreenContext();
+
+	// Create the context and a width x height framebuffer, and make both current.
+	// Prints the reason and returns false if there is no usable EGL display, GL 3.3
+	// core context or complete framebuffer.
+	bool create(int width, int height);
+	void destroy();
+
+	// Rows of RGB bytes, top row first, as an image file expects them.
+	void readPixels(std::vector<uint8_t> & pixels) const;
+
+	// GL_RENDERER of the context, e.g. "llvmpipe (LLVM 15.0.7, 256 bits)".
+	std::string renderer() const;
+
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+
+private:
+	void * m_display;
+	void * m_context;
+	GLuint m_framebuffer;
+	GLuint m_colourRenderbuffer;
+	GLuint m_depthRenderbuffer;
+	int m_width;
+	int m_height;
+	mutable std::vector<uint8_t> m_rows;   // Scratch for readPixels()
+};
@@ -0,0 +1,334 @@
+#include "PickingBvh.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace glm;
+using namespace std;
+
+namespace {
+
+// Leaves per BVH node.  Scenes are small, so the tree stays shallow anyway.
+const unsigned int MaxLeavesPerNode = 2;
+
+// Slab test.  Returns the entry distance, or a negative value on a miss.
+float intersectBounds(const vec3 & origin, const vec3 & inverseDirection,
+		const vec3 & boundsMin, const vec3 & boundsMax, float tMax) {
+	vec3 t0 = (boundsMin - origin) * inverseDirection;
+	vec3 t1 = (boundsMax - origin) * inverseDirection;
+	vec3 tNear = glm::min(t0, t1);
+	vec3 tFar = glm::max(t0, t1);
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+	return (enter <= exit) ? enter : -1.0f;
+}
+
+vec3 safeInverse(const vec3 & direction) {
+	// Infinities are fine for the slab test, as long as they carry the right sign.
+	const float huge = numeric_limits<float>::infinity();
+	vec3 result;
+	for (int c = 0; c < 3; ++c) {
+		result[c] = (direction[c] != 0.0f) ? 1.0f / direction[c]
+				: (signbit(direction[c]) ? -huge : huge);
+	}
+	return result;
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+PickingBvh::PickingBvh()
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+void PickingBvh::addMesh(
+		const std::string & meshId,
+		const float * positions,
+		size_t numVertices,
+		const uint32_t * indices,
+		size_t numIndices
+) {
+	MeshTriangles & mesh = m_meshes[meshId];
+	mesh.positions.resize(numVertices);
+	for (size_t i = 0; i < numVertices; ++i) {
+		mesh.positions[i] = vec3(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+	}
+	mesh.indices.assign(indices, indices + numIndices);
+
+	mesh.boundsMin = vec3(numeric_limits<float>::max());
+	mesh.boundsMax = vec3(-numeric_limits<float>::max());
+	for (uint32_t index : mesh.indices) {
+		mesh.boundsMin = glm::min(mesh.boundsMin, mesh.positions[index]);
+		mesh.boundsMax = glm::max(mesh.boundsMax, mesh.positions[index]);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void PickingBvh::clearMeshes() {
+	m_meshes.clear();
+	m_leaves.clear();
+	m_leafOrder.clear();
+	m_nodes.clear();
+}
+
+//---------------------------------------------------------------------------------------
+void PickingBvh::build(const FlatSceneGraph & scene) {
+	m_leaves.clear();
+	m_leafOrder.clear();
+	m_nodes.clear();
+
+	for (unsigned int i : scene.geometryIndices) {
+		const GeometryNode * node = static_cast<const GeometryNode *>(scene.nodes[i]);
+		auto found = m_meshes.find(node->meshId);
+		if (found == m_meshes.end() || found->second.indices.empty()) {
+			continue;
+		}
+		Leaf leaf;
+		leaf.mesh = &found->second;
+		leaf.node = node;
+		leaf.flatIndex = i;
+		updateLeaf(leaf, scene.worldTransforms[i]);
+		m_leafOrder.push_back(unsigned(m_leaves.size()));
+		m_leaves.push_back(leaf);
+	}
+
+	if (!m_leaves.empty()) {
+		m_nodes.reserve(2 * m_leaves.size());
+		buildNode(0, unsigned(m_leaves.size()));
+	}
+	m_nodeMoved.assign(m_nodes.size(), 0);
+}
+
+//---------------------------------------------------------------------------------------
+// Top-down build, splitting at the median leaf centre along the longest axis.
+unsigned int PickingBvh::buildNode(unsigned int first, unsigned int count) {
+	unsigned int index = unsigned(m_nodes.size());
+	m_nodes.push_back(Node());
+
+	vec3 boundsMin(numeric_limits<float>::max());
+	vec3 boundsMax(-numeric_limits<float>::max());
+	vec3 centreMin = boundsMin;
+	vec3 centreMax = boundsMax;
+	for (unsigned int i = first; i < first + count; ++i) {
+		const Leaf & leaf = m_leaves[m_leafOrder[i]];
+		boundsMin = glm::min(boundsMin, leaf.boundsMin);
+		boundsMax = glm::max(boundsMax, leaf.boundsMax);
+		vec3 centre = 0.5f * (leaf.boundsMin + leaf.boundsMax);
+		centreMin = glm::min(centreMin, centre);
+		centreMax = glm::max(centreMax, centre);
+	}
+
+	Node node;
+	node.boundsMin = boundsMin;
+	node.boundsMax = boundsMax;
+	node.left = node.right = 0;
+	node.firstLeaf = first;
+	node.leafCount = count;
+
+	if (count > MaxLeavesPerNode) {
+		vec3 extent = centreMax - centreMin;
+		int axis = (extent.x > extent.y) ? 0 : 1;
+		if (extent.z > extent[axis]) {
+			axis = 2;
+		}
+		unsigned int * begin = m_leafOrder.data() + first;
+		nth_element(begin, begin + count / 2, begin + count,
+				[this, axis](unsigned int a, unsigned int b) {
+			return m_leaves[a].boundsMin[axis] + m_leaves[a].boundsMax[axis]
+					< m_leaves[b].boundsMin[axis] + m_leaves[b].boundsMax[axis];
+		});
+
+		node.leafCount = 0;
+		node.left = buildNode(first, count / 2);
+		node.right = buildNode(first + count / 2, count - count / 2);
+	}
+
+	m_nodes[index] = node;
+	return index;
+}
+
+//---------------------------------------------------------------------------------------
+void PickingBvh::updateLeaf(Leaf & leaf, const glm::mat4 & world) {
+	leaf.world = world;
+	leaf.inverseWorld = inverse(world);
+	leaf.handedness = (determinant(mat3(world)) < 0.0f) ? -1.0f : 1.0f;
+
+	// World bounds of the eight transformed corners of the mesh bounds.
+	leaf.boundsMin = vec3(numeric_limits<float>::max());
+	leaf.boundsMax = vec3(-numeric_limits<float>::max());
+	for (int corner = 0; corner < 8; ++corner) {
+		vec3 p((corner & 1) ? leaf.mesh->boundsMax.x : leaf.mesh->boundsMin.x,
+				(corner & 2) ? leaf.mesh->boundsMax.y : leaf.mesh->boundsMin.y,
+				(corner & 4) ? leaf.mesh->boundsMax.z : leaf.mesh->boundsMin.z);
+		vec3 q = vec3(world * vec4(p, 1.0f));
+		leaf.boundsMin = glm::min(leaf.boundsMin, q);
+		leaf.boundsMax = glm::max(leaf.boundsMax, q);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+unsigned int PickingBvh::refit(const FlatSceneGraph & scene) {
+	unsigned int moved = 0;
+	for (size_t n = m_nodes.size(); n-- > 0; ) {
+		Node & node = m_nodes[n];
+		bool changed = false;
+
+		if (node.leafCount > 0) {
+			for (unsigned int i = node.firstLeaf; i < node.firstLeaf + node.leafCount; ++i) {
+				Leaf & leaf = m_leaves[m_leafOrder[i]];
+				const mat4 & world = scene.worldTransforms[leaf.flatIndex];
+				if (memcmp(&world, &leaf.world, sizeof(mat4)) != 0) {
+					updateLeaf(leaf, world);
+					changed = true;
+					++moved;
+				}
+			}
+		} else {
+			changed = m_nodeMoved[node.left] || m_nodeMoved[node.right];
+		}
+
+		m_nodeMoved[n] = changed;
+		if (!changed) {
+			continue;
+		}
+
+		if (node.leafCount > 0) {
+			node.boundsMin = vec3(numeric_limits<float>::max());
+			node.boundsMax = vec3(-numeric_limits<float>::max());
+			for (unsigned int i = node.firstLeaf; i < node.firstLeaf + node.leafCount; ++i) {
+				const Leaf & leaf = m_leaves[m_leafOrder[i]];
+				node.boundsMin = glm::min(node.boundsMin, leaf.boundsMin);
+				node.boundsMax = glm::max(node.boundsMax, leaf.boundsMax);
+			}
+		} else {
+			node.boundsMin = glm::min(m_nodes[node.left].boundsMin, m_nodes[node.right].boundsMin);
+			node.boundsMax = glm::max(m_nodes[node.left].boundsMax, m_nodes[node.right].boundsMax);
+		}
+	}
+	return moved;
+}
+
+//---------------------------------------------------------------------------------------
+bool PickingBvh::intersect(const Ray & ray, const RayCulling & culling, RayHit & hit) const {
+	if (m_nodes.empty()) {
+		return false;
+	}
+
+	const vec3 inverseDirection = safeInverse(ray.direction);
+	float tMax = 1.0f;
+	const Leaf * closest = nullptr;
+
+	unsigned int stack[64];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const Node & node = m_nodes[stack[--stackSize]];
+		if (intersectBounds(ray.origin, inverseDirection, node.boundsMin, node.boundsMax,
+				tMax) < 0.0f) {
+			continue;
+		}
+
+		if (node.leafCount > 0) {
+			for (unsigned int i = node.firstLeaf; i < node.firstLeaf + node.leafCount; ++i) {
+				const Leaf & leaf = m_leaves[m_leafOrder[i]];
+				if (intersectLeaf(leaf, ray, culling, tMax)) {
+					closest = &leaf;
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first, so tMax shrinks early.
+		float tLeft = intersectBounds(ray.origin, inverseDirection,
+				m_nodes[node.left].boundsMin, m_nodes[node.left].boundsMax, tMax);
+		float tRight = intersectBounds(ray.origin, inverseDirection,
+				m_nodes[node.right].boundsMin, m_nodes[node.right].boundsMax, tMax);
+		if (tLeft >= 0.0f && tRight >= 0.0f) {
+			bool leftFirst = tLeft <= tRight;
+			stack[stackSize++] = leftFirst ? node.right : node.left;
+			stack[stackSize++] = leftFirst ? node.left : node.right;
+		} else if (tLeft >= 0.0f) {
+			stack[stackSize++] = node.left;
+		} else if (tRight >= 0.0f) {
+			stack[stackSize++] = node.right;
+		}
+	}
+
+	if (closest == nullptr) {
+		return false;
+	}
+	hit.node = closest->node;
+	hit.flatIndex = closest->flatIndex;
+	hit.t = tMax;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+// Moller-Trumbore against every triangle of the leaf, in the mesh's model space.  The
+// ray is transformed without normalizing its direction, so t is the same in both
+// spaces.  Shrinks tMax and returns true if a closer hit was found.
+bool PickingBvh::intersectLeaf(
+		const Leaf & leaf,
+		const Ray & ray,
+		const RayCulling & culling,
+		float & tMax
+) const {
+	const vec3 origin = vec3(leaf.inverseWorld * vec4(ray.origin, 1.0f));
+	const vec3 direction = vec3(leaf.inverseWorld * vec4(ray.direction, 0.0f));
+
+	// det > 0 means the ray sees the counter-clockwise side, i.e. the front face, once
+	// mirroring transforms are accounted for.
+	const float facing = leaf.handedness * culling.handedness;
+
+	const vec3 * positions = leaf.mesh->positions.data();
+	const uint32_t * indices = leaf.mesh->indices.data();
+	const size_t numIndices = leaf.mesh->indices.size();
+
+	bool found = false;
+	for (size_t i = 0; i + 2 < numIndices; i += 3) {
+		const vec3 & a = positions[indices[i]];
+		const vec3 e1 = positions[indices[i + 1]] - a;
+		const vec3 e2 = positions[indices[i + 2]] - a;
+
+		const vec3 p = cross(direction, e2);
+		const float det = dot(e1, p);
+		if (det == 0.0f) {
+			continue;
+		}
+		const bool frontFacing = det * facing > 0.0f;
+		if ((frontFacing && culling.frontFaces) || (!frontFacing && culling.backFaces)) {
+			continue;
+		}
+
+		const float inverseDet = 1.0f / det;
+		const vec3 s = origin - a;
+		const float u = dot(s, p) * inverseDet;
+		if (u < 0.0f || u > 1.0f) {
+			continue;
+		}
+		const vec3 q = cross(s, e1);
+		const float v = dot(direction, q) * inverseDet;
+		if (v < 0.0f || u + v > 1.0f) {
+			continue;
+		}
+		const float t = dot(e2, q) * inverseDet;
+		if (t >= 0.0f && t < tMax) {
+			tMax = t;
+			found = true;
+		}
+	}
+	return found;
+}
+
+//---------------------------------------------------------------------------------------
+size_t PickingBvh::numNodes() const {
+	return m_nodes.size();
+}
+
+//---------------------------------------------------------------------------------------
+size_t PickingBvh::numLeaves() const {
+	return m_leaves.size();
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "FlatSceneGraph.hpp"
+#include "GeometryNode.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;   // Not normalized; hits are reported as origin + t * direction
+};
+
+struct RayHit {
+	const GeometryNode * node;
+	unsigned int flatIndex;   // Index of node in the FlatSceneGraph
+	float t;
+};
+
+// Which triangles a ray must ignore, mirroring glCullFace.
+struct RayCulling {
+	bool backFaces;
+	bool frontFaces;
+	float handedness;   // Sign of det(mat3(view)), flips which side counts as front
+};
+
+// Bounding volume hierarchy over the world-space bounds of every GeometryNode in a
+// FlatSceneGraph, for picking on the CPU.  Rays are tested exactly against the
+// triangles of the nodes whose bounds they hit.  World space here is that of
+// FlatSceneGraph::worldTransforms, without view or puppet transforms.
+class PickingBvh {
+public:
+	PickingBvh();
+
+	// Keep a copy of the triangles of meshId.  indices select numIndices / 3 triangles
+	// from positions, which holds 3 floats per vertex.
+	void addMesh(const std::string & meshId, const float * positions, size_t numVertices,
+			const uint32_t * indices, size_t numIndices);
+	void clearMeshes();
+
+	// Build the hierarchy over scene's GeometryNodes.  Must be called again whenever
+	// the scene structure or the meshes change; GeometryNodes without mesh data are
+	// skipped.
+	void build(const FlatSceneGraph & scene);
+
+	// Update the bounds of the nodes whose world transform changed since the last
+	// build or refit, and of their ancestors in the hierarchy.  The tree topology is
+	// kept.  Returns the number of GeometryNodes that moved.
+	unsigned int refit(const FlatSceneGraph & scene);
+
+	// Closest triangle hit with t in [0, 1], false if there is none.
+	bool intersect(const Ray & ray, const RayCulling & culling, RayHit & hit) const;
+
+	size_t numNodes() const;
+	size_t numLeaves() const;
+
+private:
+	struct MeshTriangles {
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	// One GeometryNode.
+	struct Leaf {
+		const MeshTriangles * mesh;
+		const GeometryNode * node;
+		unsigned int flatIndex;
+		glm::mat4 world;
+		glm::mat4 inverseWorld;
+		float handedness;        // Sign of det(mat3(world))
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	// Children are always stored after their parent, so a reverse sweep refits
+	// bottom-up.  Interior nodes have leafCount == 0.
+	struct Node {
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		unsigned int left, right;   // Child nodes, interior only
+		unsigned int firstLeaf;     // Into m_leafOrder, leaf nodes only
+		unsigned int leafCount;
+	};
+
+	unsigned int buildNode(unsigned int first, unsigned int count);
+	void updateLeaf(Leaf & leaf, const glm::mat4 & world);
+	bool intersectLeaf(const Leaf & leaf, const Ray & ray, const RayCulling & culling,
+			float & tMax) const;
+
+	std::unordered_map<std::string, MeshTriangles> m_meshes;
+	std::vector<Leaf> m_leaves;
+	std::vector<unsigned int> m_leafOrder;
+	std::vector<Node> m_nodes;
+	std::vector<char> m_nodeMoved;   // Scratch for refit()
+};
@@ -0,0 +1,256 @@
+#include "Pose.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+const char PoseFileMagic[8] = { 'P', '3', 'D', 'P', 'O', 'S', 'E', '\0' };
+
+struct PoseFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t numJoints;
+	uint32_t numPoses;
+	uint32_t reserved;
+};
+
+// Copy s into a zero-padded field of PoseLibrary::PoseKeyLength chars, which always
+// keeps a terminating zero.
+bool writeKey(const string & s, char * field) {
+	if (s.size() >= PoseLibrary::PoseKeyLength) {
+		return false;
+	}
+	memset(field, 0, PoseLibrary::PoseKeyLength);
+	memcpy(field, s.data(), s.size());
+	return true;
+}
+
+string readKey(const char * field) {
+	return string(field, strnlen(field, PoseLibrary::PoseKeyLength));
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+void JointTable::build(const FlatSceneGraph & graph) {
+	clear();
+
+	unordered_map<string, unsigned int> nameCounts;
+	for (size_t i = 0; i < graph.size(); ++i) {
+		SceneNode * node = graph.nodes[i];
+		if (node->m_nodeType != NodeType::JointNode) {
+			continue;
+		}
+		string key = node->m_name;
+		unsigned int count = ++nameCounts[key];
+		if (count > 1) {
+			key += "#" + to_string(count);
+		}
+
+		m_keyToIndex[key] = unsigned(joints.size());
+		joints.push_back(static_cast<JointNode *>(node));
+		keys.push_back(key);
+	}
+
+	if (joints.empty()) {
+		return;
+	}
+	unsigned int lastNodeId = joints[0]->m_nodeId;
+	m_firstNodeId = lastNodeId;
+	for (const JointNode * joint : joints) {
+		m_firstNodeId = min(m_firstNodeId, joint->m_nodeId);
+		lastNodeId = max(lastNodeId, joint->m_nodeId);
+	}
+	m_nodeIdToIndex.assign(size_t(lastNodeId - m_firstNodeId) + 1, -1);
+	for (size_t i = 0; i < joints.size(); ++i) {
+		m_nodeIdToIndex[joints[i]->m_nodeId - m_firstNodeId] = int(i);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void JointTable::clear() {
+	joints.clear();
+	keys.clear();
+	m_keyToIndex.clear();
+	m_firstNodeId = 0;
+	m_nodeIdToIndex.clear();
+}
+
+//---------------------------------------------------------------------------------------
+int JointTable::find(const std::string & key) const {
+	auto it = m_keyToIndex.find(key);
+	return it == m_keyToIndex.end() ? -1 : int(it->second);
+}
+
+//---------------------------------------------------------------------------------------
+JointNode * JointTable::findByNodeId(unsigned int nodeId) const {
+	if (nodeId < m_firstNodeId || nodeId - m_firstNodeId >= m_nodeIdToIndex.size()) {
+		return nullptr;
+	}
+	int index = m_nodeIdToIndex[nodeId - m_firstNodeId];
+	return index < 0 ? nullptr : joints[size_t(index)];
+}
+
+//---------------------------------------------------------------------------------------
+void Pose::capture(const JointTable & table) {
+	angles.resize(2 * table.size());
+	for (size_t i = 0; i < table.size(); ++i) {
+		angles[2 * i] = float(table.joints[i]->current_angle_y);
+		angles[2 * i + 1] = float(table.joints[i]->current_angle_z);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void Pose::apply(const JointTable & table) const {
+	if (numJoints() != table.size()) {
+		return;
+	}
+	for (size_t i = 0; i < table.size(); ++i) {
+		table.joints[i]->set_angles(angles[2 * i], angles[2 * i + 1]);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+size_t PoseLibrary::store(const std::string & name, const Pose & pose) {
+	for (size_t i = 0; i < names.size(); ++i) {
+		if (names[i] == name) {
+			poses[i] = pose;
+			return i;
+		}
+	}
+	names.push_back(name);
+	poses.push_back(pose);
+	return poses.size() - 1;
+}
+
+//---------------------------------------------------------------------------------------
+void PoseLibrary::clear() {
+	names.clear();
+	poses.clear();
+}
+
+//---------------------------------------------------------------------------------------
+bool PoseLibrary::save(const std::string & path, const JointTable & table) const {
+	PoseFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PoseFileMagic, sizeof(PoseFileMagic));
+	header.version = Version;
+	header.numJoints = uint32_t(table.size());
+	header.numPoses = uint32_t(poses.size());
+
+	vector<char> keys(table.size() * PoseKeyLength);
+	for (size_t i = 0; i < table.size(); ++i) {
+		if (!writeKey(table.keys[i], &keys[i * PoseKeyLength])) {
+			return false;
+		}
+	}
+
+	// Write to a temporary name first so an interrupted write never leaves a
+	// truncated library behind.
+	string tempPath = path + ".tmp";
+	FILE * file = fopen(tempPath.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(keys.data(), 1, keys.size(), file) == keys.size();
+	char name[PoseKeyLength];
+	for (size_t p = 0; ok && p < poses.size(); ++p) {
+		const Pose & pose = poses[p];
+		ok = writeKey(names[p], name) && pose.numJoints() == table.size();
+		ok = ok && fwrite(name, 1, PoseKeyLength, file) == PoseKeyLength;
+		ok = ok && fwrite(pose.angles.data(), sizeof(float), pose.angles.size(), file)
+				== pose.angles.size();
+	}
+	ok = (fclose(file) == 0) && ok;
+	if (!ok || rename(tempPath.c_str(), path.c_str()) != 0) {
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+bool PoseLibrary::load(const std::string & path, const JointTable & table,
+		const Pose & fallback) {
+	if (fallback.numJoints() != table.size()) {
+		return false;
+	}
+	FILE * file = fopen(path.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+
+	PoseFileHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1
+		&& memcmp(header.magic, PoseFileMagic, sizeof(PoseFileMagic)) == 0
+		&& header.version == Version;
+
+	// The counts size the buffers below, so a truncated or corrupt file must not get
+	// that far: the keys and poses they describe have to fill the rest of the file.
+	if (ok) {
+		ok = fseek(file, 0, SEEK_END) == 0;
+		long fileSize = ok ? ftell(file) : -1;
+		ok = fileSize >= long(sizeof(header)) && fseek(file, sizeof(header), SEEK_SET) == 0;
+		uint64_t rest = ok ? uint64_t(fileSize) - sizeof(header) : 0;
+		const uint64_t keyBytes = uint64_t(header.numJoints) * PoseKeyLength;
+		const uint64_t poseBytes = PoseKeyLength + 2 * sizeof(float) * uint64_t(header.numJoints);
+		ok = ok && keyBytes <= rest;
+		rest -= ok ? keyBytes : 0;
+		ok = ok && rest % poseBytes == 0 && rest / poseBytes == header.numPoses;
+	}
+
+	// Table index of each joint of the file, or -1.
+	vector<int> remap;
+	vector<char> keys(ok ? size_t(header.numJoints) * PoseKeyLength : 0);
+	ok = ok && fread(keys.data(), 1, keys.size(), file) == keys.size();
+	for (uint32_t j = 0; ok && j < header.numJoints; ++j) {
+		remap.push_back(table.find(readKey(&keys[j * PoseKeyLength])));
+	}
+
+	vector<string> loadedNames;
+	vector<Pose> loadedPoses;
+	vector<float> fileAngles(ok ? 2 * size_t(header.numJoints) : 0);
+	char name[PoseKeyLength];
+	for (uint32_t p = 0; ok && p < header.numPoses; ++p) {
+		ok = fread(name, 1, PoseKeyLength, file) == PoseKeyLength
+			&& fread(fileAngles.data(), sizeof(float), fileAngles.size(), file)
+				== fileAngles.size();
+		for (size_t a = 0; ok && a < fileAngles.size(); ++a) {
+			ok = std::isfinite(fileAngles[a]);
+		}
+		if (!ok) {
+			break;
+		}
+
+		loadedNames.push_back(readKey(name));
+		loadedPoses.emplace_back();
+		Pose & pose = loadedPoses.back();
+		pose.angles = fallback.angles;
+		for (size_t j = 0; j < remap.size(); ++j) {
+			if (remap[j] >= 0) {
+				// The file may have been edited by hand, so hold it to the limits that
+				// interactive edits keep: m_joint_x about z and m_joint_y about y.
+				const JointNode * joint = table.joints[size_t(remap[j])];
+				pose.angles[2 * size_t(remap[j])] = float(min(max(double(fileAngles[2 * j]),
+						joint->m_joint_y.min), joint->m_joint_y.max));
+				pose.angles[2 * size_t(remap[j]) + 1] = float(min(max(
+						double(fileAngles[2 * j + 1]), joint->m_joint_x.min),
+						joint->m_joint_x.max));
+			}
+		}
+	}
+	fclose(file);
+
+	if (!ok) {
+		return false;
+	}
+	names.swap(loadedNames);
+	poses.swap(loadedPoses);
+	return true;
+}
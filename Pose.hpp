@@ -0,0 +1,88 @@
+#pragma once
+
+#include "FlatSceneGraph.hpp"
+#include "JointNode.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Dense index over the JointNodes of a FlatSceneGraph, in flat (pre-order) order, with
+// a name key per joint.
+class JointTable {
+public:
+	// Index the joints of graph.  Must be called again whenever graph is rebuilt.
+	void build(const FlatSceneGraph & graph);
+	void clear();
+
+	size_t size() const { return joints.size(); }
+
+	// Index of the joint with key, or -1.
+	int find(const std::string & key) const;
+
+	// The joint with SceneNode::m_nodeId nodeId, or nullptr.  The nodes of one scene get
+	// consecutive ids, so this is a single array lookup.
+	JointNode * findByNodeId(unsigned int nodeId) const;
+
+	std::vector<JointNode *> joints;
+	std::vector<std::string> keys;            // Joint names, "name#2", "name#3"... on repeats
+
+private:
+	std::unordered_map<std::string, unsigned int> m_keyToIndex;
+	unsigned int m_firstNodeId = 0;
+	std::vector<int> m_nodeIdToIndex;         // Joint index of nodeId - m_firstNodeId, or -1
+};
+
+// Angles of every joint of a JointTable, in degrees: angles[2 * i] about y and
+// angles[2 * i + 1] about z for joint i.  One contiguous array, so a pose is copied,
+// stored or written with a single memcpy.
+struct Pose {
+	std::vector<float> angles;
+
+	void capture(const JointTable & table);
+
+	// Set the angles of every joint.  Only joints whose angles differ are marked dirty.
+	// A pose captured from another table size is ignored.
+	void apply(const JointTable & table) const;
+
+	size_t numJoints() const { return angles.size() / 2; }
+};
+
+// Named poses of one scene, saved to and loaded from a small binary file.
+//
+// File layout (native byte order):
+//   PoseFileHeader
+//   char jointKeys[numJoints][PoseKeyLength]
+//   numPoses times:
+//     char name[PoseKeyLength]
+//     float angles[2 * numJoints]      in the order of jointKeys
+//
+// Joints are matched by key when loading, so a file stays usable after joints are
+// added, removed or reordered in the scene: joints the file does not know get fallback
+// angles and joints the scene no longer has are skipped.
+class PoseLibrary {
+public:
+	static const uint32_t Version = 1;
+	static const size_t PoseKeyLength = 64;
+
+	// Store pose under name, replacing a pose of the same name.  Returns its index.
+	size_t store(const std::string & name, const Pose & pose);
+	void clear();
+
+	size_t size() const { return poses.size(); }
+
+	// Returns false on I/O error, or if a joint key or pose name is too long.
+	bool save(const std::string & path, const JointTable & table) const;
+
+	// Replace the library with the poses of path, remapped onto table and clamped to
+	// its joint limits.  Joints the file does not know take their angles from fallback,
+	// a pose of table.  Returns false, leaving the library unchanged, if the file is
+	// missing, of another version, not the size its header gives, or holds an angle that
+	// is not finite.
+	bool load(const std::string & path, const JointTable & table, const Pose & fallback);
+
+	std::vector<std::string> names;
+	std::vector<Pose> poses;
+};
@@ -0,0 +1,74 @@
+#include "RenderJobs.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+//---------------------------------------------------------------------------------------
+bool readRenderJobs(const std::string & path, std::vector<RenderJob> & jobs) {
+	ifstream file(path);
+	if (!file) {
+		cerr << "Could not open job file " << path << endl;
+		return false;
+	}
+
+	string line;
+	unsigned int lineNumber = 0;
+	while (getline(file, line)) {
+		++lineNumber;
+		istringstream fields(line);
+		vector<string> words;
+		for (string word; fields >> word; ) {
+			words.push_back(word);
+		}
+		if (words.empty() || words[0][0] == '#') {
+			continue;
+		}
+
+		RenderJob job;
+		bool ok = words.size() == 2 || words.size() == 4 || words.size() == 5;
+		if (ok) {
+			job.output = words[0];
+			job.pose = words[1];
+			float * numbers[] = { &job.yaw, &job.pitch, &job.dolly };
+			for (size_t i = 2; i < words.size() && ok; ++i) {
+				istringstream number(words[i]);
+				ok = (number >> *numbers[i - 2]) && number.eof();
+			}
+		}
+		if (!ok) {
+			cerr << path << ":" << lineNumber << ": expected <output> <pose> "
+				 << "[<yaw> <pitch> [<dolly>]], got \"" << line << "\"" << endl;
+			return false;
+		}
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+std::string imageFileName(const std::string & name) {
+	string fileName = name;
+	for (char & c : fileName) {
+		if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') {
+			c = '_';
+		}
+	}
+	return fileName;
+}
+
+//---------------------------------------------------------------------------------------
+bool writePpm(const std::string & path, int width, int height, const uint8_t * pixels) {
+	FILE * file = fopen(path.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	const size_t numBytes = 3 * size_t(width) * size_t(height);
+	bool ok = fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+	ok = ok && fwrite(pixels, 1, numBytes, file) == numBytes;
+	return (fclose(file) == 0) && ok;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One image of a batch render: a pose of the scene seen from one camera.
+struct RenderJob {
+	std::string output;    // Image file name, without directory or extension
+	std::string pose;      // Stored pose name, "rest", or "*" for every stored pose
+	float yaw = 0.0f;      // Degrees about the vertical axis through the scene's centre
+	float pitch = 0.0f;    // Degrees about the horizontal axis, after yaw
+	float dolly = 0.0f;    // Distance to move the scene away from the camera
+};
+
+// Read a job file.  Each line is
+//
+//     <output> <pose> [<yaw> <pitch> [<dolly>]]
+//
+// and blank lines and lines starting with '#' are skipped.  Prints the offending line
+// and returns false on a malformed one.
+bool readRenderJobs(const std::string & path, std::vector<RenderJob> & jobs);
+
+// Make name safe to use as a file name: anything but letters, digits, '-', '_' and '.'
+// becomes '_'.
+std::string imageFileName(const std::string & name);
+
+// Write rows of RGB bytes, top row first, as a binary PPM.  Returns false if the file
+// could not be written.
+bool writePpm(const std::string & path, int width, int height, const uint8_t * pixels);
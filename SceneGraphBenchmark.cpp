@@ -0,0 +1,379 @@
+#include "SceneGraphBenchmark.hpp"
+
+#include "puppet.hpp"
+#include "scene_lua.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace glm;
+using namespace std;
+
+namespace {
+
+// A sample runs a case at least this long, so clock resolution stays negligible.
+const double MinSampleSeconds = 2e-3;
+const unsigned int MaxIterations = 1u << 20;
+
+// Joint edits per undo case, joints per edit and mouse positions per trackball drag.
+const unsigned int NumEdits = 32;
+const unsigned int JointsPerEdit = 4;
+const unsigned int NumDragPoints = 256;
+
+// Keeps results of the timed code alive.
+volatile float sink;
+
+// One timed operation.  setup(), if set, runs untimed before every run(), and each run()
+// is then timed on its own; otherwise a sample times all its iterations at once.
+struct BenchmarkCase {
+	const char * name;
+	unsigned int opsPerIteration;
+	function<void()> setup;
+	function<void()> run;
+};
+
+// Nanoseconds per operation of each sample.
+struct BenchmarkResult {
+	const char * name;
+	size_t numNodes;
+	unsigned int iterations;
+	unsigned int opsPerIteration;
+	double min;
+	double median;
+	double mean;
+	double stddev;
+	double max;
+};
+
+// Seconds spent in run() over iterations.
+double timeIterations(const BenchmarkCase & benchmarkCase, unsigned int iterations) {
+	if (!benchmarkCase.setup) {
+		auto start = chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < iterations; ++i) {
+			benchmarkCase.run();
+		}
+		auto end = chrono::high_resolution_clock::now();
+		return chrono::duration<double>(end - start).count();
+	}
+	double seconds = 0.0;
+	for (unsigned int i = 0; i < iterations; ++i) {
+		benchmarkCase.setup();
+		auto start = chrono::high_resolution_clock::now();
+		benchmarkCase.run();
+		auto end = chrono::high_resolution_clock::now();
+		seconds += chrono::duration<double>(end - start).count();
+	}
+	return seconds;
+}
+
+BenchmarkResult runCase(const BenchmarkCase & benchmarkCase, size_t numNodes,
+		unsigned int repetitions) {
+	// Double the iterations until one sample is long enough, which also warms up.
+	unsigned int iterations = 1;
+	while (timeIterations(benchmarkCase, iterations) < MinSampleSeconds
+			&& iterations < MaxIterations) {
+		iterations *= 2;
+	}
+
+	vector<double> samples(repetitions);
+	const double ops = double(iterations) * benchmarkCase.opsPerIteration;
+	for (double & sample : samples) {
+		sample = 1e9 * timeIterations(benchmarkCase, iterations) / ops;
+	}
+	sort(samples.begin(), samples.end());
+
+	BenchmarkResult result;
+	result.name = benchmarkCase.name;
+	result.numNodes = numNodes;
+	result.iterations = iterations;
+	result.opsPerIteration = benchmarkCase.opsPerIteration;
+	result.min = samples.front();
+	result.max = samples.back();
+	result.median = (repetitions % 2) ? samples[repetitions / 2]
+			: 0.5 * (samples[repetitions / 2 - 1] + samples[repetitions / 2]);
+	double sum = 0.0;
+	for (double sample : samples) {
+		sum += sample;
+	}
+	result.mean = sum / repetitions;
+	double squares = 0.0;
+	for (double sample : samples) {
+		squares += (sample - result.mean) * (sample - result.mean);
+	}
+	result.stddev = (repetitions > 1) ? sqrt(squares / (repetitions - 1)) : 0.0;
+	return result;
+}
+
+// A puppet of exactly numNodes nodes: a root with a binary tree of joints below it,
+// each carrying one mesh, and a spare mesh on the root for an even count.  The trackball
+// pivots about the root's first child, so numNodes must be at least 2.
+bool writeScene(const string & path, unsigned int numNodes) {
+	ofstream file(path);
+	if (!file) {
+		return false;
+	}
+	const unsigned int numJoints = (numNodes - 1) / 2;
+	file << "material = gr.material({0.8, 0.6, 0.4}, {0.2, 0.2, 0.2}, 10.0)\n"
+		 << "j = {}\n"
+		 << "j[0] = gr.node('root')\n"
+		 << "j[0]:translate(0.0, 0.0, -10.0)\n";
+	for (unsigned int k = 1; k <= numJoints; ++k) {
+		file << "j[" << k << "] = gr.joint('joint" << k << "', {-45, 0, 45}, {-45, 0, 45})\n"
+			 << "j[" << k << "]:translate(0.5, " << ((k % 2) ? 0.25 : -0.25) << ", 0.0)\n"
+			 << "j[" << k / 2 << "]:add_child(j[" << k << "])\n"
+			 << "m = gr.mesh('cube', 'part" << k << "')\n"
+			 << "m:scale(0.4, 0.2, 0.2)\n"
+			 << "m:set_material(material)\n"
+			 << "j[" << k << "]:add_child(m)\n";
+	}
+	if ((numNodes - 1) % 2) {
+		file << "m = gr.mesh('sphere', 'spare')\n"
+			 << "m:set_material(material)\n"
+			 << "j[0]:add_child(m)\n";
+	}
+	file << "return j[0]\n";
+	return bool(file);
+}
+
+// Opens up the parts of Puppet the cases time.  Only the scene is loaded, init() and
+// everything else that needs a GL context is skipped.
+class BenchmarkPuppet : public Puppet {
+public:
+	BenchmarkPuppet()
+		: Puppet("")
+	{
+		m_windowWidth = m_framebufferWidth = 1024;
+		m_windowHeight = m_framebufferHeight = 768;
+	}
+
+	bool loadScene(const string & luaSceneFile) {
+		processLuaSceneFile(luaSceneFile);
+		if (!m_rootNode) {
+			return false;
+		}
+		m_flatSceneGraph.build(m_rootNode.get());
+		m_jointTable.build(m_flatSceneGraph);
+		m_restPose.capture(m_jointTable);
+		idToSceneNode.clear();
+		initViewMatrix();
+		puppet_transform = mat4(1.0f);
+		puppet_rotation = mat4(1.0f);
+		resetAll();
+		return true;
+	}
+
+	vector<BenchmarkCase> cases(const string & luaSceneFile) {
+		mt19937 random(488);
+		const size_t numNodes = m_flatSceneGraph.size();
+		const size_t numJoints = m_jointTable.size();
+
+		m_nodeIds.clear();
+		for (const SceneNode * node : m_flatSceneGraph.nodes) {
+			m_nodeIds.push_back(node->m_nodeId);
+		}
+		shuffle(m_nodeIds.begin(), m_nodeIds.end(), random);
+
+		// Edit e turns JointsPerEdit joints, two seconds after edit e - 1 so that no
+		// two edits are coalesced.
+		m_edits.assign(NumEdits, vector<JointDelta>());
+		for (unsigned int e = 0; e < NumEdits && numJoints > 0; ++e) {
+			for (unsigned int i = 0; i < JointsPerEdit; ++i) {
+				JointDelta delta;
+				delta.nodeId = m_jointTable.joints[(e * JointsPerEdit + i) % numJoints]
+						->m_nodeId;
+				delta.degrees = 5.0f;
+				delta.axisY = 1;
+				m_edits[e].push_back(delta);
+				delta.axisY = 0;
+				m_edits[e].push_back(delta);
+			}
+		}
+
+		m_perturbedPose.capture(m_jointTable);
+		uniform_real_distribution<float> angle(-45.0f, 45.0f);
+		for (float & a : m_perturbedPose.angles) {
+			a = angle(random);
+		}
+
+		// A drag in a circle about the centre of the window, and points inside and
+		// outside the trackball for mapToSphere().
+		m_dragPoints.clear();
+		m_spherePoints.clear();
+		const float radius = 0.4f * min(m_windowWidth, m_windowHeight);
+		for (unsigned int i = 0; i < NumDragPoints; ++i) {
+			float t = 6.2831853f * i / NumDragPoints;
+			m_dragPoints.push_back(vec2(0.5f * m_windowWidth + radius * cos(t),
+					0.5f * m_windowHeight + radius * sin(t)));
+			m_spherePoints.push_back(vec2(1.5f * radius * cos(3.0f * t),
+					1.5f * radius * sin(2.0f * t)));
+		}
+
+		vector<BenchmarkCase> benchmarkCases;
+		benchmarkCases.push_back({ "import_lua", 1, nullptr, [luaSceneFile]() {
+			unique_ptr<SceneNode> root(import_lua(luaSceneFile));
+			sink = float(root ? root->children.size() : 0);
+		}});
+		benchmarkCases.push_back({ "world_transforms_recursive", unsigned(numNodes),
+				[this]() { m_rootNode->mark_dirty(); },
+				[this]() { sink = worldTransforms(*m_rootNode, sceneViewTransform()); }});
+		benchmarkCases.push_back({ "world_transforms_flat", unsigned(numNodes),
+				[this]() { m_rootNode->mark_dirty(); },
+				[this]() { sink = float(m_flatSceneGraph.updateDirtyWorldTransforms()); }});
+		benchmarkCases.push_back({ "find_scene_node_by_id", unsigned(m_nodeIds.size()),
+				[this]() { idToSceneNode.clear(); },
+				[this]() {
+					for (unsigned int id : m_nodeIds) {
+						sink = float(findSceneNodeById(m_rootNode.get(), id)->m_nodeId);
+					}
+				}});
+		benchmarkCases.push_back({ "record_edit", NumEdits,
+				[this]() { copyEdits(); },
+				[this]() {
+					for (unsigned int e = 0; e < NumEdits; ++e) {
+						m_history.record(m_editScratch[e], 2.0 * e);
+					}
+				}});
+		benchmarkCases.push_back({ "undo", NumEdits,
+				[this]() { recordEdits(); },
+				[this]() { while (m_history.numUndo() > 0) { undo(); } }});
+		benchmarkCases.push_back({ "redo", NumEdits,
+				[this]() { recordEdits(); while (m_history.numUndo() > 0) { undo(); } },
+				[this]() { while (m_history.numRedo() > 0) { redo(); } }});
+		benchmarkCases.push_back({ "reset_joints", 1,
+				[this]() { m_perturbedPose.apply(m_jointTable); },
+				[this]() { resetJoints(); }});
+		benchmarkCases.push_back({ "map_to_sphere", NumDragPoints, nullptr, [this, radius]() {
+			vec3 sum(0.0f);
+			for (const vec2 & point : m_spherePoints) {
+				sum += mapToSphere(point.x, point.y, 2.0f * radius);
+			}
+			sink = sum.x + sum.y + sum.z;
+		}});
+		benchmarkCases.push_back({ "trackball_drag", NumDragPoints,
+				[this]() {
+					puppet_rotation = mat4(1.0f);
+					prev_mouse_x = m_dragPoints[0].x;
+					prev_mouse_y = m_dragPoints[0].y;
+					interactionMode = InteractionMode::POSITION;
+					mouse_right_down = true;
+				},
+				[this]() {
+					for (const vec2 & point : m_dragPoints) {
+						mouseMoveEvent(point.x, point.y);
+					}
+					sink = puppet_rotation[0][0];
+				}});
+		return benchmarkCases;
+	}
+
+private:
+	// World transform of every node under view, the way renderSceneNode() gets them.
+	static float worldTransforms(const SceneNode & node, const mat4 & view) {
+		mat4 modelView = view * node.get_world_transform();
+		float sum = modelView[3][2];
+		for (const SceneNode * child : node.children) {
+			sum += worldTransforms(*child, view);
+		}
+		return sum;
+	}
+
+	void copyEdits() {
+		m_history.clear();
+		m_editScratch = m_edits;
+	}
+
+	void recordEdits() {
+		m_restPose.apply(m_jointTable);
+		copyEdits();
+		for (unsigned int e = 0; e < NumEdits; ++e) {
+			m_history.record(m_editScratch[e], 2.0 * e);
+		}
+	}
+
+	vector<unsigned int> m_nodeIds;             // Every node, in random order
+	vector<vector<JointDelta>> m_edits;
+	vector<vector<JointDelta>> m_editScratch;   // record() sorts its deltas
+	Pose m_perturbedPose;
+	vector<vec2> m_dragPoints;                  // Window coordinates
+	vector<vec2> m_spherePoints;                // Relative to the trackball's centre
+};
+
+void writeJson(const vector<BenchmarkResult> & results, unsigned int repetitions,
+		ostream & out) {
+	out << "{\n"
+		<< "  \"benchmark\": \"scene_graph\",\n"
+		<< "  \"unit\": \"ns/op\",\n"
+		<< "  \"repetitions\": " << repetitions << ",\n"
+		<< "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const BenchmarkResult & r = results[i];
+		out << "    {\"case\": \"" << r.name << "\", \"nodes\": " << r.numNodes
+			<< ", \"iterations\": " << r.iterations
+			<< ", \"ops_per_iteration\": " << r.opsPerIteration
+			<< ", \"min\": " << r.min << ", \"median\": " << r.median
+			<< ", \"mean\": " << r.mean << ", \"stddev\": " << r.stddev
+			<< ", \"max\": " << r.max << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n"
+		<< "}\n";
+}
+
+void writeCsv(const vector<BenchmarkResult> & results, ostream & out) {
+	out << "case,nodes,iterations,ops_per_iteration,min_ns,median_ns,mean_ns,stddev_ns,"
+		<< "max_ns\n";
+	for (const BenchmarkResult & r : results) {
+		out << r.name << "," << r.numNodes << "," << r.iterations << ","
+			<< r.opsPerIteration << "," << r.min << "," << r.median << "," << r.mean << ","
+			<< r.stddev << "," << r.max << "\n";
+	}
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+int runSceneGraphBenchmark(const std::vector<unsigned int> & nodeCounts,
+		unsigned int repetitions, const std::string & format, std::ostream & out) {
+	repetitions = max(repetitions, 1u);
+	if (format != "json" && format != "csv") {
+		cerr << "Unknown format " << format << ", expected json or csv" << endl;
+		return 1;
+	}
+
+	// Puppet's ShaderPrograms release their GL objects when destroyed, and there is
+	// no context to release them from, so the puppet lives until the process exits.
+	BenchmarkPuppet * puppet = new BenchmarkPuppet();
+
+	vector<BenchmarkResult> results;
+	for (unsigned int numNodes : nodeCounts) {
+		numNodes = max(numNodes, 2u);
+		const string sceneFile = "scene_graph_benchmark_" + to_string(numNodes) + ".lua";
+		if (!writeScene(sceneFile, numNodes) || !puppet->loadScene(sceneFile)) {
+			cerr << "Could not generate a scene of " << numNodes << " nodes" << endl;
+			remove(sceneFile.c_str());
+			return 1;
+		}
+		cerr << "Timing " << numNodes << " nodes..." << endl;
+		for (const BenchmarkCase & benchmarkCase : puppet->cases(sceneFile)) {
+			results.push_back(runCase(benchmarkCase, numNodes, repetitions));
+		}
+		remove(sceneFile.c_str());
+	}
+
+	out << setprecision(6);
+	if (format == "json") {
+		writeJson(results, repetitions, out);
+	} else {
+		writeCsv(results, out);
+	}
+	return 0;
+}
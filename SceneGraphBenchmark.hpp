@@ -0,0 +1,14 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Time the scene-graph hot paths of Puppet on generated puppets of each of nodeCounts
+// nodes: import_lua(), world transforms as renderSceneNode() and FlatSceneGraph
+// evaluate them, findSceneNodeById(), recording, undoing and redoing joint edits,
+// resetJoints(), mapToSphere() and trackball drags.  Each case is sampled repetitions
+// times and its nanoseconds per operation written to out as "json" or "csv", for
+// comparing against a saved baseline.  Returns 0, or 1 if a scene could not be loaded.
+int runSceneGraphBenchmark(const std::vector<unsigned int> & nodeCounts,
+		unsigned int repetitions, const std::string & format, std::ostream & out);
@@ -16,15 +16,18 @@ using namespace glm;
 
 // Static class variable
 unsigned int SceneNode::nodeInstanceCount = 0;
+unsigned int SceneNode::worldRecomputeCount = 0;
 
 
 //---------------------------------------------------------------------------------------
 SceneNode::SceneNode(const std::string& name)
-  : m_name(name),
+  : isSelected(false),
+	trans(mat4()),
+	m_transDirty(false),
+	m_worldDirty(true),
 	m_parent(nullptr),
 	m_nodeType(NodeType::SceneNode),
-	trans(mat4()),
-	isSelected(false),
+	m_name(name),
 	m_nodeId(nodeInstanceCount++),
 	current_angle_y(0),
 	current_angle_z(0)
@@ -35,13 +38,18 @@ SceneNode::SceneNode(const std::string& name)
 //---------------------------------------------------------------------------------------
 // Deep copy
 SceneNode::SceneNode(const SceneNode & other)
-	: m_nodeType(other.m_nodeType),
-	  m_name(other.m_name),
-	  trans(other.trans),
-	  invtrans(other.invtrans)
+	: trans(other.get_transform()),
+	  invtrans(other.invtrans),
+	  m_transDirty(false),
+	  m_worldDirty(true),
+	  m_parent(nullptr),
+	  m_nodeType(other.m_nodeType),
+	  m_name(other.m_name)
 {
 	for(SceneNode * child : other.children) {
-		this->children.push_front(new SceneNode(*child));
+		SceneNode * copy = new SceneNode(*child);
+		copy->m_parent = this;
+		this->children.push_front(copy);
 	}
 }
 
@@ -56,13 +64,45 @@ SceneNode::~SceneNode() {
 void SceneNode::set_transform(const glm::mat4& m) {
 	trans = m;
 	invtrans = m;
+	mark_dirty();
+}
+
+//---------------------------------------------------------------------------------------
+const glm::mat4& SceneNode::get_world_transform() const {
+	if (m_worldDirty) {
+		m_worldTransform = m_parent ? m_parent->get_world_transform() * get_transform()
+				: get_transform();
+		m_worldDirty = false;
+		++worldRecomputeCount;
+	}
+	return m_worldTransform;
+}
+
+//---------------------------------------------------------------------------------------
+void SceneNode::mark_dirty() {
+	if (m_worldDirty) {
+		return;
+	}
+	m_worldDirty = true;
+	for (SceneNode * child : children) {
+		child->mark_dirty();
+	}
 }
 
 //---------------------------------------------------------------------------------------
 const glm::mat4& SceneNode::get_transform() const {
+	if (m_transDirty) {
+		rebuild_transform();
+		m_transDirty = false;
+	}
 	return trans;
 }
 
+//---------------------------------------------------------------------------------------
+void SceneNode::rebuild_transform() const {
+
+}
+
 //---------------------------------------------------------------------------------------
 const glm::mat4& SceneNode::get_inverse() const {
 	return invtrans;
@@ -72,12 +112,14 @@ const glm::mat4& SceneNode::get_inverse() const {
 void SceneNode::add_child(SceneNode* child) {
 	children.push_back(child);
 	child->m_parent = this;
+	child->mark_dirty();
 }
 
 //---------------------------------------------------------------------------------------
 void SceneNode::remove_child(SceneNode* child) {
 	children.remove(child);
 	child->m_parent = nullptr;
+	child->mark_dirty();
 }
 
 //---------------------------------------------------------------------------------------
@@ -101,16 +143,19 @@ void SceneNode::rotate(char axis, float angle) {
 	}
 	mat4 rot_matrix = glm::rotate(degreesToRadians(angle), rot_axis);
 	trans = rot_matrix * trans;
+	mark_dirty();
 }
 
 //---------------------------------------------------------------------------------------
 void SceneNode::scale(const glm::vec3 & amount) {
 	trans = glm::scale(amount) * trans;
+	mark_dirty();
 }
 
 //---------------------------------------------------------------------------------------
 void SceneNode::translate(const glm::vec3& amount) {
 	trans = glm::translate(amount) * trans;
+	mark_dirty();
 }
 
 
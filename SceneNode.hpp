@@ -3,6 +3,7 @@
 #pragma once
 
 #include "Material.hpp"
+#include "BoundingVolumes.hpp"
 
 #include <glm/glm.hpp>
 
@@ -30,23 +31,44 @@ public:
     const glm::mat4& get_inverse() const;
     
     void set_transform(const glm::mat4& m);
+
+    // Model-space transform (parent world * trans).  Cached, and only recomputed
+    // after this node or one of its ancestors has been marked dirty.
+    const glm::mat4& get_world_transform() const;
+
+    // Invalidate the cached world transform of this node and its whole subtree.
+    void mark_dirty();
     
     void add_child(SceneNode* child);
     
     void remove_child(SceneNode* child);
 
 	//-- Transformations:
-    void rotate(char axis, float angle);
-    void scale(const glm::vec3& amount);
-    void translate(const glm::vec3& amount);
+    virtual void rotate(char axis, float angle);
+    virtual void scale(const glm::vec3& amount);
+    virtual void translate(const glm::vec3& amount);
 
 	friend std::ostream & operator << (std::ostream & os, const SceneNode & node);
 
 	bool isSelected;
     
-    // Transformations
-    glm::mat4 trans;
+    // Transformations.  Subclasses that derive trans from other state set
+    // m_transDirty and rebuild it in rebuild_transform(), which get_transform() calls.
+    mutable glm::mat4 trans;
     glm::mat4 invtrans;
+    mutable bool m_transDirty;
+
+    // World transform cache.  Invariant: if a node is dirty, so are all of its
+    // descendants, which lets mark_dirty() stop at already-dirty subtrees.
+    mutable glm::mat4 m_worldTransform;
+    mutable bool m_worldDirty;
+
+    // World-space bounds of this node's subtree, refreshed by
+    // FlatSceneGraph::updateSubtreeBounds().
+    mutable BoundingSphere m_subtreeBounds;
+
+    // Number of world transforms recomputed since the counter was last reset.
+    static unsigned int worldRecomputeCount;
     
     std::list<SceneNode*> children;
     SceneNode* m_parent;
@@ -58,6 +80,9 @@ public:
     double current_angle_z;
 
 
+protected:
+	virtual void rebuild_transform() const;
+
 private:
 	// The number of SceneNode instances.
 	static unsigned int nodeInstanceCount;
@@ -0,0 +1,274 @@
+#include "SkinnedMesh.hpp"
+
+#include "GeometryNode.hpp"
+#include "MatrixKernels.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SKINNED_MESH_SSE 1
+#include <immintrin.h>
+#endif
+
+using namespace glm;
+using namespace std;
+
+namespace {
+
+const float WeightScale = 1.0f / 255.0f;
+
+// Sum of weight * palette matrix over the influences of v, then applied to the bind
+// position and normal.  Zero weights are not skipped, so every vertex costs the same.
+inline void skinVertexScalar(const mat4 * palette, const SkinnedVertex & v, float * position,
+		float * normal) {
+	float m[16] = {};
+	for (unsigned int i = 0; i < SkinnedMesh::MaxInfluences; ++i) {
+		const float w = float(v.weights[i]) * WeightScale;
+		const float * bone = &palette[v.bones[i]][0][0];
+		for (int k = 0; k < 16; ++k) {
+			m[k] += bone[k] * w;
+		}
+	}
+	for (int r = 0; r < 4; ++r) {
+		position[r] = m[r] * v.position.x + m[4 + r] * v.position.y + m[8 + r] * v.position.z
+			+ m[12 + r];
+		normal[r] = m[r] * v.normal.x + m[4 + r] * v.normal.y + m[8 + r] * v.normal.z;
+	}
+}
+
+void skinScalar(const mat4 * palette, const SkinnedVertex * vertices, vec4 * positions,
+		vec4 * normals, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		skinVertexScalar(palette, vertices[i], &positions[i][0], &normals[i][0]);
+	}
+}
+
+#if SKINNED_MESH_SSE
+
+// One column per register, so blending is four multiply-adds per influence.
+void skinSse(const mat4 * palette, const SkinnedVertex * vertices, vec4 * positions,
+		vec4 * normals, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		const SkinnedVertex & v = vertices[i];
+		__m128 c0 = _mm_setzero_ps();
+		__m128 c1 = _mm_setzero_ps();
+		__m128 c2 = _mm_setzero_ps();
+		__m128 c3 = _mm_setzero_ps();
+		for (unsigned int k = 0; k < SkinnedMesh::MaxInfluences; ++k) {
+			const __m128 w = _mm_set1_ps(float(v.weights[k]) * WeightScale);
+			const float * bone = &palette[v.bones[k]][0][0];
+			c0 = _mm_add_ps(c0, _mm_mul_ps(_mm_loadu_ps(bone), w));
+			c1 = _mm_add_ps(c1, _mm_mul_ps(_mm_loadu_ps(bone + 4), w));
+			c2 = _mm_add_ps(c2, _mm_mul_ps(_mm_loadu_ps(bone + 8), w));
+			c3 = _mm_add_ps(c3, _mm_mul_ps(_mm_loadu_ps(bone + 12), w));
+		}
+		__m128 normal = _mm_mul_ps(c0, _mm_set1_ps(v.normal.x));
+		normal = _mm_add_ps(normal, _mm_mul_ps(c1, _mm_set1_ps(v.normal.y)));
+		normal = _mm_add_ps(normal, _mm_mul_ps(c2, _mm_set1_ps(v.normal.z)));
+		__m128 position = _mm_mul_ps(c0, _mm_set1_ps(v.position.x));
+		position = _mm_add_ps(position, _mm_mul_ps(c1, _mm_set1_ps(v.position.y)));
+		position = _mm_add_ps(position, _mm_mul_ps(c2, _mm_set1_ps(v.position.z)));
+		position = _mm_add_ps(position, c3);
+		_mm_storeu_ps(&positions[i][0], position);
+		_mm_storeu_ps(&normals[i][0], normal);
+	}
+}
+
+#endif // SKINNED_MESH_SSE
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+bool SkinnedMesh::build(
+		const FlatSceneGraph & flatSceneGraph,
+		const std::unordered_map<std::string, SkinSource> & sources,
+		float blendFraction
+) {
+	clear();
+	const size_t numNodes = flatSceneGraph.size();
+	if (numNodes == 0) {
+		return false;
+	}
+	const vector<mat4> & world = flatSceneGraph.worldTransforms;
+
+	// Bone of every node: its nearest JointNode, itself included, or the root.
+	vector<unsigned int> boneOfNode(numNodes, 0);
+	boneNodes.push_back(0);
+	for (size_t i = 1; i < numNodes; ++i) {
+		if (flatSceneGraph.nodes[i]->m_nodeType == NodeType::JointNode) {
+			boneOfNode[i] = unsigned(boneNodes.size());
+			boneNodes.push_back(unsigned(i));
+		} else {
+			boneOfNode[i] = boneOfNode[flatSceneGraph.parentIndex[i]];
+		}
+	}
+	const size_t numBones = boneNodes.size();
+	if (numBones > 0xFFFF + 1) {
+		cerr << "SkinnedMesh: " << numBones << " joints do not fit 16-bit bone indices"
+			 << endl;
+		clear();
+		return false;
+	}
+
+	vector<unsigned int> parentBone(numBones, 0);
+	inverseBind.resize(numBones);
+	palette.assign(numBones, mat4());
+	for (unsigned int b = 0; b < numBones; ++b) {
+		inverseBind[b] = inverse(world[boneNodes[b]]);
+		if (b > 0) {
+			parentBone[b] = boneOfNode[flatSceneGraph.parentIndex[boneNodes[b]]];
+		}
+	}
+
+	// Bind pose bounds and blend radius of every part, for the blending pass below.
+	vector<unsigned int> partBone;
+	vector<vec3> partMin, partMax;
+	vector<float> partBlendRadius;
+	vector<size_t> partFirstVertex;
+
+	unordered_map<uint32_t, uint32_t> remap;
+	for (unsigned int i : flatSceneGraph.geometryIndices) {
+		const GeometryNode * geometryNode =
+				static_cast<const GeometryNode *>(flatSceneGraph.nodes[i]);
+		auto source = sources.find(geometryNode->meshId);
+		if (source == sources.end()) {
+			continue;
+		}
+		const SkinSource & mesh = source->second;
+		const uint32_t part = uint32_t(parts.size());
+		parts.push_back(i);
+
+		// Copy the part's vertices into the bind pose, each one once.
+		const mat4 & transform = world[i];
+		const mat3 normalMatrix = transpose(inverse(mat3(transform)));
+		const unsigned int bone = boneOfNode[i];
+		const size_t firstVertex = vertices.size();
+		remap.clear();
+		for (unsigned int k = 0; k < mesh.batchInfo.numIndices; ++k) {
+			const uint32_t index = mesh.indices[mesh.batchInfo.startIndex + k];
+			auto inserted = remap.emplace(index, uint32_t(vertices.size()));
+			if (inserted.second) {
+				const float * p = mesh.positions + 3 * size_t(index);
+				const float * n = mesh.normals + 3 * size_t(index);
+				SkinnedVertex vertex;
+				vertex.position = vec3(transform * vec4(p[0], p[1], p[2], 1.0f));
+				vertex.normal = normalize(normalMatrix * vec3(n[0], n[1], n[2]));
+				vertex.bones[0] = uint16_t(bone);
+				vertex.weights[0] = 255;
+				for (unsigned int j = 1; j < MaxInfluences; ++j) {
+					vertex.bones[j] = 0;
+					vertex.weights[j] = 0;
+				}
+				vertex.part = part;
+				vertices.push_back(vertex);
+			}
+			indices.push_back(inserted.first->second);
+		}
+
+		vec3 lower(FLT_MAX), upper(-FLT_MAX), centroid(0.0f);
+		for (size_t v = firstVertex; v < vertices.size(); ++v) {
+			lower = glm::min(lower, vertices[v].position);
+			upper = glm::max(upper, vertices[v].position);
+			centroid += vertices[v].position;
+		}
+		centroid /= float(std::max(vertices.size() - firstVertex, size_t(1)));
+		float radius = 0.0f;
+		for (size_t v = firstVertex; v < vertices.size(); ++v) {
+			radius = std::max(radius, length(vertices[v].position - centroid));
+		}
+		partBone.push_back(bone);
+		partMin.push_back(lower);
+		partMax.push_back(upper);
+		partBlendRadius.push_back(blendFraction * radius);
+		partFirstVertex.push_back(firstVertex);
+	}
+	partFirstVertex.push_back(vertices.size());
+
+	if (parts.empty()) {
+		clear();
+		return false;
+	}
+
+	// Rigid parts on neighbouring bones meet where a joint is.  Share each vertex with
+	// the bone of the nearest such part, half and half where they touch and smoothly
+	// back to its own bone at its part's blend radius.
+	for (size_t p = 0; p < parts.size(); ++p) {
+		const unsigned int bone = partBone[p];
+		const float blendRadius = partBlendRadius[p];
+		if (blendRadius <= 0.0f) {
+			continue;
+		}
+		vector<size_t> neighbours;
+		for (size_t q = 0; q < parts.size(); ++q) {
+			const unsigned int other = partBone[q];
+			if (other != bone && (parentBone[other] == bone
+					|| (bone != 0 && parentBone[bone] == other))) {
+				neighbours.push_back(q);
+			}
+		}
+		if (neighbours.empty()) {
+			continue;
+		}
+		for (size_t v = partFirstVertex[p]; v < partFirstVertex[p + 1]; ++v) {
+			SkinnedVertex & vertex = vertices[v];
+			float nearest = blendRadius;
+			int other = -1;
+			for (size_t q : neighbours) {
+				// Distance to the part's bounding box, 0 inside it.
+				vec3 outside = glm::max(glm::max(partMin[q] - vertex.position,
+						vertex.position - partMax[q]), vec3(0.0f));
+				float distance = length(outside);
+				if (distance < nearest) {
+					nearest = distance;
+					other = int(partBone[q]);
+				}
+			}
+			if (other < 0) {
+				continue;
+			}
+			const float t = 1.0f - nearest / blendRadius;
+			const uint8_t weight = uint8_t(lround(0.5f * t * t * (3.0f - 2.0f * t) * 255.0f));
+			vertex.bones[1] = uint16_t(other);
+			vertex.weights[0] = uint8_t(255 - weight);
+			vertex.weights[1] = weight;
+		}
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+void SkinnedMesh::clear() {
+	vertices.clear();
+	indices.clear();
+	boneNodes.clear();
+	inverseBind.clear();
+	palette.clear();
+	parts.clear();
+}
+
+//---------------------------------------------------------------------------------------
+void SkinnedMesh::updatePalette(const FlatSceneGraph & flatSceneGraph) {
+	const size_t numBones = boneNodes.size();
+	m_boneWorld.resize(numBones);
+	palette.resize(numBones);
+	for (size_t b = 0; b < numBones; ++b) {
+		m_boneWorld[b] = flatSceneGraph.worldTransforms[boneNodes[b]];
+	}
+	MatrixKernels::multiply(m_boneWorld.data(), inverseBind.data(), palette.data(), numBones);
+}
+
+//---------------------------------------------------------------------------------------
+void SkinnedMesh::skin(glm::vec4 * positions, glm::vec4 * normals) const {
+#if SKINNED_MESH_SSE
+	if (MatrixKernels::activeIsa() != MatrixKernels::Isa::Scalar) {
+		skinSse(palette.data(), vertices.data(), positions, normals, vertices.size());
+		return;
+	}
+#endif
+	skinScalar(palette.data(), vertices.data(), positions, normals, vertices.size());
+}
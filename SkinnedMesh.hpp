@@ -0,0 +1,76 @@
+#pragma once
+
+#include "cs488-framework/MeshConsolidator.hpp"
+
+#include "FlatSceneGraph.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One vertex of a SkinnedMesh, interleaved as uploaded to the GPU.
+struct SkinnedVertex {
+	glm::vec3 position;     // Bind pose, in the space of FlatSceneGraph::worldTransforms
+	glm::vec3 normal;
+	uint16_t bones[4];      // Indices into SkinnedMesh::palette
+	uint8_t weights[4];     // Normalized, summing to 255; unused influences are 0
+	uint32_t part;          // Index into SkinnedMesh::parts, for the part's material
+};
+
+// CPU copy of one mesh of a LoadedMesh, as read by SkinnedMesh::build().  batchInfo is
+// relative to indices, and indices to positions and normals.
+struct SkinSource {
+	const float * positions;
+	const float * normals;
+	const uint32_t * indices;
+	BatchInfo batchInfo;
+};
+
+// The GeometryNodes of a FlatSceneGraph baked into a single mesh skinned to its
+// JointNodes, so a whole puppet can be drawn with one call.  Bone 0 is the root, for
+// parts outside every joint; each JointNode adds one bone.  A vertex follows the bone
+// of its part's nearest JointNode, and close to a part on the parent or a child bone
+// it is blended with that bone, which closes the seams between rigid parts.
+class SkinnedMesh {
+public:
+	static const unsigned int MaxInfluences = 4;
+
+	// Rebuild from the current world transforms, which become the bind pose.  Vertices
+	// within blendFraction of their part's radius of a neighbouring part's bounds are
+	// blended; 0 binds every vertex rigidly to one bone.  Parts whose meshId is not in
+	// sources are left out.  Returns false if no part had a source.
+	bool build(const FlatSceneGraph & flatSceneGraph,
+			const std::unordered_map<std::string, SkinSource> & sources,
+			float blendFraction);
+	void clear();
+
+	// palette[b] = world[boneNodes[b]] * inverseBind[b], from the current world
+	// transforms of the same FlatSceneGraph.
+	void updatePalette(const FlatSceneGraph & flatSceneGraph);
+
+	// CPU fallback of the skinning vertex shader, with SSE when MatrixKernels has it.
+	// Writes the skinned position (w = 1) and unnormalized normal (w = 0) of every
+	// vertex.  Palette matrices stay rigid while only joints rotate, so normals use
+	// their upper 3x3 like the shader does.
+	void skin(glm::vec4 * positions, glm::vec4 * normals) const;
+
+	size_t numBones() const { return boneNodes.size(); }
+	size_t numVertices() const { return vertices.size(); }
+
+	std::vector<SkinnedVertex> vertices;
+	std::vector<uint32_t> indices;
+
+	// Parallel arrays, indexed by bone.
+	std::vector<unsigned int> boneNodes;      // Flat index of the root or JointNode
+	std::vector<glm::mat4> inverseBind;
+	std::vector<glm::mat4> palette;
+
+	// Flat index of the GeometryNode of each part.
+	std::vector<unsigned int> parts;
+
+private:
+	std::vector<glm::mat4> m_boneWorld;       // Scratch for updatePalette()
+};
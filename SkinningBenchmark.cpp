@@ -0,0 +1,219 @@
+#include "SkinningBenchmark.hpp"
+
+#include "cs488-framework/CS488Window.hpp"
+
+#include "BenchmarkTiming.hpp"
+#include "FlatSceneGraph.hpp"
+#include "GeometryNode.hpp"
+#include "JointNode.hpp"
+#include "MatrixKernels.hpp"
+#include "MeshLoader.hpp"
+#include "SkinnedMesh.hpp"
+#include "scene_lua.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace glm;
+using namespace std;
+
+namespace {
+
+// Same as Puppet::SkinBlendFraction.
+const float BlendFraction = 0.25f;
+
+// Largest allowed difference from the rigid parts, in float epsilons of the scene's
+// extent.  Skinning goes through the inverse bind matrices, the rigid parts do not.
+const double PositionTolerance = 256.0;
+const double NormalTolerance = 256.0;
+
+// Bytes of uniforms the rigid-part path uploads per draw: ModelView, NormalMatrix and
+// the material, see updateShaderUniforms() in puppet.cpp.
+const size_t RigidUniformBytes = sizeof(mat4) + sizeof(mat3) + 2 * sizeof(vec3)
+		+ sizeof(float);
+
+void reportRow(const char * path, unsigned int draws, size_t bytes, double seconds,
+		double positionError, double normalError) {
+	cout << left << setw(24) << path << right << setw(8) << draws << setw(14) << bytes
+		 << fixed << setw(12) << setprecision(2) << seconds * 1e6;
+	if (positionError < 0.0) {
+		cout << setw(12) << "-" << setw(12) << "-" << endl;
+	} else {
+		cout << setw(12) << positionError << setw(12) << normalError << endl;
+	}
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+int runSkinningBenchmark(const std::string & luaSceneFile, unsigned int repetitions) {
+	repetitions = max(repetitions, 1u);
+
+	unique_ptr<SceneNode> root(import_lua(luaSceneFile));
+	if (!root) {
+		cerr << "Could Not Open " << luaSceneFile << endl;
+		return 1;
+	}
+	FlatSceneGraph flatSceneGraph;
+	flatSceneGraph.build(root.get());
+
+	// Meshes are found the way Puppet::loadMeshes() finds them, and kept in memory.
+	MeshLoader meshLoader;
+	meshLoader.addSearchPaths(getenv("PUPPET_MESH_PATH"));
+	size_t slash = luaSceneFile.find_last_of('/');
+	meshLoader.addSearchPath(slash == string::npos ? "." : luaSceneFile.substr(0, slash));
+	meshLoader.addSearchPath(CS488Window::getAssetFilePath(""));
+	vector<unique_ptr<LoadedMesh>> meshes;
+	unordered_map<string, SkinSource> sources;
+	for (unsigned int i : flatSceneGraph.geometryIndices) {
+		const string & meshId = static_cast<const GeometryNode *>(flatSceneGraph.nodes[i])->meshId;
+		if (sources.find(meshId) != sources.end()) {
+			continue;
+		}
+		unique_ptr<LoadedMesh> mesh = meshLoader.load(meshId);
+		if (!mesh) {
+			cerr << "No mesh file found for meshId \"" << meshId << "\"" << endl;
+			return 1;
+		}
+		for (const auto & entry : mesh->batchInfoMap) {
+			sources[entry.first] = SkinSource{ mesh->positions, mesh->normals, mesh->indices,
+					entry.second };
+		}
+		meshes.push_back(move(mesh));
+	}
+
+	// Bound in the pose the scene was loaded in, as the application does.
+	SkinnedMesh rigid, blended;
+	if (!rigid.build(flatSceneGraph, sources, 0.0f)
+			|| !blended.build(flatSceneGraph, sources, BlendFraction)) {
+		cerr << luaSceneFile << " has no geometry to skin" << endl;
+		return 1;
+	}
+
+	// Turn every joint well away from the bind pose.
+	mt19937 random(488);
+	uniform_real_distribution<double> angle(-60.0, 60.0);
+	for (SceneNode * node : flatSceneGraph.nodes) {
+		if (node->m_nodeType == NodeType::JointNode) {
+			static_cast<JointNode *>(node)->set_angles(angle(random), angle(random));
+		}
+	}
+	flatSceneGraph.updateDirtyWorldTransforms();
+
+	// What the rigid parts draw: each part's mesh under its own world transform, in
+	// the vertex order SkinnedMesh::build() uses.
+	vector<vec3> rigidPositions, rigidNormals;
+	unordered_map<uint32_t, uint32_t> remap;
+	for (unsigned int node : rigid.parts) {
+		const SkinSource & mesh =
+				sources[static_cast<const GeometryNode *>(flatSceneGraph.nodes[node])->meshId];
+		const mat4 & transform = flatSceneGraph.worldTransforms[node];
+		const mat3 normalMatrix = transpose(inverse(mat3(transform)));
+		remap.clear();
+		for (unsigned int k = 0; k < mesh.batchInfo.numIndices; ++k) {
+			const uint32_t index = mesh.indices[mesh.batchInfo.startIndex + k];
+			if (remap.emplace(index, uint32_t(rigidPositions.size())).second) {
+				const float * p = mesh.positions + 3 * size_t(index);
+				const float * n = mesh.normals + 3 * size_t(index);
+				rigidPositions.push_back(vec3(transform * vec4(p[0], p[1], p[2], 1.0f)));
+				rigidNormals.push_back(normalize(normalMatrix * vec3(n[0], n[1], n[2])));
+			}
+		}
+	}
+	const size_t numVertices = rigid.numVertices();
+	float extent = 0.0f;
+	for (const vec3 & position : rigidPositions) {
+		extent = max(extent, max(abs(position.x), max(abs(position.y), abs(position.z))));
+	}
+
+	size_t numBlended = 0;
+	for (const SkinnedVertex & vertex : blended.vertices) {
+		numBlended += (vertex.weights[1] > 0) ? 1 : 0;
+	}
+	cout << luaSceneFile << ": " << numVertices << " vertices, " << rigid.indices.size() / 3
+		 << " triangles, " << rigid.parts.size() << " parts, " << rigid.numBones()
+		 << " bones, " << numBlended << " vertices blended across joints" << endl;
+	cout << "Per frame, best of " << repetitions << " repetition(s); errors against the "
+		 << "rigid parts in float epsilons" << endl;
+	cout << left << setw(24) << "path" << right << setw(8) << "draws" << setw(14)
+		 << "upload bytes" << setw(12) << "cpu us" << setw(12) << "position"
+		 << setw(12) << "normal" << endl;
+
+	// Rigid parts: a ModelView and normal matrix per node, then one draw and one set
+	// of uniforms per GeometryNode.
+	const size_t numNodes = flatSceneGraph.size();
+	const unsigned int numParts = unsigned(rigid.parts.size());
+	const mat4 view = glm::translate(vec3(0.0f, 0.0f, -10.0f));
+	vector<mat4> modelViews(numNodes);
+	vector<NormalMatrix> normalMatrices(numNodes);
+	double seconds = bestTime([&]() {
+		MatrixKernels::multiply(view, flatSceneGraph.worldTransforms.data(),
+				modelViews.data(), numNodes);
+		MatrixKernels::normalMatrices(modelViews.data(), normalMatrices.data(), numNodes);
+	}, repetitions);
+	reportRow("rigid parts", numParts, numParts * RigidUniformBytes, seconds, -1.0, -1.0);
+
+	// GPU skinning: the palette and part materials, the vertex shader does the rest.
+	seconds = bestTime([&]() {
+		blended.updatePalette(flatSceneGraph);
+	}, repetitions);
+	reportRow("GPU skinning", 1, blended.numBones() * sizeof(mat4) + numParts * 2 * sizeof(vec4),
+			seconds, -1.0, -1.0);
+
+	// CPU skinning: every vertex, then positions and normals streamed to the GPU.
+	const MatrixKernels::Isa detected = MatrixKernels::activeIsa();
+	const MatrixKernels::Isa isas[] = { MatrixKernels::Isa::Scalar, MatrixKernels::Isa::Sse };
+	vector<vec4> positions(numVertices), normals(numVertices);
+	bool allWithin = true;
+	for (MatrixKernels::Isa isa : isas) {
+		if (!MatrixKernels::setIsa(isa)) {
+			continue;
+		}
+		seconds = bestTime([&]() {
+			blended.updatePalette(flatSceneGraph);
+			blended.skin(positions.data(), normals.data());
+		}, repetitions);
+
+		// Checked with every vertex bound to one bone, where skinning must reproduce the
+		// rigid parts.
+		rigid.updatePalette(flatSceneGraph);
+		rigid.skin(positions.data(), normals.data());
+		double positionError = 0.0;
+		double normalError = 0.0;
+		for (size_t v = 0; v < numVertices; ++v) {
+			vec3 position = vec3(positions[v]) - rigidPositions[v];
+			vec3 normal = normalize(vec3(normals[v])) - rigidNormals[v];
+			positionError = max(positionError, double(max(abs(position.x),
+					max(abs(position.y), abs(position.z)))));
+			normalError = max(normalError, double(max(abs(normal.x),
+					max(abs(normal.y), abs(normal.z)))));
+		}
+		positionError /= max(extent, FLT_MIN) * FLT_EPSILON;
+		normalError /= FLT_EPSILON;
+		// Also catches non-finite results.
+		allWithin = allWithin && positionError <= PositionTolerance
+				&& normalError <= NormalTolerance;
+
+		string name = string("CPU skinning, ") + MatrixKernels::isaName(isa);
+		reportRow(name.c_str(), 1, numVertices * 2 * sizeof(vec4), seconds, positionError,
+				normalError);
+	}
+	MatrixKernels::setIsa(detected);
+
+	cout << "GPU skinning does the CPU skinning work per vertex in the vertex shader, "
+		 << "which this benchmark cannot time without a context" << endl;
+	cout << (allWithin ? "CPU skinning matches the rigid parts"
+			: "CPU skinning OUT OF TOLERANCE") << endl;
+	return allWithin ? 0 : 1;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+// Load a Lua scene and its meshes without a window, bake them into a SkinnedMesh and
+// pose every joint at random.  Compares the per-frame CPU work and uploads of the
+// rigid-part path (one draw per GeometryNode), GPU skinning (bone palette only) and
+// the CPU skinning fallback, scalar and SSE, best of repetitions.  The fallback is
+// checked against the rigid parts with every vertex bound to one bone.  Returns 0 if
+// it matched within tolerance, 1 otherwise.
+int runSkinningBenchmark(const std::string & luaSceneFile, unsigned int repetitions);
@@ -0,0 +1,176 @@
+#include "UndoHistory.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+bool sameJointAndAxis(const JointDelta & a, const JointDelta & b) {
+	return a.nodeId == b.nodeId && a.axisY == b.axisY;
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+UndoHistory::UndoHistory(size_t maxBytes)
+	: m_maxBytes(0),
+	  m_capacity(0),
+	  m_begin(0),
+	  m_end(0),
+	  m_cursor(0)
+{
+	setMaxBytes(maxBytes);
+}
+
+//---------------------------------------------------------------------------------------
+void UndoHistory::clear() {
+	m_ring.clear();
+	m_begin = 0;
+	m_end = 0;
+	m_entries.clear();
+	m_cursor = 0;
+}
+
+//---------------------------------------------------------------------------------------
+void UndoHistory::setMaxBytes(size_t maxBytes) {
+	if (maxBytes == m_maxBytes) {
+		return;
+	}
+
+	// Ring indices depend on the capacity, so copy the live deltas out oldest first and
+	// count positions from 0 again.
+	vector<JointDelta> live;
+	live.reserve(size_t(m_end - m_begin));
+	for (uint64_t p = m_begin; p < m_end; ++p) {
+		live.push_back(delta(p));
+	}
+	for (Entry & entry : m_entries) {
+		entry.begin -= m_begin;
+	}
+	m_end -= m_begin;
+	m_begin = 0;
+
+	m_maxBytes = maxBytes;
+	m_capacity = maxBytes / sizeof(JointDelta);
+	evictToFit(0, 0);
+
+	// Survivors are the newest deltas, at positions [m_begin, m_end) of live.
+	m_ring.assign(live.begin() + ptrdiff_t(m_begin), live.begin() + ptrdiff_t(m_end));
+	m_ring.shrink_to_fit();
+	for (Entry & entry : m_entries) {
+		entry.begin -= m_begin;
+	}
+	m_end -= m_begin;
+	m_begin = 0;
+}
+
+//---------------------------------------------------------------------------------------
+const JointDelta & UndoHistory::delta(uint64_t position) const {
+	return m_ring[size_t(position % m_capacity)];
+}
+
+//---------------------------------------------------------------------------------------
+JointDelta & UndoHistory::delta(uint64_t position) {
+	return m_ring[size_t(position % m_capacity)];
+}
+
+//---------------------------------------------------------------------------------------
+size_t UndoHistory::usedBytes() const {
+	return size_t(m_end - m_begin) * sizeof(JointDelta) + m_entries.size() * sizeof(Entry);
+}
+
+//---------------------------------------------------------------------------------------
+void UndoHistory::record(std::vector<JointDelta> & deltas, double time) {
+	deltas.erase(remove_if(deltas.begin(), deltas.end(), [](const JointDelta & d) {
+		return d.degrees == 0.0f;
+	}), deltas.end());
+	if (deltas.empty()) {
+		return;
+	}
+	sort(deltas.begin(), deltas.end(), [](const JointDelta & a, const JointDelta & b) {
+		return (a.nodeId != b.nodeId) ? a.nodeId < b.nodeId : a.axisY < b.axisY;
+	});
+
+	truncateRedo();
+
+	if (canCoalesce(deltas, time)) {
+		// Rotations about one axis add up, so the newest entry absorbs the edit.
+		Entry & entry = m_entries.back();
+		for (uint32_t i = 0; i < entry.count; ++i) {
+			delta(entry.begin + i).degrees += deltas[i].degrees;
+		}
+		entry.time = time;
+		return;
+	}
+
+	evictToFit(deltas.size(), 1);
+	if (deltas.size() > m_capacity
+			|| usedBytes() + deltas.size() * sizeof(JointDelta) + sizeof(Entry) > m_maxBytes) {
+		// Larger than the whole history.
+		return;
+	}
+
+	Entry entry;
+	entry.begin = m_end;
+	entry.count = uint32_t(deltas.size());
+	entry.time = time;
+	for (const JointDelta & d : deltas) {
+		// The ring only grows while positions have not wrapped yet.
+		size_t index = size_t(m_end % m_capacity);
+		if (index == m_ring.size()) {
+			m_ring.push_back(d);
+		} else {
+			m_ring[index] = d;
+		}
+		++m_end;
+	}
+	m_entries.push_back(entry);
+	m_cursor = m_entries.size();
+}
+
+//---------------------------------------------------------------------------------------
+bool UndoHistory::canCoalesce(const std::vector<JointDelta> & deltas, double time) const {
+	if (m_cursor == 0 || m_cursor != m_entries.size()) {
+		return false;
+	}
+	const Entry & entry = m_entries.back();
+	if (time - entry.time > CoalesceSeconds || entry.count != deltas.size()) {
+		return false;
+	}
+	for (uint32_t i = 0; i < entry.count; ++i) {
+		if (!sameJointAndAxis(delta(entry.begin + i), deltas[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+void UndoHistory::truncateRedo() {
+	if (m_cursor == m_entries.size()) {
+		return;
+	}
+	m_end = m_entries[m_cursor].begin;
+	m_entries.resize(m_cursor);
+}
+
+//---------------------------------------------------------------------------------------
+void UndoHistory::evictToFit(size_t extraDeltas, size_t extraEntries) {
+	auto fits = [&]() {
+		return size_t(m_end - m_begin) + extraDeltas <= m_capacity
+			&& usedBytes() + extraDeltas * sizeof(JointDelta) + extraEntries * sizeof(Entry)
+					<= m_maxBytes;
+	};
+	while (!m_entries.empty() && !fits()) {
+		if (m_cursor == 0) {
+			// Only redo entries are left, and they must be redone in order.
+			m_entries.clear();
+			m_end = m_begin;
+			break;
+		}
+		m_entries.pop_front();
+		--m_cursor;
+		m_begin = m_entries.empty() ? m_end : m_entries.front().begin;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Rotation of one joint about one axis, in degrees.  8 bytes.
+struct JointDelta {
+	uint32_t nodeId : 31;
+	uint32_t axisY : 1;     // Set for 'y', clear for 'z'
+	float degrees;
+
+	char axis() const { return axisY ? 'y' : 'z'; }
+};
+
+// Undo/redo history of joint edits.  Each entry is a run of JointDeltas in one ring
+// buffer, so the history never holds more than its memory limit; the oldest entries
+// are dropped to make room.  Applying an entry reads its deltas in place.
+class UndoHistory {
+public:
+	static const size_t DefaultMaxBytes = 256 * 1024;
+
+	// Edits on the same joints and axes that follow each other within this many
+	// seconds become one entry.
+	static constexpr double CoalesceSeconds = 1.0;
+
+	explicit UndoHistory(size_t maxBytes = DefaultMaxBytes);
+
+	void clear();
+
+	// Drops the oldest entries if the history no longer fits.
+	void setMaxBytes(size_t maxBytes);
+	size_t maxBytes() const { return m_maxBytes; }
+
+	// Record an edit made at time (seconds, any monotonic clock) and drop every entry
+	// that could be redone.  Zero deltas are ignored, and so is an edit without any
+	// other.  Sorts deltas.
+	void record(std::vector<JointDelta> & deltas, double time);
+
+	// Call apply(delta, sign) for each delta of the entry to undo or redo, with sign -1
+	// when undoing.  Undo visits the deltas in reverse order.  Returns false if there
+	// is nothing to undo or redo.
+	template <class Apply> bool undo(Apply apply);
+	template <class Apply> bool redo(Apply apply);
+
+	size_t numUndo() const { return m_cursor; }
+	size_t numRedo() const { return m_entries.size() - m_cursor; }
+
+	// Bytes of deltas and entry records currently held.
+	size_t usedBytes() const;
+
+private:
+	struct Entry {
+		uint64_t begin;      // Position of the first delta, counted from the first ever
+		uint32_t count;
+		double time;         // Of the last edit coalesced into this entry
+	};
+
+	const JointDelta & delta(uint64_t position) const;
+	JointDelta & delta(uint64_t position);
+	bool canCoalesce(const std::vector<JointDelta> & deltas, double time) const;
+	void truncateRedo();
+	void evictToFit(size_t extraDeltas, size_t extraEntries);
+
+	size_t m_maxBytes;
+	size_t m_capacity;                // Deltas that fit in the ring
+	std::vector<JointDelta> m_ring;   // Grows up to m_capacity, then wraps
+	uint64_t m_begin;                 // Oldest delta still referenced
+	uint64_t m_end;                   // One past the newest delta
+	std::deque<Entry> m_entries;      // Oldest first
+	size_t m_cursor;                  // Entries before it can be undone, after it redone
+};
+
+//---------------------------------------------------------------------------------------
+template <class Apply>
+bool UndoHistory::undo(Apply apply) {
+	if (m_cursor == 0) {
+		return false;
+	}
+	const Entry & entry = m_entries[--m_cursor];
+	for (uint64_t p = entry.begin + entry.count; p-- > entry.begin;) {
+		apply(delta(p), -1.0f);
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+template <class Apply>
+bool UndoHistory::redo(Apply apply) {
+	if (m_cursor == m_entries.size()) {
+		return false;
+	}
+	const Entry & entry = m_entries[m_cursor++];
+	for (uint64_t p = entry.begin; p < entry.begin + entry.count; ++p) {
+		apply(delta(p), 1.0f);
+	}
+	return true;
+}
@@ -0,0 +1,122 @@
+#include "UniformBinding.hpp"
+
+#include "cs488-framework/GlErrorCheck.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+using namespace glm;
+
+unsigned int Uniforms::lookupCount = 0;
+unsigned int Uniforms::uploadCount = 0;
+
+//---------------------------------------------------------------------------------------
+MeshShaderUniforms::MeshShaderUniforms()
+	: perspective(-1),
+	  modelView(-1),
+	  normalMatrix(-1),
+	  lightPosition(-1),
+	  lightRgbIntensity(-1),
+	  ambientIntensity(-1),
+	  materialKd(-1),
+	  materialKs(-1),
+	  materialShininess(-1),
+	  octNormalScale(-1)
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+void MeshShaderUniforms::resolve(const ShaderProgram & shader) {
+	perspective = Uniforms::lookup(shader, "Perspective");
+	modelView = Uniforms::lookup(shader, "ModelView");
+	normalMatrix = Uniforms::lookup(shader, "NormalMatrix");
+	lightPosition = Uniforms::lookup(shader, "light.position");
+	lightRgbIntensity = Uniforms::lookup(shader, "light.rgbIntensity");
+	ambientIntensity = Uniforms::lookup(shader, "ambientIntensity");
+	materialKd = Uniforms::lookup(shader, "material.kd");
+	materialKs = Uniforms::lookup(shader, "material.ks");
+	materialShininess = Uniforms::lookup(shader, "material.shininess");
+	octNormalScale = Uniforms::lookup(shader, "octNormalScale");
+}
+
+//---------------------------------------------------------------------------------------
+IdShaderUniforms::IdShaderUniforms()
+	: perspective(-1),
+	  modelView(-1),
+	  nodeId(-1)
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+void IdShaderUniforms::resolve(const ShaderProgram & shader) {
+	perspective = Uniforms::lookup(shader, "Perspective");
+	modelView = Uniforms::lookup(shader, "ModelView");
+	nodeId = Uniforms::lookup(shader, "nodeId");
+}
+
+//---------------------------------------------------------------------------------------
+ArcShaderUniforms::ArcShaderUniforms()
+	: M(-1)
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+void ArcShaderUniforms::resolve(const ShaderProgram & shader) {
+	M = Uniforms::lookup(shader, "M");
+}
+
+//---------------------------------------------------------------------------------------
+GLint Uniforms::lookup(const ShaderProgram & shader, const char * name) {
+	++lookupCount;
+	return shader.getUniformLocation(name);
+}
+
+//---------------------------------------------------------------------------------------
+void Uniforms::set(GLint location, const glm::mat4 & value) {
+	++uploadCount;
+	glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(value));
+	CHECK_GL_ERRORS;
+}
+
+//---------------------------------------------------------------------------------------
+void Uniforms::set(GLint location, const glm::mat3 & value) {
+	++uploadCount;
+	glUniformMatrix3fv(location, 1, GL_FALSE, value_ptr(value));
+	CHECK_GL_ERRORS;
+}
+
+//---------------------------------------------------------------------------------------
+void Uniforms::set(GLint location, const glm::vec3 & value) {
+	++uploadCount;
+	glUniform3fv(location, 1, value_ptr(value));
+	CHECK_GL_ERRORS;
+}
+
+//---------------------------------------------------------------------------------------
+void Uniforms::set(GLint location, float value) {
+	++uploadCount;
+	glUniform1f(location, value);
+	CHECK_GL_ERRORS;
+}
+
+//---------------------------------------------------------------------------------------
+void Uniforms::set(GLint location, int value) {
+	++uploadCount;
+	glUniform1i(location, value);
+	CHECK_GL_ERRORS;
+}
+
+//---------------------------------------------------------------------------------------
+void Uniforms::set(GLint location, unsigned int value) {
+	++uploadCount;
+	glUniform1ui(location, value);
+	CHECK_GL_ERRORS;
+}
+
+//---------------------------------------------------------------------------------------
+void Uniforms::resetCounters() {
+	lookupCount = 0;
+	uploadCount = 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "cs488-framework/OpenGLImport.hpp"
+#include "cs488-framework/ShaderProgram.hpp"
+
+#include <glm/glm.hpp>
+
+// Uniform locations of the mesh shader (VertexShader.vs / FragmentShader.fs).  They
+// are resolved once after ShaderProgram::link() (and again after a reload), so the
+// render loop never looks a uniform up by name.
+struct MeshShaderUniforms {
+	GLint perspective;
+	GLint modelView;
+	GLint normalMatrix;
+	GLint lightPosition;
+	GLint lightRgbIntensity;
+	GLint ambientIntensity;
+	GLint materialKd;
+	GLint materialKs;
+	GLint materialShininess;
+	GLint octNormalScale;
+
+	MeshShaderUniforms();
+	void resolve(const ShaderProgram & shader);
+};
+
+// Uniform locations of the ID pass shader (IdVertexShader.vs / IdFragmentShader.fs).
+struct IdShaderUniforms {
+	GLint perspective;
+	GLint modelView;
+	GLint nodeId;
+
+	IdShaderUniforms();
+	void resolve(const ShaderProgram & shader);
+};
+
+// Uniform locations of the trackball circle shader.
+struct ArcShaderUniforms {
+	GLint M;
+
+	ArcShaderUniforms();
+	void resolve(const ShaderProgram & shader);
+};
+
+// Thin wrappers around glUniform* that count calls, so the cost of the uniform path
+// can be reported per frame.
+namespace Uniforms {
+	GLint lookup(const ShaderProgram & shader, const char * name);
+
+	void set(GLint location, const glm::mat4 & value);
+	void set(GLint location, const glm::mat3 & value);
+	void set(GLint location, const glm::vec3 & value);
+	void set(GLint location, float value);
+	void set(GLint location, int value);
+	void set(GLint location, unsigned int value);
+
+	// Call counters, reset by the application once per frame.
+	extern unsigned int lookupCount;
+	extern unsigned int uploadCount;
+	void resetCounters();
+}
@@ -0,0 +1,213 @@
+#include "VertexCompression.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace glm;
+using namespace std;
+
+namespace {
+
+inline float signNotZero(float v) {
+	return (v >= 0.0f) ? 1.0f : -1.0f;
+}
+
+inline uint16_t quantizeUnorm16(float value, float min, float extent) {
+	float t = (value - min) / extent;
+	t = std::min(std::max(t, 0.0f), 1.0f);
+	return uint16_t(std::floor(t * 65535.0f + 0.5f));
+}
+
+inline int maxComponent(int bits) {
+	return (1 << (bits - 1)) - 1;
+}
+
+// Shortest angle between two vectors, in degrees.  atan2 stays accurate for the tiny
+// angles quantization produces, where acos of a dot product would not.
+float angleDegrees(const vec3 & a, const vec3 & b) {
+	return float(degrees(atan2(length(cross(a, b)), dot(a, b))));
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------
+glm::mat4 QuantizationBounds::dequantization() const {
+	return glm::scale(glm::translate(mat4(), min), extent);
+}
+
+//---------------------------------------------------------------------------------------
+size_t VertexCompression::vertexSize(VertexFormat format) {
+	switch (format) {
+	case VERTEX_COMPACT16:
+		return sizeof(CompactVertex16);
+	case VERTEX_COMPACT8:
+		return sizeof(CompactVertex8);
+	default:
+		return 6 * sizeof(float);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+float VertexCompression::octNormalScale(VertexFormat format) {
+	switch (format) {
+	case VERTEX_COMPACT16:
+		return 1.0f / maxComponent(16);
+	case VERTEX_COMPACT8:
+		return 1.0f / maxComponent(8);
+	default:
+		return 0.0f;
+	}
+}
+
+//---------------------------------------------------------------------------------------
+QuantizationBounds VertexCompression::computeBounds(const float * positions,
+		size_t numVertices) {
+	vec3 lo(0.0f), hi(0.0f);
+	if (numVertices > 0) {
+		lo = hi = vec3(positions[0], positions[1], positions[2]);
+	}
+	for (size_t i = 1; i < numVertices; ++i) {
+		vec3 p(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+
+	QuantizationBounds bounds;
+	bounds.min = lo;
+	bounds.extent = hi - lo;
+	for (int c = 0; c < 3; ++c) {
+		if (bounds.extent[c] <= 0.0f) {
+			bounds.extent[c] = 1.0f;
+		}
+	}
+	return bounds;
+}
+
+//---------------------------------------------------------------------------------------
+void VertexCompression::encode(
+		VertexFormat format,
+		const float * positions,
+		const float * normals,
+		size_t numVertices,
+		const QuantizationBounds & bounds,
+		void * destination
+) {
+	const int bits = (format == VERTEX_COMPACT16) ? 16 : 8;
+
+	for (size_t i = 0; i < numVertices; ++i) {
+		uint16_t position[3];
+		for (int c = 0; c < 3; ++c) {
+			position[c] = quantizeUnorm16(positions[3 * i + c], bounds.min[c], bounds.extent[c]);
+		}
+		int x, y;
+		octEncode(vec3(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]), bits, x, y);
+
+		if (format == VERTEX_COMPACT16) {
+			CompactVertex16 & vertex = static_cast<CompactVertex16 *>(destination)[i];
+			copy(position, position + 3, vertex.position);
+			vertex.padding = 0;
+			vertex.normal[0] = int16_t(x);
+			vertex.normal[1] = int16_t(y);
+		} else {
+			CompactVertex8 & vertex = static_cast<CompactVertex8 *>(destination)[i];
+			copy(position, position + 3, vertex.position);
+			vertex.normal[0] = int8_t(x);
+			vertex.normal[1] = int8_t(y);
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void VertexCompression::octEncode(const glm::vec3 & n, int bits, int & x, int & y) {
+	const int maxValue = maxComponent(bits);
+
+	float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (l1 == 0.0f) {
+		// Degenerate normal, anything will do.
+		x = y = 0;
+		return;
+	}
+
+	vec3 v = n / l1;
+	vec2 e(v.x, v.y);
+	if (v.z < 0.0f) {
+		e = vec2((1.0f - std::abs(v.y)) * signNotZero(v.x),
+				(1.0f - std::abs(v.x)) * signNotZero(v.y));
+	}
+
+	const vec3 target = normalize(n);
+	float bestError = -1.0f;
+	const int baseX = int(std::floor(e.x * maxValue));
+	const int baseY = int(std::floor(e.y * maxValue));
+	for (int dy = 0; dy <= 1; ++dy) {
+		for (int dx = 0; dx <= 1; ++dx) {
+			int cx = std::min(std::max(baseX + dx, -maxValue), maxValue);
+			int cy = std::min(std::max(baseY + dy, -maxValue), maxValue);
+			vec3 decoded = octDecode(float(cx) / maxValue, float(cy) / maxValue);
+			float error = 1.0f - dot(decoded, target);
+			if (bestError < 0.0f || error < bestError) {
+				bestError = error;
+				x = cx;
+				y = cy;
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+glm::vec3 VertexCompression::octDecode(float x, float y) {
+	// Must match decodeNormal() in the vertex shaders.
+	vec3 v(x, y, 1.0f - std::abs(x) - std::abs(y));
+	if (v.z < 0.0f) {
+		float vx = v.x;
+		v.x = (1.0f - std::abs(v.y)) * signNotZero(vx);
+		v.y = (1.0f - std::abs(vx)) * signNotZero(v.y);
+	}
+	return normalize(v);
+}
+
+//---------------------------------------------------------------------------------------
+QuantizationError VertexCompression::measureError(
+		VertexFormat format,
+		const float * positions,
+		const float * normals,
+		size_t numVertices
+) {
+	QuantizationError result;
+	result.maxPositionError = 0.0f;
+	result.maxNormalErrorDegrees = 0.0f;
+
+	const QuantizationBounds bounds = computeBounds(positions, numVertices);
+	result.boundsDiagonal = length(bounds.extent);
+	if (format == VERTEX_FLOAT32) {
+		return result;
+	}
+
+	const int bits = (format == VERTEX_COMPACT16) ? 16 : 8;
+	const float scale = octNormalScale(format);
+	const mat4 dequantization = bounds.dequantization();
+
+	for (size_t i = 0; i < numVertices; ++i) {
+		vec3 p(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+		vec3 q;
+		for (int c = 0; c < 3; ++c) {
+			q[c] = quantizeUnorm16(p[c], bounds.min[c], bounds.extent[c]) / 65535.0f;
+		}
+		vec3 decodedPosition = vec3(dequantization * vec4(q, 1.0f));
+		result.maxPositionError = std::max(result.maxPositionError,
+				length(decodedPosition - p));
+
+		vec3 n(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]);
+		if (n == vec3(0.0f)) {
+			continue;
+		}
+		int x, y;
+		octEncode(n, bits, x, y);
+		vec3 decodedNormal = octDecode(x * scale, y * scale);
+		result.maxNormalErrorDegrees = std::max(result.maxNormalErrorDegrees,
+				angleDegrees(decodedNormal, normalize(n)));
+	}
+	return result;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+// Layout of the mesh vertex buffers.
+enum VertexFormat {
+	VERTEX_FLOAT32,     // Separate 3 x float position and normal streams, 24 bytes
+	VERTEX_COMPACT16,   // Interleaved CompactVertex16, 12 bytes
+	VERTEX_COMPACT8     // Interleaved CompactVertex8, 8 bytes
+};
+
+// Positions are 16-bit unsigned normalized coordinates inside the mesh's bounding box.
+// Normals are octahedral-encoded and stored as plain signed integers, which the vertex
+// shader scales back by 1 / (2^(bits-1) - 1) before decoding.
+struct CompactVertex16 {
+	uint16_t position[3];
+	uint16_t padding;     // Keeps the normal 4-byte aligned
+	int16_t normal[2];
+};
+
+struct CompactVertex8 {
+	uint16_t position[3];
+	int8_t normal[2];
+};
+
+// Bounding box a mesh's positions are quantized against.
+struct QuantizationBounds {
+	glm::vec3 min;
+	glm::vec3 extent;     // Never zero, so flat meshes still dequantize
+
+	// Maps [0, 1]^3 back onto the box.  Folded into the ModelView matrix, so dequantizing
+	// positions costs the vertex shader nothing.
+	glm::mat4 dequantization() const;
+};
+
+// Largest error introduced by a compact format over one mesh.
+struct QuantizationError {
+	float maxPositionError;      // Model-space units
+	float boundsDiagonal;        // For scale
+	float maxNormalErrorDegrees;
+};
+
+class VertexCompression {
+public:
+	static size_t vertexSize(VertexFormat format);
+
+	// Scale the shaders apply to stored normal components, 0 for float normals.
+	static float octNormalScale(VertexFormat format);
+
+	static QuantizationBounds computeBounds(const float * positions, size_t numVertices);
+
+	// Write numVertices vertices of a compact format to destination, which must hold
+	// numVertices * vertexSize(format) bytes.
+	static void encode(VertexFormat format, const float * positions, const float * normals,
+			size_t numVertices, const QuantizationBounds & bounds, void * destination);
+
+	// Octahedral encoding onto [-1, 1]^2, rounded to the integer grid of bits-bit signed
+	// components.  Of the four neighbouring grid points, picks the one that decodes
+	// closest to n.
+	static void octEncode(const glm::vec3 & n, int bits, int & x, int & y);
+	static glm::vec3 octDecode(float x, float y);
+
+	// Encode and decode every vertex exactly as the GPU would, and report the worst
+	// position and normal error.
+	static QuantizationError measureError(VertexFormat format, const float * positions,
+			const float * normals, size_t numVertices);
+};
@@ -0,0 +1,74 @@
+#include "VertexQuantizationReport.hpp"
+
+#include "cs488-framework/CS488Window.hpp"
+
+#include "MeshOptimizer.hpp"
+#include "ObjFastDecoder.hpp"
+#include "VertexCompression.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+using namespace glm;
+using namespace std;
+
+//---------------------------------------------------------------------------------------
+int runQuantizationErrorReport(const std::vector<std::string> & objFiles) {
+	vector<string> files = objFiles;
+	if (files.empty()) {
+		files.push_back(CS488Window::getAssetFilePath("cube.obj"));
+		files.push_back(CS488Window::getAssetFilePath("sphere.obj"));
+		files.push_back(CS488Window::getAssetFilePath("suzanne.obj"));
+	}
+
+	const VertexFormat formats[] = { VERTEX_FLOAT32, VERTEX_COMPACT16, VERTEX_COMPACT8 };
+	const char * formatNames[] = { "float32", "compact16", "compact8" };
+
+	cout << left << setw(28) << "mesh" << setw(11) << "format" << right
+		 << setw(10) << "vertices"
+		 << setw(8) << "bytes"
+		 << setw(12) << "memory KB"
+		 << setw(14) << "max pos err"
+		 << setw(12) << "% of diag"
+		 << setw(14) << "max nrm err" << endl;
+
+	int result = 0;
+	for (const string & path : files) {
+		string objectName;
+		vector<vec3> positions, normals;
+		try {
+			ObjFastDecoder::decode(path.c_str(), objectName, positions, normals);
+		} catch (const std::exception & error) {
+			cerr << error.what() << endl;
+			result = 1;
+			continue;
+		}
+
+		// Report on what is actually uploaded: the welded vertices.
+		IndexedMesh mesh;
+		MeshOptimizer::weldVertices(reinterpret_cast<const float *>(positions.data()),
+				reinterpret_cast<const float *>(normals.data()), positions.size(), mesh);
+		const float * weldedPositions = reinterpret_cast<const float *>(mesh.positions.data());
+		const float * weldedNormals = reinterpret_cast<const float *>(mesh.normals.data());
+		const size_t numVertices = mesh.positions.size();
+
+		for (int f = 0; f < 3; ++f) {
+			QuantizationError error = VertexCompression::measureError(formats[f],
+					weldedPositions, weldedNormals, numVertices);
+			size_t vertexSize = VertexCompression::vertexSize(formats[f]);
+
+			cout << left << setw(28) << (f == 0 ? objectName : "") << setw(11) << formatNames[f]
+				 << right << setw(10) << numVertices
+				 << setw(8) << vertexSize
+				 << setw(12) << fixed << setprecision(1)
+				 << double(numVertices * vertexSize) / 1024.0
+				 << setw(14) << scientific << setprecision(2) << error.maxPositionError
+				 << setw(11) << fixed << setprecision(4)
+				 << 100.0f * error.maxPositionError / error.boundsDiagonal << "%"
+				 << setw(10) << setprecision(3) << error.maxNormalErrorDegrees << " deg"
+				 << endl;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// For each .obj file and each compact VertexFormat, print the vertex memory of the
+// welded mesh and the largest position and normal error quantization introduces.
+// With no files, reports on the meshes in Assets/.  Returns 0 unless a file could not
+// be decoded.
+int runQuantizationErrorReport(const std::vector<std::string> & objFiles);
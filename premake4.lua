@@ -31,6 +31,7 @@ if os.get() == "linux" then
         "glfw3",
         "lua",
         "GL",
+        "EGL",
         "Xinerama",
         "Xcursor",
         "Xxf86vm",
@@ -53,6 +54,15 @@ buildOptions = {"-std=c++14"}
 solution "CS488-Projects"
     configurations { "Debug", "Release" }
 
+    -- Shared by every project below.
+    configuration "Debug"
+        defines { "DEBUG" }
+        flags { "Symbols" }
+
+    configuration "Release"
+        defines { "NDEBUG" }
+        flags { "Optimize" }
+
     project "A3"
         kind "ConsoleApp"
         language "C++"
@@ -65,11 +75,19 @@ solution "CS488-Projects"
         linkoptions (linkOptionList)
         includedirs (includeDirList)
         files { "*.cpp" }
+        excludes { "BenchmarkMain.cpp" }
 
-    configuration "Debug"
-        defines { "DEBUG" }
-        flags { "Symbols" }
-
-    configuration "Release"
-        defines { "NDEBUG" }
-        flags { "Optimize" }
+    -- Scene-graph microbenchmarks, the same sources with their own main().
+    project "A3Bench"
+        kind "ConsoleApp"
+        language "C++"
+        location "build"
+        objdir "build/bench"
+        targetdir "."
+        buildoptions (buildOptions)
+        libdirs (libDirectories)
+        links (linkLibs)
+        linkoptions (linkOptionList)
+        includedirs (includeDirList)
+        files { "*.cpp" }
+        excludes { "Main.cpp" }
@@ -8,6 +8,7 @@ using namespace std;
 #include "cs488-framework/MathUtils.hpp"
 #include "GeometryNode.hpp"
 #include "JointNode.hpp"
+#include "RenderJobs.hpp"
 
 #include <imgui/imgui.h>
 
@@ -15,30 +16,74 @@ using namespace std;
 #include <glm/gtx/io.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <cerrno>
+#include <cstring>
+
+#include <sys/stat.h>
+
 using namespace glm;
 
 static bool show_gui = true;
-static bool do_picking = false;
 
 const size_t CIRCLE_PTS = 48;
-// forward decl
-glm::vec3 mapToSphere(float x, float y, float diameter);
+
+// Byte offset of a mesh's first index in m_ibo_indices, as glDrawElements expects it.
+static const void * indexBufferOffset(const BatchInfo & batchInfo) {
+	return reinterpret_cast<const void *>(size_t(batchInfo.startIndex) * sizeof(GLuint));
+}
 //----------------------------------------------------------------------------------------
 // Constructor
 Puppet::Puppet(const std::string & luaSceneFile)
-	: m_luaSceneFile(luaSceneFile),
-	  m_positionAttribLocation(0),
-	  m_normalAttribLocation(0),
-	  m_vao_meshData(0),
+	: m_vao_meshData(0),
 	  m_vbo_vertexPositions(0),
 	  m_vbo_vertexNormals(0),
-	  m_vao_arcCircle(0),
+	  m_vbo_vertexCompact(0),
+	  m_ibo_indices(0),
+	  m_positionAttribLocation(0),
+	  m_normalAttribLocation(0),
+	  m_vao_instanced(0),
+	  m_vbo_instanceData(0),
+	  m_inst_positionAttribLocation(0),
+	  m_inst_normalAttribLocation(0),
+	  m_inst_modelViewAttribLocation(0),
+	  m_inst_normalMatrixAttribLocation(0),
+	  m_inst_kdAttribLocation(0),
+	  m_inst_ksAttribLocation(0),
+	  m_inst_shininessAttribLocation(0),
+	  m_supportsIndirect(false),
+	  m_indirectCommandsDirty(true),
+	  m_vao_indirect(0),
+	  m_vbo_drawIndex(0),
+	  m_ssbo_drawData(0),
+	  m_buffer_indirectCommands(0),
+	  m_indirect_positionAttribLocation(0),
+	  m_indirect_normalAttribLocation(0),
+	  m_indirect_drawIndexAttribLocation(0),
+	  m_vao_skinned(0),
+	  m_vbo_skinnedVertices(0),
+	  m_ibo_skinnedIndices(0),
+	  m_tbo_bonePalette(0),
+	  m_tex_bonePalette(0),
+	  m_tbo_materialPalette(0),
+	  m_tex_materialPalette(0),
+	  m_skin_positionAttribLocation(0),
+	  m_skin_normalAttribLocation(0),
+	  m_skin_bonesAttribLocation(0),
+	  m_skin_weightsAttribLocation(0),
+	  m_skin_partAttribLocation(0),
 	  m_vbo_arcCircle(0),
-	  interactionMode(InteractionMode::POSITION),
+	  m_vao_arcCircle(0),
+	  m_vao_marquee(0),
+	  m_vbo_marquee(0),
+	  m_vao_id(0),
+	  m_id_positionAttribLocation(0),
+	  m_luaSceneFile(luaSceneFile),
+	  m_frameCount(0),
 	  option_circle(false),
       option_zbuffer(true),  
       option_backface(false),
-      option_frontface(false)
+      option_frontface(false),
+	  interactionMode(InteractionMode::POSITION)
 {
 
 }
@@ -47,7 +92,7 @@ Puppet::Puppet(const std::string & luaSceneFile)
 // Destructor
 Puppet::~Puppet()
 {
-	idToInitialNodeInfo.clear();
+
 }
 
 //----------------------------------------------------------------------------------------
@@ -59,32 +104,35 @@ void Puppet::init()
 	// Set the background colour.
 	glClearColor(0.85, 0.85, 0.85, 1.0);
 
+	// Multi-draw indirect and shader storage buffers are core since GL 4.3.
+	GLint majorVersion = 0, minorVersion = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+	glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+	m_supportsIndirect = majorVersion > 4 || (majorVersion == 4 && minorVersion >= 3);
+
 	createShaderProgram();
 
 	glGenVertexArrays(1, &m_vao_arcCircle);
+	glGenVertexArrays(1, &m_vao_marquee);
 	glGenVertexArrays(1, &m_vao_meshData);
+	glGenVertexArrays(1, &m_vao_id);
+	glGenVertexArrays(1, &m_vao_instanced);
+	glGenVertexArrays(1, &m_vao_skinned);
+	if (m_supportsIndirect) {
+		glGenVertexArrays(1, &m_vao_indirect);
+	}
 	enableVertexShaderInputSlots();
 
 	processLuaSceneFile(m_luaSceneFile);
 
-	// Load and decode all .obj files at once here.  You may add additional .obj files to
-	// this list in order to support rendering additional mesh types.  All vertex
-	// positions, and normals will be extracted and stored within the MeshConsolidator
-	// class.
-	unique_ptr<MeshConsolidator> meshConsolidator (new MeshConsolidator{
-			getAssetFilePath("cube.obj"),
-			getAssetFilePath("sphere.obj"),
-			getAssetFilePath("suzanne.obj")
-	});
-
+	m_flatSceneGraph.build(m_rootNode.get());
+	m_jointTable.build(m_flatSceneGraph);
+	m_restPose.capture(m_jointTable);
+	m_clip.reset(m_jointTable.size());
 
-	// Acquire the BatchInfoMap from the MeshConsolidator.
-	meshConsolidator->getBatchInfoMap(m_batchInfoMap);
+	createStreamingBuffers();
 
-	// Take all vertex data within the MeshConsolidator and upload it to VBOs on the GPU.
-	uploadVertexDataToVbos(*meshConsolidator);
-
-	mapVboDataToVertexShaderInputLocations();
+	loadSceneMeshes();
 
 	initPerspectiveMatrix();
 
@@ -92,15 +140,179 @@ void Puppet::init()
 
 	initLightSources();
 
-	initNodeInfo(m_rootNode.get());
+	// Stored poses live next to the scene they were made for.
+	m_poseFile = m_luaSceneFile + ".poses";
+	if (m_poseLibrary.load(m_poseFile, m_jointTable, m_restPose)) {
+		cout << "Loaded " << m_poseLibrary.size() << " poses from " << m_poseFile << endl;
+	}
 
 	resetAll();
+}
 
+//----------------------------------------------------------------------------------------
+// Upload all vertex data to VBOs on the GPU, give every mesh a handle, and rebuild
+// everything that holds mesh handles or batch ranges.
+void Puppet::loadSceneMeshes()
+{
+	BatchInfoMap batchInfoMap;
+	unordered_map<string, mat4> positionTransforms;
+	unordered_map<string, BoundingSphere> meshBounds;
+	LodBatchMap lodBatchMap;
+	loadMeshes(batchInfoMap, positionTransforms, meshBounds, lodBatchMap);
+	if (!m_meshRegistry) {
+		m_meshRegistry = std::make_shared<MeshRegistry>();
+	}
+	m_meshRegistry->addMeshes(batchInfoMap);
+	for (const auto & entry : positionTransforms) {
+		m_meshRegistry->setPositionTransform(m_meshRegistry->findHandle(entry.first),
+				entry.second);
+	}
+	for (const auto & entry : meshBounds) {
+		m_meshRegistry->setBounds(m_meshRegistry->findHandle(entry.first), entry.second);
+	}
+	for (const auto & entry : batchInfoMap) {
+		auto lods = lodBatchMap.find(entry.first);
+		m_meshRegistry->setLods(m_meshRegistry->findHandle(entry.first),
+				(lods == lodBatchMap.end()) ? vector<LodBatch>() : lods->second);
+	}
+
+	// Fails loudly on meshIds that were never loaded.
+	m_meshRegistry->resolve(m_rootNode.get());
+
+	for (unsigned int i : m_flatSceneGraph.geometryIndices) {
+		const GeometryNode * geometryNode =
+				static_cast<const GeometryNode *>(m_flatSceneGraph.nodes[i]);
+		m_flatSceneGraph.setMeshBounds(i, m_meshRegistry->meshBounds(geometryNode->meshHandle));
+		geometryNode->lodLevel = 0;
+	}
+
+	buildInstanceBatches();
+	m_drawList.build(m_flatSceneGraph, *m_meshRegistry);
+	m_pickingBvh.build(m_flatSceneGraph);
+
+	mapVboDataToVertexShaderInputLocations();
+}
+
+//----------------------------------------------------------------------------------------
+// Re-upload every mesh, e.g. after vertexFormat changed.  Meshes come from their caches,
+// so this is quick.
+void Puppet::reloadMeshes()
+{
+	GLuint buffers[] = { m_vbo_vertexPositions, m_vbo_vertexNormals, m_vbo_vertexCompact,
+			m_ibo_indices };
+	glDeleteBuffers(4, buffers);
+	m_vbo_vertexPositions = 0;
+	m_vbo_vertexNormals = 0;
+	m_vbo_vertexCompact = 0;
+	m_ibo_indices = 0;
+	CHECK_GL_ERRORS;
 
-	// Exiting the current scope calls delete automatically on meshConsolidator freeing
-	// all vertex data resources.  This is fine since we already copied this data to
-	// VBOs on the GPU.  We have no use for storing vertex data on the CPU side beyond
-	// this point.
+	loadSceneMeshes();
+}
+
+//----------------------------------------------------------------------------------------
+// Load and upload the vertex data of just the meshes the scene references.  Every
+// referenced meshId is looked up as '<meshId>.obj' in the directories listed in
+// PUPPET_MESH_PATH, then next to the Lua scene file, then in Assets/.  Each .obj is read
+// from its memory-mapped binary cache when that is up to date, and decoded (and the
+// cache rewritten) otherwise.
+void Puppet::loadMeshes(
+		BatchInfoMap & batchInfoMap,
+		std::unordered_map<std::string, glm::mat4> & positionTransforms,
+		std::unordered_map<std::string, BoundingSphere> & meshBounds,
+		LodBatchMap & lodBatchMap
+) {
+	auto start = chrono::high_resolution_clock::now();
+
+	MeshLoader meshLoader;
+	meshLoader.addSearchPaths(getenv("PUPPET_MESH_PATH"));
+	size_t slash = m_luaSceneFile.find_last_of('/');
+	meshLoader.addSearchPath(slash == string::npos ? "." : m_luaSceneFile.substr(0, slash));
+	meshLoader.addSearchPath(getAssetFilePath(""));
+
+	// Distinct meshIds, in scene order.
+	vector<string> meshIds;
+	for (unsigned int i : m_flatSceneGraph.geometryIndices) {
+		const GeometryNode * geometryNode =
+				static_cast<const GeometryNode *>(m_flatSceneGraph.nodes[i]);
+		if (find(meshIds.begin(), meshIds.end(), geometryNode->meshId) == meshIds.end()) {
+			meshIds.push_back(geometryNode->meshId);
+		}
+	}
+
+	m_pickingBvh.clearMeshes();
+
+	vector<unique_ptr<LoadedMesh>> meshes;
+	unordered_map<string, SkinSource> skinSources;
+	vector<QuantizationBounds> bounds;
+	size_t numVertices = 0;
+	size_t numIndices = 0;
+	unsigned int numFromCache = 0;
+	for (const string & meshId : meshIds) {
+		// A single .obj may hold several meshes.
+		if (batchInfoMap.find(meshId) != batchInfoMap.end()) {
+			continue;
+		}
+
+		unique_ptr<LoadedMesh> mesh = meshLoader.load(meshId);
+		if (!mesh) {
+			// Left for MeshRegistry::resolve() to report along with any others.
+			cerr << "No mesh file found for meshId \"" << meshId << "\"" << endl;
+			continue;
+		}
+
+		// Compact formats store positions relative to the bounds of their file.
+		bounds.push_back(VertexCompression::computeBounds(mesh->positions, mesh->numVertices));
+		mat4 positionTransform = (vertexFormat == VERTEX_FLOAT32) ? mat4()
+				: bounds.back().dequantization();
+
+		// Meshes are packed into the buffers back to back, so shift each batch by the
+		// indices that precede this file.
+		for (const auto & entry : mesh->batchInfoMap) {
+			BatchInfo batchInfo = entry.second;
+			m_pickingBvh.addMesh(entry.first, mesh->positions, mesh->numVertices,
+					mesh->indices + batchInfo.startIndex, batchInfo.numIndices);
+			skinSources[entry.first] = SkinSource{ mesh->positions, mesh->normals,
+					mesh->indices, batchInfo };
+			batchInfo.startIndex += unsigned(numIndices);
+			batchInfoMap[entry.first] = batchInfo;
+			positionTransforms[entry.first] = positionTransform;
+			meshBounds[entry.first] = BoundingSphere::fromIndexedPoints(mesh->positions,
+					mesh->indices + entry.second.startIndex, entry.second.numIndices);
+		}
+		for (const auto & entry : mesh->lodBatchMap) {
+			vector<LodBatch> & lods = lodBatchMap[entry.first];
+			lods = entry.second;
+			for (LodBatch & lod : lods) {
+				lod.batchInfo.startIndex += unsigned(numIndices);
+			}
+		}
+
+		numVertices += mesh->numVertices;
+		numIndices += mesh->numIndices;
+		numFromCache += mesh->fromCache ? 1 : 0;
+		meshes.push_back(move(mesh));
+	}
+
+	uploadVertexDataToVbos(meshes, bounds, numVertices, numIndices);
+
+	// The skinned mesh is baked from the same CPU data, bound in the pose the scene is
+	// in now.
+	m_flatSceneGraph.updateDirtyWorldTransforms();
+	m_skinnedMesh.build(m_flatSceneGraph, skinSources, SkinBlendFraction);
+	uploadSkinnedMesh();
+
+	// Exiting the current scope releases the vertex data of every LoadedMesh.  This is
+	// fine since we already copied this data to VBOs on the GPU.
+
+	auto end = chrono::high_resolution_clock::now();
+	cout << "Loaded " << meshes.size() << " mesh file(s) (" << numFromCache
+		 << " from cache) in " << chrono::duration<double, milli>(end - start).count()
+		 << " ms:";
+	for (const auto & mesh : meshes) {
+		cout << " " << mesh->path;
+	}
+	cout << endl;
 }
 
 //----------------------------------------------------------------------------------------
@@ -119,6 +331,16 @@ void Puppet::processLuaSceneFile(const std::string & filename) {
 	}
 }
 
+//----------------------------------------------------------------------------------------
+// Texture units of the skinning shader's palettes, set once per link.
+static void bindSkinningSamplers(const ShaderProgram & shader)
+{
+	shader.enable();
+	Uniforms::set(Uniforms::lookup(shader, "bonePalette"), 0);
+	Uniforms::set(Uniforms::lookup(shader, "materialPalette"), 1);
+	shader.disable();
+}
+
 //----------------------------------------------------------------------------------------
 void Puppet::createShaderProgram()
 {
@@ -131,6 +353,61 @@ void Puppet::createShaderProgram()
 	m_shader_arcCircle.attachVertexShader( getAssetFilePath("arc_VertexShader.vs").c_str() );
 	m_shader_arcCircle.attachFragmentShader( getAssetFilePath("arc_FragmentShader.fs").c_str() );
 	m_shader_arcCircle.link();
+
+	m_shader_id.generateProgramObject();
+	m_shader_id.attachVertexShader( getAssetFilePath("IdVertexShader.vs").c_str() );
+	m_shader_id.attachFragmentShader( getAssetFilePath("IdFragmentShader.fs").c_str() );
+	m_shader_id.link();
+
+	m_shader_instanced.generateProgramObject();
+	m_shader_instanced.attachVertexShader( getAssetFilePath("InstancedVertexShader.vs").c_str() );
+	m_shader_instanced.attachFragmentShader( getAssetFilePath("InstancedFragmentShader.fs").c_str() );
+	m_shader_instanced.link();
+
+	// Shares the fragment stage with the instanced path.
+	m_shader_skinned.generateProgramObject();
+	m_shader_skinned.attachVertexShader( getAssetFilePath("SkinnedVertexShader.vs").c_str() );
+	m_shader_skinned.attachFragmentShader( getAssetFilePath("InstancedFragmentShader.fs").c_str() );
+	m_shader_skinned.link();
+	bindSkinningSamplers(m_shader_skinned);
+
+	if (m_supportsIndirect) {
+		// Shares the fragment stage with the instanced path.
+		m_shader_indirect.generateProgramObject();
+		m_shader_indirect.attachVertexShader( getAssetFilePath("IndirectVertexShader.vs").c_str() );
+		m_shader_indirect.attachFragmentShader( getAssetFilePath("InstancedFragmentShader.fs").c_str() );
+		m_shader_indirect.link();
+		m_indirectUniforms.resolve(m_shader_indirect);
+	}
+
+	m_meshUniforms.resolve(m_shader);
+	m_instancedUniforms.resolve(m_shader_instanced);
+	m_skinnedUniforms.resolve(m_shader_skinned);
+	m_arcUniforms.resolve(m_shader_arcCircle);
+	m_idUniforms.resolve(m_shader_id);
+}
+
+//----------------------------------------------------------------------------------------
+void Puppet::reloadShaders()
+{
+	m_shader.recompileShaders();
+	m_shader_instanced.recompileShaders();
+	m_shader_skinned.recompileShaders();
+	m_shader_arcCircle.recompileShaders();
+	m_shader_id.recompileShaders();
+
+	// Locations may change after relinking.
+	m_meshUniforms.resolve(m_shader);
+	m_instancedUniforms.resolve(m_shader_instanced);
+	m_skinnedUniforms.resolve(m_shader_skinned);
+	bindSkinningSamplers(m_shader_skinned);
+	m_arcUniforms.resolve(m_shader_arcCircle);
+	m_idUniforms.resolve(m_shader_id);
+
+	if (m_supportsIndirect) {
+		m_shader_indirect.recompileShaders();
+		m_indirectUniforms.resolve(m_shader_indirect);
+	}
 }
 
 //----------------------------------------------------------------------------------------
@@ -151,6 +428,76 @@ void Puppet::enableVertexShaderInputSlots()
 		CHECK_GL_ERRORS;
 	}
 
+	//-- Enable input slots for m_vao_id, which only needs positions:
+	{
+		glBindVertexArray(m_vao_id);
+
+		m_id_positionAttribLocation = m_shader_id.getAttribLocation("position");
+		glEnableVertexAttribArray(m_id_positionAttribLocation);
+
+		CHECK_GL_ERRORS;
+	}
+
+	//-- Enable input slots for m_vao_instanced:
+	{
+		glBindVertexArray(m_vao_instanced);
+
+		m_inst_positionAttribLocation = m_shader_instanced.getAttribLocation("position");
+		glEnableVertexAttribArray(m_inst_positionAttribLocation);
+		m_inst_normalAttribLocation = m_shader_instanced.getAttribLocation("normal");
+		glEnableVertexAttribArray(m_inst_normalAttribLocation);
+
+		// Matrix attributes occupy one location per column.
+		m_inst_modelViewAttribLocation = m_shader_instanced.getAttribLocation("instanceModelView");
+		for (int i = 0; i < 4; ++i) {
+			glEnableVertexAttribArray(m_inst_modelViewAttribLocation + i);
+		}
+		m_inst_normalMatrixAttribLocation = m_shader_instanced.getAttribLocation("instanceNormalMatrix");
+		for (int i = 0; i < 3; ++i) {
+			glEnableVertexAttribArray(m_inst_normalMatrixAttribLocation + i);
+		}
+		m_inst_kdAttribLocation = m_shader_instanced.getAttribLocation("instanceKd");
+		glEnableVertexAttribArray(m_inst_kdAttribLocation);
+		m_inst_ksAttribLocation = m_shader_instanced.getAttribLocation("instanceKs");
+		glEnableVertexAttribArray(m_inst_ksAttribLocation);
+		m_inst_shininessAttribLocation = m_shader_instanced.getAttribLocation("instanceShininess");
+		glEnableVertexAttribArray(m_inst_shininessAttribLocation);
+
+		CHECK_GL_ERRORS;
+	}
+
+	//-- Enable input slots for m_vao_skinned:
+	{
+		glBindVertexArray(m_vao_skinned);
+
+		m_skin_positionAttribLocation = m_shader_skinned.getAttribLocation("position");
+		glEnableVertexAttribArray(m_skin_positionAttribLocation);
+		m_skin_normalAttribLocation = m_shader_skinned.getAttribLocation("normal");
+		glEnableVertexAttribArray(m_skin_normalAttribLocation);
+		m_skin_bonesAttribLocation = m_shader_skinned.getAttribLocation("bones");
+		glEnableVertexAttribArray(m_skin_bonesAttribLocation);
+		m_skin_weightsAttribLocation = m_shader_skinned.getAttribLocation("weights");
+		glEnableVertexAttribArray(m_skin_weightsAttribLocation);
+		m_skin_partAttribLocation = m_shader_skinned.getAttribLocation("part");
+		glEnableVertexAttribArray(m_skin_partAttribLocation);
+
+		CHECK_GL_ERRORS;
+	}
+
+	//-- Enable input slots for m_vao_indirect:
+	if (m_supportsIndirect) {
+		glBindVertexArray(m_vao_indirect);
+
+		m_indirect_positionAttribLocation = m_shader_indirect.getAttribLocation("position");
+		glEnableVertexAttribArray(m_indirect_positionAttribLocation);
+		m_indirect_normalAttribLocation = m_shader_indirect.getAttribLocation("normal");
+		glEnableVertexAttribArray(m_indirect_normalAttribLocation);
+		m_indirect_drawIndexAttribLocation = m_shader_indirect.getAttribLocation("drawIndex");
+		glEnableVertexAttribArray(m_indirect_drawIndexAttribLocation);
+
+		CHECK_GL_ERRORS;
+	}
+
 
 	//-- Enable input slots for m_vao_arcCircle:
 	{
@@ -163,40 +510,196 @@ void Puppet::enableVertexShaderInputSlots()
 		CHECK_GL_ERRORS;
 	}
 
+	//-- Enable input slots for m_vao_marquee, drawn with the trackball circle shader:
+	{
+		glBindVertexArray(m_vao_marquee);
+		glEnableVertexAttribArray(m_arc_positionAttribLocation);
+
+		CHECK_GL_ERRORS;
+	}
+
 	// Restore defaults
 	glBindVertexArray(0);
 }
 
 //----------------------------------------------------------------------------------------
 void Puppet::uploadVertexDataToVbos (
-		const MeshConsolidator & meshConsolidator
+		const std::vector<std::unique_ptr<LoadedMesh>> & meshes,
+		const std::vector<QuantizationBounds> & bounds,
+		size_t numVertices,
+		size_t numIndices
 ) {
+	const size_t numBytes = numVertices * 3 * sizeof(float);
+	vertex_buffer_bytes = numVertices * VertexCompression::vertexSize(vertexFormat);
+
 	// Generate VBO to store all vertex position data
-	{
+	if (vertexFormat == VERTEX_FLOAT32) {
 		glGenBuffers(1, &m_vbo_vertexPositions);
 
 		glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexPositions);
 
-		glBufferData(GL_ARRAY_BUFFER, meshConsolidator.getNumVertexPositionBytes(),
-				meshConsolidator.getVertexPositionDataPtr(), GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, numBytes, nullptr, GL_STATIC_DRAW);
+		size_t offset = 0;
+		for (const auto & mesh : meshes) {
+			size_t meshBytes = mesh->numVertices * 3 * sizeof(float);
+			glBufferSubData(GL_ARRAY_BUFFER, offset, meshBytes, mesh->positions);
+			offset += meshBytes;
+		}
 
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		CHECK_GL_ERRORS;
 	}
 
 	// Generate VBO to store all vertex normal data
-	{
+	if (vertexFormat == VERTEX_FLOAT32) {
 		glGenBuffers(1, &m_vbo_vertexNormals);
 
 		glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexNormals);
 
-		glBufferData(GL_ARRAY_BUFFER, meshConsolidator.getNumVertexNormalBytes(),
-				meshConsolidator.getVertexNormalDataPtr(), GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, numBytes, nullptr, GL_STATIC_DRAW);
+		size_t offset = 0;
+		for (const auto & mesh : meshes) {
+			size_t meshBytes = mesh->numVertices * 3 * sizeof(float);
+			glBufferSubData(GL_ARRAY_BUFFER, offset, meshBytes, mesh->normals);
+			offset += meshBytes;
+		}
 
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		CHECK_GL_ERRORS;
 	}
 
+	// Generate VBO to store compact interleaved vertices, encoded straight into the
+	// mapped buffer.
+	if (vertexFormat != VERTEX_FLOAT32) {
+		glGenBuffers(1, &m_vbo_vertexCompact);
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexCompact);
+
+		glBufferData(GL_ARRAY_BUFFER, vertex_buffer_bytes, nullptr, GL_STATIC_DRAW);
+		if (vertex_buffer_bytes > 0) {
+			char * vertices = static_cast<char *>(glMapBufferRange(GL_ARRAY_BUFFER, 0,
+					vertex_buffer_bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+			for (size_t i = 0; i < meshes.size(); ++i) {
+				VertexCompression::encode(vertexFormat, meshes[i]->positions, meshes[i]->normals,
+						meshes[i]->numVertices, bounds[i], vertices);
+				vertices += meshes[i]->numVertices * VertexCompression::vertexSize(vertexFormat);
+			}
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		CHECK_GL_ERRORS;
+	}
+
+	// Generate the index buffer.  Each mesh's indices are relative to its own vertices,
+	// so they are rebased while copying to keep every BatchInfo a plain index range.
+	// Bound through the copy target, since the element array binding belongs to
+	// whichever VAO is bound.
+	{
+		glGenBuffers(1, &m_ibo_indices);
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo_indices);
+
+		glBufferData(GL_COPY_WRITE_BUFFER, numIndices * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+		if (numIndices > 0) {
+			GLuint * indices = static_cast<GLuint *>(glMapBufferRange(GL_COPY_WRITE_BUFFER,
+					0, numIndices * sizeof(GLuint),
+					GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+			GLuint baseVertex = 0;
+			for (const auto & mesh : meshes) {
+				for (size_t i = 0; i < mesh->numIndices; ++i) {
+					*indices++ = mesh->indices[i] + baseVertex;
+				}
+				baseVertex += GLuint(mesh->numVertices);
+			}
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		}
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		CHECK_GL_ERRORS;
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// Upload m_skinnedMesh's interleaved vertices and indices, and point m_vao_skinned at
+// them.  The buffers are created on first use and respecified on every reload.
+void Puppet::uploadSkinnedMesh()
+{
+	if (m_vbo_skinnedVertices == 0) {
+		glGenBuffers(1, &m_vbo_skinnedVertices);
+		glGenBuffers(1, &m_ibo_skinnedIndices);
+	}
+
+	glBindVertexArray(m_vao_skinned);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_skinnedVertices);
+	glBufferData(GL_ARRAY_BUFFER, m_skinnedMesh.vertices.size() * sizeof(SkinnedVertex),
+			m_skinnedMesh.vertices.data(), GL_STATIC_DRAW);
+
+	const GLsizei stride = sizeof(SkinnedVertex);
+	glVertexAttribPointer(m_skin_positionAttribLocation, 3, GL_FLOAT, GL_FALSE, stride,
+			reinterpret_cast<void *>(offsetof(SkinnedVertex, position)));
+	glVertexAttribPointer(m_skin_normalAttribLocation, 3, GL_FLOAT, GL_FALSE, stride,
+			reinterpret_cast<void *>(offsetof(SkinnedVertex, normal)));
+	glVertexAttribIPointer(m_skin_bonesAttribLocation, 4, GL_UNSIGNED_SHORT, stride,
+			reinterpret_cast<void *>(offsetof(SkinnedVertex, bones)));
+	glVertexAttribPointer(m_skin_weightsAttribLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+			reinterpret_cast<void *>(offsetof(SkinnedVertex, weights)));
+	glVertexAttribIPointer(m_skin_partAttribLocation, 1, GL_UNSIGNED_INT, stride,
+			reinterpret_cast<void *>(offsetof(SkinnedVertex, part)));
+
+	// The element array binding is recorded in the VAO, so it stays bound.
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo_skinnedIndices);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_skinnedMesh.indices.size() * sizeof(GLuint),
+			m_skinnedMesh.indices.data(), GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	CHECK_GL_ERRORS;
+}
+
+//----------------------------------------------------------------------------------------
+// Buffers that do not depend on the loaded meshes, created once.
+void Puppet::createStreamingBuffers()
+{
+	// Generate VBO for per-instance data.  Its contents are streamed every frame by
+	// renderInstancedSceneGraph().
+	{
+		glGenBuffers(1, &m_vbo_instanceData);
+		CHECK_GL_ERRORS;
+	}
+
+	// Buffers for the indirect path, filled by buildIndirectCommands() and
+	// renderIndirectSceneGraph().
+	if (m_supportsIndirect) {
+		glGenBuffers(1, &m_vbo_drawIndex);
+		glGenBuffers(1, &m_ssbo_drawData);
+		glGenBuffers(1, &m_buffer_indirectCommands);
+		CHECK_GL_ERRORS;
+	}
+
+	// Texture buffers for the skinned mesh's bone palette and part materials, streamed
+	// by renderSkinnedMesh().
+	{
+		glGenBuffers(1, &m_tbo_bonePalette);
+		glGenBuffers(1, &m_tbo_materialPalette);
+		glGenTextures(1, &m_tex_bonePalette);
+		glGenTextures(1, &m_tex_materialPalette);
+
+		glBindBuffer(GL_TEXTURE_BUFFER, m_tbo_bonePalette);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(mat4), nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, m_tbo_materialPalette);
+		glBufferData(GL_TEXTURE_BUFFER, 2 * sizeof(vec4), nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		glBindTexture(GL_TEXTURE_BUFFER, m_tex_bonePalette);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_tbo_bonePalette);
+		glBindTexture(GL_TEXTURE_BUFFER, m_tex_materialPalette);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_tbo_materialPalette);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		CHECK_GL_ERRORS;
+	}
+
 	// Generate VBO to store the trackball circle.
 	{
 		glGenBuffers( 1, &m_vbo_arcCircle );
@@ -214,6 +717,16 @@ void Puppet::uploadVertexDataToVbos (
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		CHECK_GL_ERRORS;
 	}
+
+	// Generate VBO for the four corners of the selection rectangle, rewritten while
+	// dragging.
+	{
+		glGenBuffers(1, &m_vbo_marquee);
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo_marquee);
+		glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		CHECK_GL_ERRORS;
+	}
 }
 
 //----------------------------------------------------------------------------------------
@@ -222,15 +735,7 @@ void Puppet::mapVboDataToVertexShaderInputLocations()
 	// Bind VAO in order to record the data mapping.
 	glBindVertexArray(m_vao_meshData);
 
-	// Tell GL how to map data from the vertex buffer "m_vbo_vertexPositions" into the
-	// "position" vertex attribute location for any bound vertex shader program.
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexPositions);
-	glVertexAttribPointer(m_positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-	// Tell GL how to map data from the vertex buffer "m_vbo_vertexNormals" into the
-	// "normal" vertex attribute location for any bound vertex shader program.
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexNormals);
-	glVertexAttribPointer(m_normalAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+	mapMeshVertexAttributes(m_positionAttribLocation, m_normalAttribLocation);
 
 	//-- Unbind target, and restore default values:
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -238,6 +743,53 @@ void Puppet::mapVboDataToVertexShaderInputLocations()
 
 	CHECK_GL_ERRORS;
 
+	// The instanced VAO reads the same vertex data, plus one InstanceData record per
+	// instance from m_vbo_instanceData.
+	glBindVertexArray(m_vao_instanced);
+
+	mapMeshVertexAttributes(m_inst_positionAttribLocation, m_inst_normalAttribLocation);
+
+	for (int i = 0; i < 4; ++i) {
+		glVertexAttribDivisor(m_inst_modelViewAttribLocation + i, 1);
+	}
+	for (int i = 0; i < 3; ++i) {
+		glVertexAttribDivisor(m_inst_normalMatrixAttribLocation + i, 1);
+	}
+	glVertexAttribDivisor(m_inst_kdAttribLocation, 1);
+	glVertexAttribDivisor(m_inst_ksAttribLocation, 1);
+	glVertexAttribDivisor(m_inst_shininessAttribLocation, 1);
+	mapInstanceDataToVertexShaderInputLocations(0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	CHECK_GL_ERRORS;
+
+	// The indirect VAO only adds the per-instance draw index; everything else about a
+	// draw is read from the storage buffer.
+	if (m_supportsIndirect) {
+		glBindVertexArray(m_vao_indirect);
+
+		mapMeshVertexAttributes(m_indirect_positionAttribLocation,
+				m_indirect_normalAttribLocation);
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo_drawIndex);
+		glVertexAttribIPointer(m_indirect_drawIndexAttribLocation, 1, GL_UNSIGNED_INT, 0, nullptr);
+		glVertexAttribDivisor(m_indirect_drawIndexAttribLocation, 1);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+
+		CHECK_GL_ERRORS;
+	}
+
+	// The ID pass reads positions only.
+	glBindVertexArray(m_vao_id);
+	mapMeshVertexAttributes(m_id_positionAttribLocation, -1);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	CHECK_GL_ERRORS;
+
 	// Bind VAO in order to record the data mapping.
 	glBindVertexArray(m_vao_arcCircle);
 
@@ -246,6 +798,10 @@ void Puppet::mapVboDataToVertexShaderInputLocations()
 	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_arcCircle);
 	glVertexAttribPointer(m_arc_positionAttribLocation, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
 
+	glBindVertexArray(m_vao_marquee);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_marquee);
+	glVertexAttribPointer(m_arc_positionAttribLocation, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
 	//-- Unbind target, and restore default values:
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
@@ -253,6 +809,152 @@ void Puppet::mapVboDataToVertexShaderInputLocations()
 	CHECK_GL_ERRORS;
 }
 
+//----------------------------------------------------------------------------------------
+// Point a VAO's position and normal attributes at the mesh vertex data in vertexFormat,
+// and record the index buffer in it.  A negative normalAttribLocation skips normals.
+// Expects the VAO to be bound.
+void Puppet::mapMeshVertexAttributes(GLint positionAttribLocation, GLint normalAttribLocation)
+{
+	if (vertexFormat == VERTEX_FLOAT32) {
+		// Tell GL how to map data from the vertex buffer "m_vbo_vertexPositions" into the
+		// "position" vertex attribute location for any bound vertex shader program.
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexPositions);
+		glVertexAttribPointer(positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+		// Tell GL how to map data from the vertex buffer "m_vbo_vertexNormals" into the
+		// "normal" vertex attribute location for any bound vertex shader program.
+		if (normalAttribLocation >= 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexNormals);
+			glVertexAttribPointer(normalAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+		}
+	} else {
+		// Positions are normalized to [0, 1]; the two octahedral normal components stay
+		// integers, scaled by the octNormalScale uniform.  The missing third component
+		// of "normal" reads as 0.
+		const GLsizei stride = GLsizei(VertexCompression::vertexSize(vertexFormat));
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexCompact);
+		glVertexAttribPointer(positionAttribLocation, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+				reinterpret_cast<void *>(offsetof(CompactVertex16, position)));
+		if (normalAttribLocation < 0) {
+			// Positions only.
+		} else if (vertexFormat == VERTEX_COMPACT16) {
+			glVertexAttribPointer(normalAttribLocation, 2, GL_SHORT, GL_FALSE, stride,
+					reinterpret_cast<void *>(offsetof(CompactVertex16, normal)));
+		} else {
+			glVertexAttribPointer(normalAttribLocation, 2, GL_BYTE, GL_FALSE, stride,
+					reinterpret_cast<void *>(offsetof(CompactVertex8, normal)));
+		}
+	}
+
+	// The element array binding is recorded in the VAO, so it stays bound.
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo_indices);
+
+	CHECK_GL_ERRORS;
+}
+
+//----------------------------------------------------------------------------------------
+// Point the per-instance attributes of m_vao_instanced at the InstanceData record
+// firstInstance.  GL 3.3 has no base-instance draw, so each instanced batch re-points
+// these attributes before drawing.  Expects m_vao_instanced to be bound.
+void Puppet::mapInstanceDataToVertexShaderInputLocations(size_t firstInstance)
+{
+	const GLsizei stride = sizeof(InstanceData);
+	const size_t base = firstInstance * sizeof(InstanceData);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_instanceData);
+	for (int i = 0; i < 4; ++i) {
+		glVertexAttribPointer(m_inst_modelViewAttribLocation + i, 4, GL_FLOAT, GL_FALSE, stride,
+				reinterpret_cast<void *>(base + offsetof(InstanceData, modelView) + i * sizeof(vec4)));
+	}
+	for (int i = 0; i < 3; ++i) {
+		glVertexAttribPointer(m_inst_normalMatrixAttribLocation + i, 3, GL_FLOAT, GL_FALSE, stride,
+				reinterpret_cast<void *>(base + offsetof(InstanceData, normalMatrix) + i * sizeof(vec4)));
+	}
+	glVertexAttribPointer(m_inst_kdAttribLocation, 3, GL_FLOAT, GL_FALSE, stride,
+			reinterpret_cast<void *>(base + offsetof(InstanceData, kd)));
+	glVertexAttribPointer(m_inst_ksAttribLocation, 3, GL_FLOAT, GL_FALSE, stride,
+			reinterpret_cast<void *>(base + offsetof(InstanceData, ks)));
+	glVertexAttribPointer(m_inst_shininessAttribLocation, 1, GL_FLOAT, GL_FALSE, stride,
+			reinterpret_cast<void *>(base + offsetof(InstanceData, ks) + 3 * sizeof(float)));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	CHECK_GL_ERRORS;
+}
+
+//----------------------------------------------------------------------------------------
+// Group the GeometryNodes of m_flatSceneGraph by mesh handle.  Must be re-run whenever
+// the scene structure or m_meshRegistry changes.
+void Puppet::buildInstanceBatches()
+{
+	m_instanceBatches.clear();
+
+	// Batch index per mesh handle, -1 until the mesh is first seen.
+	vector<int> batchIndexByMesh(m_meshRegistry->size(), -1);
+	for (unsigned int i : m_flatSceneGraph.geometryIndices) {
+		const GeometryNode * geometryNode =
+				static_cast<const GeometryNode *>(m_flatSceneGraph.nodes[i]);
+
+		int & batchIndex = batchIndexByMesh[geometryNode->meshHandle];
+		if (batchIndex < 0) {
+			batchIndex = int(m_instanceBatches.size());
+			m_instanceBatches.push_back(InstanceBatch());
+			m_instanceBatches.back().meshHandle = geometryNode->meshHandle;
+			m_instanceBatches.back().batchInfo = m_meshRegistry->batchInfo(geometryNode->meshHandle);
+		}
+		m_instanceBatches[batchIndex].flatIndices.push_back(i);
+	}
+
+	m_instanceData.reserve(m_flatSceneGraph.geometryIndices.size());
+	m_indirectCommandsDirty = true;
+}
+
+//----------------------------------------------------------------------------------------
+// One indirect command per InstanceBatch and level of detail.  baseInstance is the
+// first record of that batch and level in m_instanceData, which the draw index
+// attribute turns into the draws[] index.  Levels a mesh does not have keep an
+// instance count of 0.  Only needs to run when the set of drawn GeometryNodes changes;
+// renderIndirectSceneGraph() updates the counts.
+void Puppet::buildIndirectCommands()
+{
+	m_indirectCommands.clear();
+
+	GLuint baseInstance = 0;
+	for (const InstanceBatch & batch : m_instanceBatches) {
+		for (unsigned int level = 0; level < MeshSimplifier::MaxLevels; ++level) {
+			bool exists = level < m_meshRegistry->numLodLevels(batch.meshHandle);
+			const BatchInfo & batchInfo = m_meshRegistry->lodBatchInfo(batch.meshHandle,
+					exists ? level : 0);
+			DrawElementsIndirectCommand command;
+			command.count = batchInfo.numIndices;
+			command.instanceCount = (level == 0) ? GLuint(batch.flatIndices.size()) : 0;
+			command.firstIndex = batchInfo.startIndex;
+			command.baseVertex = 0;   // Indices are already absolute
+			command.baseInstance = baseInstance;
+			m_indirectCommands.push_back(command);
+			baseInstance += command.instanceCount;
+		}
+	}
+
+	vector<GLuint> drawIndices(baseInstance);
+	for (GLuint i = 0; i < baseInstance; ++i) {
+		drawIndices[i] = i;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_drawIndex);
+	glBufferData(GL_ARRAY_BUFFER, drawIndices.size() * sizeof(GLuint),
+			drawIndices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_buffer_indirectCommands);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER,
+			m_indirectCommands.size() * sizeof(DrawElementsIndirectCommand),
+			m_indirectCommands.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	CHECK_GL_ERRORS;
+
+	m_indirectCommandsDirty = false;
+}
+
 //----------------------------------------------------------------------------------------
 void Puppet::initPerspectiveMatrix()
 {
@@ -274,55 +976,36 @@ void Puppet::initLightSources() {
 	m_light.rgbIntensity = vec3(1.0f); // light
 }
 
-
-void Puppet::initNodeInfo(SceneNode* node) {
-	if (node == nullptr) {
-		return;
-	}
-	int id = node->m_nodeId;
-	if (idToInitialNodeInfo.find(id) == idToInitialNodeInfo.end()) {
-		idToInitialNodeInfo[id] = new NodeInfo(node);
-	}
-
-	for (auto child : node->children) {
-		initNodeInfo(child);
+//----------------------------------------------------------------------------------------
+void Puppet::uploadCommonSceneUniforms() {
+	uploadCommonSceneUniforms(m_shader, m_meshUniforms);
+	uploadCommonSceneUniforms(m_shader_instanced, m_instancedUniforms);
+	uploadCommonSceneUniforms(m_shader_skinned, m_skinnedUniforms);
+	if (m_supportsIndirect) {
+		uploadCommonSceneUniforms(m_shader_indirect, m_indirectUniforms);
 	}
 }
 
 //----------------------------------------------------------------------------------------
-void Puppet::uploadCommonSceneUniforms() {
-	m_shader.enable();
+void Puppet::uploadCommonSceneUniforms(
+		const ShaderProgram & shader,
+		const MeshShaderUniforms & uniforms
+) {
+	shader.enable();
 	{
 		//-- Set Perpsective matrix uniform for the scene:
-		GLint location = m_shader.getUniformLocation("Perspective");
-		glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(m_perpsective));
-		CHECK_GL_ERRORS;
+		Uniforms::set(uniforms.perspective, m_perpsective);
 
-		// Decide whether or not rendering in picking mode
-		location = m_shader.getUniformLocation("picking");
-		glUniform1i(location, do_picking ? 1 : 0);
-		
-		if (!do_picking) {
-			//-- Set LightSource uniform for the scene:
-			{
-				location = m_shader.getUniformLocation("light.position");
-				glUniform3fv(location, 1, value_ptr(m_light.position));
-				location = m_shader.getUniformLocation("light.rgbIntensity");
-				glUniform3fv(location, 1, value_ptr(m_light.rgbIntensity));
-				CHECK_GL_ERRORS;
-			}
+		Uniforms::set(uniforms.octNormalScale, VertexCompression::octNormalScale(vertexFormat));
 
-			//-- Set background light ambient intensity
-			{
-				location = m_shader.getUniformLocation("ambientIntensity");
-				vec3 ambientIntensity(0.25f);
-				glUniform3fv(location, 1, value_ptr(ambientIntensity));
-				CHECK_GL_ERRORS;
-			}
-		}
-		
+		//-- Set LightSource uniform for the scene:
+		Uniforms::set(uniforms.lightPosition, m_light.position);
+		Uniforms::set(uniforms.lightRgbIntensity, m_light.rgbIntensity);
+
+		//-- Set background light ambient intensity
+		Uniforms::set(uniforms.ambientIntensity, vec3(0.25f));
 	}
-	m_shader.disable();
+	shader.disable();
 }
 
 //----------------------------------------------------------------------------------------
@@ -333,6 +1016,31 @@ void Puppet::appLogic()
 {
 	// Place per frame, application logic here ...
 
+	// Count of world transforms recomputed while drawing the previous frame.
+	recomputed_nodes_last_frame = SceneNode::worldRecomputeCount;
+	SceneNode::worldRecomputeCount = 0;
+	uniform_uploads_last_frame = Uniforms::uploadCount;
+	uniform_lookups_last_frame = Uniforms::lookupCount;
+	Uniforms::resetCounters();
+	render_stats_last_frame = m_renderStats;
+	m_renderStats = RenderStats();
+
+	// Frame time, measured from one appLogic() to the next.
+	auto now = chrono::high_resolution_clock::now();
+	if (m_frameCount > 0) {
+		double frameMs = chrono::duration<double, milli>(now - m_lastFrameTime).count();
+		average_frame_ms += 0.05 * (frameMs - average_frame_ms);
+		if (pick_in_frame) {
+			pick_frame_ms = frameMs;
+			pick_in_frame = false;
+		}
+		updateAnimation(frameMs / 1000.0);
+	}
+	m_lastFrameTime = now;
+	++m_frameCount;
+
+	resolveAsyncPicks();
+
 	uploadCommonSceneUniforms();
 
 }
@@ -376,6 +1084,12 @@ void Puppet::guiLogic()
 				if( ImGui::MenuItem("Reset All (A)") ) {
 					resetAll();
 				}
+				if( ImGui::MenuItem("Reload Shaders") ) {
+					reloadShaders();
+				}
+				if( ImGui::MenuItem("Benchmark Transforms") ) {
+					benchmarkTransformEvaluation();
+				}
 				if( ImGui::MenuItem("Quit (Q)") ) {
 					glfwSetWindowShouldClose(m_window, GL_TRUE);
 				}
@@ -400,6 +1114,39 @@ void Puppet::guiLogic()
 				ImGui::MenuItem("Z-buffer (Z)", NULL, &option_zbuffer);
 				ImGui::MenuItem("Backface Culling (B)", NULL, &option_backface);
 				ImGui::MenuItem("Frontface Culling (F)", NULL, &option_frontface);
+				ImGui::MenuItem("Cached Uniform Locations", NULL, &option_cached_uniforms);
+				ImGui::MenuItem("Frustum Culling", NULL, &option_frustum_culling);
+				ImGui::EndMenu();
+			}
+
+			// Poses Menu
+			if( ImGui::BeginMenu("Poses") ) {
+				if( ImGui::MenuItem("Store Pose") ) {
+					storePose();
+				}
+				if( ImGui::MenuItem("Save Poses") ) {
+					savePoses();
+				}
+				if( ImGui::MenuItem("Load Poses") ) {
+					loadPoses();
+				}
+				if (m_poseLibrary.size() > 0) {
+					ImGui::Separator();
+				}
+				for (size_t i = 0; i < m_poseLibrary.size(); ++i) {
+					if( ImGui::MenuItem(m_poseLibrary.names[i].c_str(), NULL,
+							m_currentPose == int(i)) ) {
+						applyPose(i);
+					}
+				}
+				ImGui::EndMenu();
+			}
+
+			// Level of detail Menu
+			if( ImGui::BeginMenu("Detail") ) {
+				ImGui::RadioButton("Full detail", reinterpret_cast<int*>(&lodPolicy), LodPolicy::LOD_FULL);
+				ImGui::RadioButton("By screen size", reinterpret_cast<int*>(&lodPolicy), LodPolicy::LOD_SCREEN_SIZE);
+				ImGui::RadioButton("By screen error", reinterpret_cast<int*>(&lodPolicy), LodPolicy::LOD_SCREEN_ERROR);
 				ImGui::EndMenu();
 			}
 
@@ -411,62 +1158,173 @@ void Puppet::guiLogic()
 		if (ImGui::RadioButton("Joints (J)", reinterpret_cast<int*>(&interactionMode), InteractionMode::JOINT)) {
 			handleInteractionMode();
 		}
-		ImGui::Text("Framerate: %.1f FPS", ImGui::GetIO().Framerate);
+		ImGui::RadioButton("GPU picking", reinterpret_cast<int*>(&pickingMode), PickingMode::GPU_READBACK);
+		ImGui::SameLine();
+		ImGui::RadioButton("Async GPU", reinterpret_cast<int*>(&pickingMode), PickingMode::GPU_ASYNC);
+		ImGui::SameLine();
+		ImGui::RadioButton("Ray-cast picking", reinterpret_cast<int*>(&pickingMode), PickingMode::RAY_CAST);
+		ImGui::SameLine();
+		ImGui::Checkbox("Compare", &option_compare_picking);
+
+		// The recursive path refreshes SceneNode caches without touching the flat
+		// copy of the world transforms, so force a full update when switching.
+		RenderPath previousPath = renderPath;
+		ImGui::RadioButton("Recursive", reinterpret_cast<int*>(&renderPath), RenderPath::RECURSIVE);
+		ImGui::SameLine();
+		ImGui::RadioButton("Flattened", reinterpret_cast<int*>(&renderPath), RenderPath::FLATTENED);
+		ImGui::SameLine();
+		ImGui::RadioButton("Sorted", reinterpret_cast<int*>(&renderPath), RenderPath::SORTED);
+		ImGui::SameLine();
+		ImGui::RadioButton("Instanced", reinterpret_cast<int*>(&renderPath), RenderPath::INSTANCED);
+		if (m_supportsIndirect) {
+			ImGui::SameLine();
+			ImGui::RadioButton("Indirect", reinterpret_cast<int*>(&renderPath), RenderPath::INDIRECT);
+		}
+		ImGui::SameLine();
+		ImGui::RadioButton("Skinned", reinterpret_cast<int*>(&renderPath), RenderPath::SKINNED);
+		if (renderPath != previousPath && m_rootNode) {
+			m_rootNode->mark_dirty();
+		}
+
+		VertexFormat previousFormat = vertexFormat;
+		ImGui::RadioButton("Float", reinterpret_cast<int*>(&vertexFormat), VERTEX_FLOAT32);
+		ImGui::SameLine();
+		ImGui::RadioButton("Compact 16", reinterpret_cast<int*>(&vertexFormat), VERTEX_COMPACT16);
+		ImGui::SameLine();
+		ImGui::RadioButton("Compact 8", reinterpret_cast<int*>(&vertexFormat), VERTEX_COMPACT8);
+		if (vertexFormat != previousFormat) {
+			reloadMeshes();
+		}
+
+		ImGui::Text("Framerate: %.1f FPS (%.2f ms)", ImGui::GetIO().Framerate,
+			1000.0f / ImGui::GetIO().Framerate);
+		ImGui::Text("Scene nodes: %d", int(m_flatSceneGraph.size()));
+		ImGui::Text("World transforms recomputed: %u", recomputed_nodes_last_frame);
+		ImGui::Text("Uniform uploads: %u, name lookups: %u",
+			uniform_uploads_last_frame, uniform_lookups_last_frame);
+		ImGui::Text("Draw calls: %u, state changes: %u",
+			render_stats_last_frame.drawCalls, render_stats_last_frame.stateChanges);
+		if (option_frustum_culling) {
+			ImGui::Text("Geometry nodes: %u drawn, %u culled (%u subtrees rejected)",
+				m_cullResult.geometryVisible, m_cullResult.geometryCulled,
+				m_cullResult.subtreesCulled);
+		} else {
+			ImGui::Text("Geometry nodes: %u drawn, culling off", m_cullResult.geometryVisible);
+		}
+		const RenderStats & stats = render_stats_last_frame;
+		ImGui::Text("Triangles: %u of %u at full detail (%.0f%%)", stats.triangles,
+			stats.fullDetailTriangles,
+			stats.fullDetailTriangles ? 100.0 * stats.triangles / stats.fullDetailTriangles : 100.0);
+		ImGui::Text("Triangles by policy: full %u, screen size %u, screen error %u",
+			stats.policyTriangles[LOD_FULL], stats.policyTriangles[LOD_SCREEN_SIZE],
+			stats.policyTriangles[LOD_SCREEN_ERROR]);
+		ImGui::Text("Nodes per level of detail:");
+		for (unsigned int level = 0; level < MeshSimplifier::MaxLevels; ++level) {
+			ImGui::SameLine();
+			ImGui::Text("%u", stats.lodDraws[level]);
+		}
+		ImGui::Text("History: %d undo, %d redo, %.1f of %.0f KB",
+			int(m_history.numUndo()), int(m_history.numRedo()),
+			m_history.usedBytes() / 1024.0, m_history.maxBytes() / 1024.0);
+		int historyKb = int(m_history.maxBytes() / 1024);
+		if (ImGui::SliderInt("History limit (KB)", &historyKb, 1, 4096)) {
+			m_history.setMaxBytes(size_t(historyKb) * 1024);
+		}
+		ImGui::Text("Poses: %d stored over %d joints", int(m_poseLibrary.size()),
+			int(m_jointTable.size()));
+		if (pose_switch_us >= 0.0) {
+			ImGui::SameLine();
+			ImGui::Text("(last switch %.2f us)", pose_switch_us);
+		}
+		if (ImGui::Button(animation_playing ? "Pause (Space)" : "Play (Space)")) {
+			toggleAnimation();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Key Pose")) {
+			keyCurrentPose();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Clear Keys")) {
+			m_clip.reset(m_jointTable.size());
+			animation_playing = false;
+			animation_time = 0.0f;
+		}
+		ImGui::SameLine();
+		ImGui::Checkbox("Loop", &option_loop_animation);
+		if (ImGui::SliderFloat("Time (s)", &animation_time, 0.0f,
+				max(m_clip.duration() + 1.0f, 5.0f), "%.2f") && m_clip.numKeys() > 0) {
+			showAnimationFrame();
+		}
+		ImGui::Text("Animation: %d keys over %d joints, %.2f s", int(m_clip.numKeys()),
+			int(m_clip.numTracks()), m_clip.duration());
+		if (animation_eval_us >= 0.0) {
+			ImGui::SameLine();
+			ImGui::Text("(evaluated in %.1f us)", animation_eval_us);
+		}
+		ImGui::Text("Vertex data: %.1f KB (%d bytes/vertex)", vertex_buffer_bytes / 1024.0,
+			int(VertexCompression::vertexSize(vertexFormat)));
+		ImGui::Text("Skinned mesh: %d vertices, %d bones", int(m_skinnedMesh.numVertices()),
+			int(m_skinnedMesh.numBones()));
+		if (skin_palette_us >= 0.0) {
+			ImGui::SameLine();
+			ImGui::Text("(palette %.1f us)", skin_palette_us);
+		}
+		if (pick_gpu_ms >= 0.0) {
+			ImGui::Text("Last GPU pick: %.3f ms", pick_gpu_ms);
+		}
+		if (pick_cpu_ms >= 0.0) {
+			ImGui::Text("Last ray-cast pick: %.3f ms (%u of %d nodes refit)",
+				pick_cpu_ms, pick_leaves_refit, int(m_pickingBvh.numLeaves()));
+		}
+		if (pick_async_issue_ms >= 0.0) {
+			ImGui::Text("Last async pick: issued in %.3f ms, selected after %.2f ms (%u frames)",
+				pick_async_issue_ms, pick_async_latency_ms, pick_async_latency_frames);
+		}
+		if (box_select_ms >= 0.0) {
+			ImGui::Text("Last box: %u joints from %u ids over %u pixels in %.3f ms",
+				box_select_joints, box_select_ids, box_select_pixels, box_select_ms);
+		}
+		if (pick_gpu_ms >= 0.0 || pick_async_issue_ms >= 0.0 || box_select_ms >= 0.0) {
+			ImGui::Text("Last ID pass: %u draw calls", id_pass_draws);
+		}
+		if (pick_frame_ms >= 0.0) {
+			ImGui::Text("Frame with last pick: %.2f ms (average %.2f ms)",
+				pick_frame_ms, average_frame_ms);
+		}
+		if (bench_flat_us > 0.0) {
+			ImGui::Text("Transforms: recursive %.2f us, flat %.2f us",
+				bench_recursive_us, bench_flat_us);
+		}
 		ImGui::End();
 	}
 
 }
 
 //----------------------------------------------------------------------------------------
-// Update mesh specific shader uniforms:
+// Update mesh specific shader uniforms.  The mesh shader must already be enabled.
+// positionTransform maps the mesh's stored positions to model space; normalMatrix is
+// that of modelView alone.
 static void updateShaderUniforms(
-		const ShaderProgram & shader,
+		const MeshShaderUniforms & uniforms,
 		const GeometryNode & node,
-		const glm::mat4 & viewMatrix
+		const glm::mat4 & modelView,
+		const NormalMatrix & normalMatrix,
+		const glm::mat4 & positionTransform
 ) {
+	//-- Set ModelView matrix:
+	Uniforms::set(uniforms.modelView, modelView * positionTransform);
 
-	shader.enable();
-	{
-		//-- Set ModelView matrix:
-		GLint location = shader.getUniformLocation("ModelView");
-		mat4 modelView = viewMatrix;
-		glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(modelView));
-		CHECK_GL_ERRORS;
-		if ( do_picking ) {
-			// unique
-			GLint location = shader.getUniformLocation("material.kd");
-			float r = float(node.m_nodeId & 0xff) / 255.0f;
-			float g = float((node.m_nodeId >> 8) & 0xff) / 255.0f;
-			float b = float((node.m_nodeId >> 16) & 0xff) / 255.0f;
-			glUniform3f(location, r, g, b);
-			CHECK_GL_ERRORS;
-		} else {
-			//-- Set NormMatrix:
-			location = shader.getUniformLocation("NormalMatrix");
-			mat3 normalMatrix = glm::transpose(glm::inverse(mat3(modelView)));
-			glUniformMatrix3fv(location, 1, GL_FALSE, value_ptr(normalMatrix));
-			CHECK_GL_ERRORS;
-
-			//-- Set Material values:
-			location = shader.getUniformLocation("material.kd");
-			vec3 kd = node.material.kd;
-			if (node.isSelected) {
-				kd = vec3(1.0f, 1.0f, 0.0f);
-			}
-			glUniform3fv(location, 1, value_ptr(kd));
-			CHECK_GL_ERRORS;
-			location = shader.getUniformLocation("material.ks");
-			vec3 ks = node.material.ks;
-			glUniform3fv(location, 1, value_ptr(ks));
-			CHECK_GL_ERRORS;
-			location = shader.getUniformLocation("material.shininess");
-			glUniform1f(location, node.material.shininess);
-			CHECK_GL_ERRORS;
-		}
-		
-	}
-	shader.disable();
+	//-- Set NormMatrix:
+	Uniforms::set(uniforms.normalMatrix, normalMatrix.toMat3());
 
+	//-- Set Material values:
+	vec3 kd = node.material.kd;
+	if (node.isSelected) {
+		kd = vec3(1.0f, 1.0f, 0.0f);
+	}
+	Uniforms::set(uniforms.materialKd, kd);
+	Uniforms::set(uniforms.materialKs, node.material.ks);
+	Uniforms::set(uniforms.materialShininess, node.material.shininess);
 }
 
 //----------------------------------------------------------------------------------------
@@ -488,6 +1346,9 @@ void Puppet::draw() {
 	if (option_circle) {
 		renderArcCircle();
 	}
+	if (marquee_active) {
+		renderMarquee();
+	}
 }
 
 
@@ -496,7 +1357,18 @@ void Puppet::renderSceneNode(const SceneNode *node, const glm::mat4 transform) {
 	if (node == nullptr) {
 		return;
 	}
-	glm::mat4 currentTransform = transform * node->get_transform();
+	if (option_frustum_culling) {
+		if (node->m_subtreeBounds.empty()) {
+			// No GeometryNode below.
+			return;
+		}
+		if (!m_frustum.intersects(node->m_subtreeBounds)) {
+			++m_cullResult.subtreesCulled;
+			return;
+		}
+	}
+	// World transforms are cached on the nodes, only dirty subtrees are recomputed.
+	glm::mat4 currentTransform = transform * node->get_world_transform();
 	// 
 	// cout << "current node: " << *node << endl;
 	// cout << "current transform: " << currentTransform << endl;
@@ -505,30 +1377,349 @@ void Puppet::renderSceneNode(const SceneNode *node, const glm::mat4 transform) {
     if (node->m_nodeType == NodeType::GeometryNode) {
         const GeometryNode * geometryNode = static_cast<const GeometryNode *>(node);
         // Update the shader uniforms using the accumulated transform.
-
-        updateShaderUniforms(m_shader, *geometryNode, currentTransform);
-
-        // Retrieve the batch info for this geometry.
-        BatchInfo batchInfo = m_batchInfoMap[geometryNode->meshId];
-
-        m_shader.enable();
-        glDrawArrays(GL_TRIANGLES, batchInfo.startIndex, batchInfo.numIndices);
-        m_shader.disable();
+        if (!option_cached_uniforms) {
+            m_meshUniforms.resolve(m_shader);
+        }
+        NormalMatrix normalMatrix;
+        MatrixKernels::normalMatrices(&currentTransform, &normalMatrix, 1);
+        updateShaderUniforms(m_meshUniforms, *geometryNode, currentTransform, normalMatrix,
+                m_meshRegistry->positionTransform(geometryNode->meshHandle));
+
+        // Retrieve the batch info for this geometry, at the level of detail its
+        // projected size calls for.
+        unsigned int level = selectLod(*geometryNode, currentTransform);
+        const BatchInfo & batchInfo =
+                m_meshRegistry->lodBatchInfo(geometryNode->meshHandle, level);
+        countTriangles(geometryNode->meshHandle, level, 1);
+        countPolicyTriangles(*geometryNode, currentTransform, level);
+
+        glDrawElements(GL_TRIANGLES, batchInfo.numIndices, GL_UNSIGNED_INT,
+                indexBufferOffset(batchInfo));
+        ++m_renderStats.drawCalls;
+        ++m_renderStats.stateChanges;   // Full material upload per node.
+        ++m_cullResult.geometryVisible;
     }
 
 	// dfs to render all children.
 	// assume no loops
     for (const SceneNode* child : node->children) {
-        renderSceneNode(child, currentTransform);
+        renderSceneNode(child, transform);
     }
 }
 
+//----------------------------------------------------------------------------------------
+// Bring the flat world transforms up to date, then compute the ModelView and normal
+// matrix of every node of m_flatSceneGraph with one batched kernel call each.
+void Puppet::updateModelViews(const glm::mat4 & viewTransform) {
+	m_flatSceneGraph.updateDirtyWorldTransforms();
+
+	const size_t n = m_flatSceneGraph.size();
+	m_modelViews.resize(n);
+	m_normalMatrices.resize(n);
+	MatrixKernels::multiply(viewTransform, m_flatSceneGraph.worldTransforms.data(),
+			m_modelViews.data(), n);
+	MatrixKernels::normalMatrices(m_modelViews.data(), m_normalMatrices.data(), n);
+}
+
+//----------------------------------------------------------------------------------------
+// Same output as renderSceneNode, but world transforms come from one linear pass over
+// m_flatSceneGraph instead of a recursive walk.
+void Puppet::renderFlatSceneGraph(const glm::mat4 & viewTransform) {
+	updateModelViews(viewTransform);
+
+	for (unsigned int i : m_flatSceneGraph.geometryIndices) {
+		if (!m_visibleNodes[i]) {
+			continue;
+		}
+		const GeometryNode * geometryNode =
+				static_cast<const GeometryNode *>(m_flatSceneGraph.nodes[i]);
+
+		if (!option_cached_uniforms) {
+			m_meshUniforms.resolve(m_shader);
+		}
+		const mat4 & modelView = m_modelViews[i];
+		updateShaderUniforms(m_meshUniforms, *geometryNode, modelView, m_normalMatrices[i],
+				m_meshRegistry->positionTransform(geometryNode->meshHandle));
+
+		unsigned int level = selectLod(*geometryNode, modelView);
+		const BatchInfo & batchInfo =
+				m_meshRegistry->lodBatchInfo(geometryNode->meshHandle, level);
+		countTriangles(geometryNode->meshHandle, level, 1);
+		countPolicyTriangles(*geometryNode, modelView, level);
+
+		glDrawElements(GL_TRIANGLES, batchInfo.numIndices, GL_UNSIGNED_INT,
+				indexBufferOffset(batchInfo));
+		++m_renderStats.drawCalls;
+		++m_renderStats.stateChanges;   // Full material upload per node.
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// Walk m_drawList in sort order.  Only the matrices are refreshed for every item; the
+// material is uploaded when it differs from the previous item's.
+void Puppet::renderDrawList(const glm::mat4 & viewTransform) {
+	updateModelViews(viewTransform);
+
+	// Material currently held by the shader uniforms, -1 when unknown.
+	int currentMaterial = -1;
+
+	for (const RenderItem & item : m_drawList.items) {
+		if (!m_visibleNodes[item.flatIndex]) {
+			continue;
+		}
+		const mat4 & modelView = m_modelViews[item.flatIndex];
+		Uniforms::set(m_meshUniforms.modelView,
+				modelView * m_meshRegistry->positionTransform(item.node->meshHandle));
+		Uniforms::set(m_meshUniforms.normalMatrix, m_normalMatrices[item.flatIndex].toMat3());
+
+		if (item.node->isSelected) {
+			// Highlight overrides kd only; force a reload for the next item.
+			const Material & material = m_drawList.materials[item.materialIndex];
+			Uniforms::set(m_meshUniforms.materialKd, vec3(1.0f, 1.0f, 0.0f));
+			Uniforms::set(m_meshUniforms.materialKs, material.ks);
+			Uniforms::set(m_meshUniforms.materialShininess, material.shininess);
+			currentMaterial = -1;
+			++m_renderStats.stateChanges;
+		} else if (int(item.materialIndex) != currentMaterial) {
+			const Material & material = m_drawList.materials[item.materialIndex];
+			Uniforms::set(m_meshUniforms.materialKd, material.kd);
+			Uniforms::set(m_meshUniforms.materialKs, material.ks);
+			Uniforms::set(m_meshUniforms.materialShininess, material.shininess);
+			currentMaterial = int(item.materialIndex);
+			++m_renderStats.stateChanges;
+		}
+
+		// item.batchInfo is the full mesh; the level changes with distance.
+		unsigned int level = selectLod(*item.node, modelView);
+		const BatchInfo & batchInfo = m_meshRegistry->lodBatchInfo(item.node->meshHandle, level);
+		countTriangles(item.node->meshHandle, level, 1);
+		countPolicyTriangles(*item.node, modelView, level);
+
+		glDrawElements(GL_TRIANGLES, batchInfo.numIndices, GL_UNSIGNED_INT,
+				indexBufferOffset(batchInfo));
+		++m_renderStats.drawCalls;
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// Fill m_instanceData with one record per visible GeometryNode, grouped by
+// m_instanceBatches and then by level of detail, and m_instanceCounts with the number
+// of records per batch and level.
+void Puppet::gatherInstanceData(const glm::mat4 & viewTransform) {
+	updateModelViews(viewTransform);
+
+	const unsigned int MaxLevels = MeshSimplifier::MaxLevels;
+	m_instanceData.clear();
+	m_instanceCounts.assign(m_instanceBatches.size() * MaxLevels, 0);
+	for (size_t b = 0; b < m_instanceBatches.size(); ++b) {
+		const InstanceBatch & batch = m_instanceBatches[b];
+		GLuint * counts = &m_instanceCounts[b * MaxLevels];
+
+		// Pick every level first, so each level's records can be placed contiguously.
+		for (unsigned int i : batch.flatIndices) {
+			if (m_visibleNodes[i]) {
+				const GeometryNode * geometryNode =
+						static_cast<const GeometryNode *>(m_flatSceneGraph.nodes[i]);
+				unsigned int level = selectLod(*geometryNode, m_modelViews[i]);
+				countPolicyTriangles(*geometryNode, m_modelViews[i], level);
+				++counts[level];
+			}
+		}
+		size_t next[MeshSimplifier::MaxLevels];
+		size_t offset = m_instanceData.size();
+		for (unsigned int level = 0; level < MaxLevels; ++level) {
+			next[level] = offset;
+			offset += counts[level];
+			countTriangles(batch.meshHandle, level, counts[level]);
+		}
+		m_instanceData.resize(offset);
+
+		for (unsigned int i : batch.flatIndices) {
+			if (!m_visibleNodes[i]) {
+				continue;
+			}
+			const GeometryNode * geometryNode =
+					static_cast<const GeometryNode *>(m_flatSceneGraph.nodes[i]);
+
+			InstanceData & instance = m_instanceData[next[geometryNode->lodLevel]++];
+			instance.modelView = m_modelViews[i]
+					* m_meshRegistry->positionTransform(geometryNode->meshHandle);
+			for (int c = 0; c < 3; ++c) {
+				instance.normalMatrix[c] = m_normalMatrices[i].columns[c];
+			}
+			vec3 kd = geometryNode->isSelected ? vec3(1.0f, 1.0f, 0.0f)
+					: geometryNode->material.kd;
+			instance.kd = vec4(kd, 1.0f);
+			instance.ks = vec4(geometryNode->material.ks, geometryNode->material.shininess);
+		}
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// Gather every GeometryNode into m_instanceData grouped by mesh, stream it to the GPU in
+// one upload, then issue one glDrawElementsInstanced per mesh and level of detail.
+void Puppet::renderInstancedSceneGraph(const glm::mat4 & viewTransform) {
+	gatherInstanceData(viewTransform);
+
+	// Orphan the previous frame's storage instead of waiting on it.
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_instanceData);
+	glBufferData(GL_ARRAY_BUFFER, m_instanceData.size() * sizeof(InstanceData),
+			m_instanceData.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindVertexArray(m_vao_instanced);
+	m_shader_instanced.enable();
+
+	m_renderStats.stateChanges += 2;
+
+	size_t firstInstance = 0;
+	for (size_t c = 0; c < m_instanceCounts.size(); ++c) {
+		if (m_instanceCounts[c] == 0) {
+			continue;
+		}
+		const InstanceBatch & batch = m_instanceBatches[c / MeshSimplifier::MaxLevels];
+		const BatchInfo & batchInfo = m_meshRegistry->lodBatchInfo(batch.meshHandle,
+				unsigned(c % MeshSimplifier::MaxLevels));
+		mapInstanceDataToVertexShaderInputLocations(firstInstance);
+		glDrawElementsInstanced(GL_TRIANGLES, batchInfo.numIndices, GL_UNSIGNED_INT,
+				indexBufferOffset(batchInfo), GLsizei(m_instanceCounts[c]));
+		firstInstance += m_instanceCounts[c];
+		++m_renderStats.drawCalls;
+		++m_renderStats.stateChanges;   // Instance attribute re-pointing.
+	}
+
+	m_shader_instanced.disable();
+	glBindVertexArray(0);
+	CHECK_GL_ERRORS;
+}
+
+//----------------------------------------------------------------------------------------
+// Submit the whole scene with a single glMultiDrawElementsIndirect.  Per-draw data lives
+// in a shader storage buffer; the command buffer is only rebuilt when the set of drawn
+// GeometryNodes changes, and only rewritten when culling changes an instance count.
+void Puppet::renderIndirectSceneGraph(const glm::mat4 & viewTransform) {
+	if (m_indirectCommandsDirty) {
+		buildIndirectCommands();
+	}
+	gatherInstanceData(viewTransform);
+
+	bool countsChanged = false;
+	GLuint baseInstance = 0;
+	for (size_t b = 0; b < m_indirectCommands.size(); ++b) {
+		DrawElementsIndirectCommand & command = m_indirectCommands[b];
+		countsChanged = countsChanged || command.instanceCount != m_instanceCounts[b];
+		command.instanceCount = m_instanceCounts[b];
+		command.baseInstance = baseInstance;
+		baseInstance += command.instanceCount;
+	}
+	if (countsChanged) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_buffer_indirectCommands);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0,
+				m_indirectCommands.size() * sizeof(DrawElementsIndirectCommand),
+				m_indirectCommands.data());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ssbo_drawData);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_instanceData.size() * sizeof(InstanceData),
+			m_instanceData.data(), GL_STREAM_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_ssbo_drawData);
+
+	glBindVertexArray(m_vao_indirect);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_buffer_indirectCommands);
+	m_shader_indirect.enable();
+
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr,
+			GLsizei(m_indirectCommands.size()), 0);
+	++m_renderStats.drawCalls;
+	m_renderStats.stateChanges += 2;
+
+	m_shader_indirect.disable();
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+	glBindVertexArray(0);
+	CHECK_GL_ERRORS;
+}
+
+//----------------------------------------------------------------------------------------
+// Draw every GeometryNode at once as m_skinnedMesh.  Only the bone palette and the
+// part materials change from frame to frame; both are streamed to texture buffers and
+// the vertex shader does the rest.  Culling and levels of detail do not apply, the
+// whole mesh is drawn at full detail.
+void Puppet::renderSkinnedMesh(const glm::mat4 & viewTransform) {
+	auto start = chrono::high_resolution_clock::now();
+
+	m_flatSceneGraph.updateDirtyWorldTransforms();
+	m_skinnedMesh.updatePalette(m_flatSceneGraph);
+
+	// Materials follow the selection, so they are rewritten along with the palette.
+	const size_t numParts = m_skinnedMesh.parts.size();
+	m_materialPalette.resize(2 * numParts);
+	for (size_t p = 0; p < numParts; ++p) {
+		const GeometryNode * geometryNode = static_cast<const GeometryNode *>(
+				m_flatSceneGraph.nodes[m_skinnedMesh.parts[p]]);
+		const Material & material = geometryNode->material;
+		vec3 kd = geometryNode->isSelected ? vec3(1.0f, 1.0f, 0.0f) : material.kd;
+		m_materialPalette[2 * p] = vec4(kd, 1.0f);
+		m_materialPalette[2 * p + 1] = vec4(material.ks, material.shininess);
+	}
+
+	// Orphan the previous frame's storage instead of waiting on it.
+	glBindBuffer(GL_TEXTURE_BUFFER, m_tbo_bonePalette);
+	glBufferData(GL_TEXTURE_BUFFER, m_skinnedMesh.palette.size() * sizeof(mat4),
+			m_skinnedMesh.palette.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_tbo_materialPalette);
+	glBufferData(GL_TEXTURE_BUFFER, m_materialPalette.size() * sizeof(vec4),
+			m_materialPalette.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	auto end = chrono::high_resolution_clock::now();
+	skin_palette_us = chrono::duration<double, micro>(end - start).count();
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, m_tex_bonePalette);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_BUFFER, m_tex_materialPalette);
+
+	glBindVertexArray(m_vao_skinned);
+	m_shader_skinned.enable();
+
+	NormalMatrix normalMatrix;
+	MatrixKernels::normalMatrices(&viewTransform, &normalMatrix, 1);
+	Uniforms::set(m_skinnedUniforms.modelView, viewTransform);
+	Uniforms::set(m_skinnedUniforms.normalMatrix, normalMatrix.toMat3());
+
+	glDrawElements(GL_TRIANGLES, GLsizei(m_skinnedMesh.indices.size()), GL_UNSIGNED_INT,
+			nullptr);
+	++m_renderStats.drawCalls;
+	m_renderStats.stateChanges += 4;   // Program, VAO and both palettes.
+	m_renderStats.triangles += unsigned(m_skinnedMesh.indices.size() / 3);
+	m_renderStats.fullDetailTriangles += unsigned(m_skinnedMesh.indices.size() / 3);
+	m_renderStats.lodDraws[0] += unsigned(numParts);
+	for (unsigned int & triangles : m_renderStats.policyTriangles) {
+		triangles += unsigned(m_skinnedMesh.indices.size() / 3);
+	}
+	m_cullResult = CullResult();
+	m_cullResult.geometryVisible = unsigned(numParts);
+
+	m_shader_skinned.disable();
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	CHECK_GL_ERRORS;
+}
+
+//----------------------------------------------------------------------------------------
+// Maps FlatSceneGraph world space to eye space.
+glm::mat4 Puppet::sceneViewTransform() const {
+	// apply translation to view only and rotation to puppet only
+	return m_view * puppet_translation * puppet_transform * puppet_rotation;
+}
+
 //----------------------------------------------------------------------------------------
 void Puppet::renderSceneGraph(const SceneNode & root) {
 
-	// Bind the VAO once here, and reuse for all GeometryNode rendering below.
-	glBindVertexArray(m_vao_meshData);
-
 	// This is emphatically *not* how you should be drawing the scene graph in
 	// your final implementation.  This is a non-hierarchical demonstration
 	// in which we assume that there is a list of GeometryNodes living directly
@@ -543,13 +1734,178 @@ void Puppet::renderSceneGraph(const SceneNode & root) {
 	// walk down the tree from nodes of different types.
 
 
-	// apply translation to view only and rotation to puppet only
-	glm::mat4 transformedView = m_view * puppet_translation * puppet_transform * puppet_rotation;
+	glm::mat4 transformedView = sceneViewTransform();
+	cullSceneGraph(transformedView);
+
+	// The instanced and indirect paths bind their own VAO and shader.
+	if (renderPath == RenderPath::INSTANCED) {
+		renderInstancedSceneGraph(transformedView);
+		return;
+	}
+	if (renderPath == RenderPath::INDIRECT && m_supportsIndirect) {
+		renderIndirectSceneGraph(transformedView);
+		return;
+	}
+	if (renderPath == RenderPath::SKINNED && m_skinnedMesh.numVertices() > 0) {
+		renderSkinnedMesh(transformedView);
+		return;
+	}
+
+	// Bind the VAO and shader once here, and reuse for all GeometryNode rendering below.
+	glBindVertexArray(m_vao_meshData);
+	m_shader.enable();
+	m_renderStats.stateChanges += 2;
 
-	renderSceneNode(&root, transformedView);
+	if (renderPath == RenderPath::FLATTENED) {
+		renderFlatSceneGraph(transformedView);
+	} else if (renderPath == RenderPath::SORTED) {
+		renderDrawList(transformedView);
+	} else {
+		renderSceneNode(&root, transformedView);
+	}
 
+	m_shader.disable();
 	glBindVertexArray(0);
 	CHECK_GL_ERRORS;
+
+	if (renderPath == RenderPath::RECURSIVE && option_frustum_culling) {
+		const unsigned int numGeometry = unsigned(m_flatSceneGraph.geometryIndices.size());
+		m_cullResult.geometryCulled = numGeometry
+				- std::min(m_cullResult.geometryVisible, numGeometry);
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// Test the scene against the view frustum before drawing it.  The flat paths read the
+// result from m_visibleNodes; the recursive path only needs m_frustum and the subtree
+// bounds, and counts into m_cullResult as it walks.
+void Puppet::cullSceneGraph(const glm::mat4 & viewTransform) {
+	if (!option_frustum_culling) {
+		m_visibleNodes.assign(m_flatSceneGraph.size(), 1);
+		m_cullResult = CullResult();
+		if (renderPath != RenderPath::RECURSIVE) {
+			// The recursive path counts the nodes it draws itself.
+			m_cullResult.geometryVisible = unsigned(m_flatSceneGraph.geometryIndices.size());
+		}
+		return;
+	}
+
+	// Bounds come from the flat world transforms, so refresh those before the recursive
+	// path consumes the SceneNode dirty flags.
+	m_flatSceneGraph.updateDirtyWorldTransforms();
+	m_flatSceneGraph.updateSubtreeBounds();
+	m_frustum = Frustum(m_perpsective * viewTransform);
+
+	if (renderPath == RenderPath::RECURSIVE) {
+		m_cullResult = CullResult();
+	} else {
+		m_cullResult = m_flatSceneGraph.cull(m_frustum, m_visibleNodes);
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// Level of detail to draw node at with the current lodPolicy, given its ModelView
+// matrix.  Only moves away from the level drawn last frame once the node's projected
+// scale is LodHysteresis beyond the switching point, so a node sitting at a threshold
+// does not pop back and forth.
+unsigned int Puppet::selectLod(const GeometryNode & node, const glm::mat4 & modelView) const {
+	const int handle = node.meshHandle;
+	const unsigned int numLevels = m_meshRegistry->numLodLevels(handle);
+	const BoundingSphere & bounds = m_meshRegistry->meshBounds(handle);
+	if (lodPolicy == LodPolicy::LOD_FULL || numLevels == 1 || bounds.radius <= 0.0f) {
+		node.lodLevel = 0;
+		return 0;
+	}
+
+	float pixelsPerUnit = lodPixelsPerUnit(handle, modelView);
+	unsigned int level = std::min(node.lodLevel, numLevels - 1);
+	unsigned int coarser =
+			lodForScale(handle, pixelsPerUnit * (1.0f + LodHysteresis), lodPolicy);
+	unsigned int finer =
+			lodForScale(handle, pixelsPerUnit * (1.0f - LodHysteresis), lodPolicy);
+	if (coarser > level) {
+		level = coarser;
+	} else if (finer < level) {
+		level = finer;
+	}
+	node.lodLevel = level;
+	return level;
+}
+
+//----------------------------------------------------------------------------------------
+// Screen pixels covered by one model unit of meshHandle drawn with modelView, clamped
+// to the near plane so nodes around the eye stay at full detail.
+float Puppet::lodPixelsPerUnit(int meshHandle, const glm::mat4 & modelView) const {
+	const BoundingSphere & bounds = m_meshRegistry->meshBounds(meshHandle);
+	BoundingSphere eyeBounds = bounds.transformed(modelView);
+	float depth = std::max(-eyeBounds.center.z, 0.1f);
+	return (eyeBounds.radius / bounds.radius) * m_perpsective[1][1]
+			* 0.5f * m_framebufferHeight / depth;
+}
+
+//----------------------------------------------------------------------------------------
+// Level policy asks for when one model unit of the mesh covers pixelsPerUnit pixels.
+unsigned int Puppet::lodForScale(int meshHandle, float pixelsPerUnit,
+		LodPolicy policy) const {
+	const unsigned int numLevels = m_meshRegistry->numLodLevels(meshHandle);
+
+	if (policy == LodPolicy::LOD_FULL) {
+		return 0;
+	}
+	if (policy == LodPolicy::LOD_SCREEN_ERROR) {
+		unsigned int level = 0;
+		while (level + 1 < numLevels && m_meshRegistry->lodError(meshHandle, level + 1)
+				* pixelsPerUnit <= LodMaxErrorPixels) {
+			++level;
+		}
+		return level;
+	}
+
+	// Each level has half the triangles of the one before, so drop one level each time
+	// the projected area halves, i.e. the diameter shrinks by sqrt(2).
+	float diameter = 2.0f * m_meshRegistry->meshBounds(meshHandle).radius * pixelsPerUnit;
+	if (diameter <= 0.0f) {
+		return numLevels - 1;
+	}
+	float steps = 2.0f * std::log2(LodFullDetailPixels / diameter);
+	if (steps <= 0.0f) {
+		return 0;
+	}
+	return std::min(unsigned(steps), numLevels - 1);
+}
+
+//----------------------------------------------------------------------------------------
+// Add instances draws of meshHandle at level to m_renderStats.
+void Puppet::countTriangles(int meshHandle, unsigned int level, unsigned int instances) {
+	if (instances == 0) {
+		return;
+	}
+	m_renderStats.triangles +=
+			instances * (m_meshRegistry->lodBatchInfo(meshHandle, level).numIndices / 3);
+	m_renderStats.fullDetailTriangles +=
+			instances * (m_meshRegistry->batchInfo(meshHandle).numIndices / 3);
+	m_renderStats.lodDraws[level] += instances;
+}
+
+//----------------------------------------------------------------------------------------
+// Add node's triangles under every LodPolicy to m_renderStats, given the level it is
+// drawn at.  The active policy counts that level; the others count the level they would
+// pick from scratch, without hysteresis, since only the selection is needed on the CPU.
+void Puppet::countPolicyTriangles(const GeometryNode & node, const glm::mat4 & modelView,
+		unsigned int level) {
+	const int handle = node.meshHandle;
+	const bool scalable = m_meshRegistry->numLodLevels(handle) > 1
+			&& m_meshRegistry->meshBounds(handle).radius > 0.0f;
+	const float pixelsPerUnit = scalable ? lodPixelsPerUnit(handle, modelView) : 0.0f;
+	for (unsigned int p = 0; p < NumLodPolicies; ++p) {
+		const LodPolicy policy = LodPolicy(p);
+		unsigned int policyLevel = level;
+		if (policy != lodPolicy) {
+			policyLevel = scalable ? lodForScale(handle, pixelsPerUnit, policy) : 0;
+		}
+		m_renderStats.policyTriangles[p] +=
+				m_meshRegistry->lodBatchInfo(handle, policyLevel).numIndices / 3;
+	}
 }
 
 //----------------------------------------------------------------------------------------
@@ -558,7 +1914,6 @@ void Puppet::renderArcCircle() {
 	glBindVertexArray(m_vao_arcCircle);
 
 	m_shader_arcCircle.enable();
-		GLint m_location = m_shader_arcCircle.getUniformLocation( "M" );
 		float aspect = float(m_framebufferWidth)/float(m_framebufferHeight);
 		glm::mat4 M;
 		if( aspect > 1.0 ) {
@@ -566,7 +1921,7 @@ void Puppet::renderArcCircle() {
 		} else {
 			M = glm::scale( glm::mat4(), glm::vec3( 0.5, 0.5*aspect, 1.0 ) );
 		}
-		glUniformMatrix4fv( m_location, 1, GL_FALSE, value_ptr( M ) );
+		Uniforms::set( m_arcUniforms.M, M );
 		glDrawArrays( GL_LINE_LOOP, 0, CIRCLE_PTS );
 	m_shader_arcCircle.disable();
 
@@ -574,6 +1929,32 @@ void Puppet::renderArcCircle() {
 	CHECK_GL_ERRORS;
 }
 
+//----------------------------------------------------------------------------------------
+// Outline of the box selection being dragged, from marquee_start to the cursor.
+void Puppet::renderMarquee() {
+	double xpos, ypos;
+	glfwGetCursorPos(m_window, &xpos, &ypos);
+
+	// Window coordinates to normalized device coordinates.
+	float x0 = float(2.0 * marquee_start_x / m_windowWidth - 1.0);
+	float y0 = float(1.0 - 2.0 * marquee_start_y / m_windowHeight);
+	float x1 = float(2.0 * xpos / m_windowWidth - 1.0);
+	float y1 = float(1.0 - 2.0 * ypos / m_windowHeight);
+	const float corners[8] = { x0, y0, x1, y0, x1, y1, x0, y1 };
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_marquee);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(corners), corners);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindVertexArray(m_vao_marquee);
+	m_shader_arcCircle.enable();
+		Uniforms::set(m_arcUniforms.M, glm::mat4());
+		glDrawArrays(GL_LINE_LOOP, 0, 4);
+	m_shader_arcCircle.disable();
+	glBindVertexArray(0);
+	CHECK_GL_ERRORS;
+}
+
 // =========================================== Helper Methods ========================================== //
 void Puppet::handleCulling() {
 	if (option_backface || option_frontface) {
@@ -698,6 +2079,45 @@ SceneNode* Puppet::findSceneNodeById(SceneNode* node, unsigned int id) {
 	return nullptr;
 }
 
+// Transform-only version of the renderSceneNode traversal, used as the baseline when
+// benchmarking the flattened hierarchy.
+static void accumulateWorldTransforms(
+		const SceneNode * node,
+		const glm::mat4 & parentTransform,
+		vector<mat4> & worldTransforms
+) {
+	mat4 currentTransform = parentTransform * node->get_transform();
+	worldTransforms.push_back(currentTransform);
+	for (const SceneNode * child : node->children) {
+		accumulateWorldTransforms(child, currentTransform, worldTransforms);
+	}
+}
+
+void Puppet::benchmarkTransformEvaluation() {
+	if (!m_rootNode) {
+		return;
+	}
+	const int iterations = 1000;
+
+	vector<mat4> recursiveTransforms;
+	recursiveTransforms.reserve(m_flatSceneGraph.size());
+
+	auto start = chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; ++i) {
+		recursiveTransforms.clear();
+		accumulateWorldTransforms(m_rootNode.get(), mat4(), recursiveTransforms);
+	}
+	auto middle = chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; ++i) {
+		m_flatSceneGraph.syncLocalTransforms();
+		m_flatSceneGraph.updateWorldTransforms();
+	}
+	auto end = chrono::high_resolution_clock::now();
+
+	bench_recursive_us = chrono::duration<double, micro>(middle - start).count() / iterations;
+	bench_flat_us = chrono::duration<double, micro>(end - middle).count() / iterations;
+}
+
 void Puppet::handleInteractionMode() {
 	if (interactionMode == JOINT) {
 		// m_light.rgbIntensity = vec3(0.0f);
@@ -721,7 +2141,7 @@ void Puppet::applyJointTransform(double xPos, double yPos) {
 				if (new_angle > x_max || new_angle < x_min) {
 					continue;
 				}
-				node->rotate('z', deltaAngle);
+				joint->set_angles(joint->current_angle_y, new_angle);
 			}
 		}
 	}
@@ -737,69 +2157,351 @@ void Puppet::applyJointTransform(double xPos, double yPos) {
 			if (new_angle > y_max || new_angle < y_min) {
 				return;
 			}
-			head_parent->rotate('y', deltaAngle);
+			joint->set_angles(new_angle, joint->current_angle_z);
 		}
 	}
 	
 }
 
+//----------------------------------------------------------------------------------------
+// Toggle the selection of the GeometryNode under the cursor, found with pickingMode.
 void Puppet::pickingSetup() {
-	do_picking = true;
-	uploadCommonSceneUniforms(); // Make sure the shader gets do_picking = true.
+	double xpos, ypos;
+	glfwGetCursorPos(m_window, &xpos, &ypos);
+	pick_in_frame = true;
 
-	glClearColor(1.0, 1.0, 1.0, 1.0);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glClearColor(0.35, 0.35, 0.35, 1.0);
+	if (pickingMode == GPU_ASYNC) {
+		auto start = chrono::high_resolution_clock::now();
+		issueAsyncPick(xpos, ypos);
+		auto end = chrono::high_resolution_clock::now();
+		pick_async_issue_ms = chrono::duration<double, milli>(end - start).count();
+		return;
+	}
 
-	draw();
+	SceneNode * gpuNode = nullptr;
+	SceneNode * cpuNode = nullptr;
+	if (pickingMode == GPU_READBACK || option_compare_picking) {
+		auto start = chrono::high_resolution_clock::now();
+		gpuNode = pickNodeGpu(xpos, ypos);
+		auto end = chrono::high_resolution_clock::now();
+		pick_gpu_ms = chrono::duration<double, milli>(end - start).count();
+	}
+	if (pickingMode == RAY_CAST || option_compare_picking) {
+		auto start = chrono::high_resolution_clock::now();
+		cpuNode = pickNodeCpu(xpos, ypos);
+		auto end = chrono::high_resolution_clock::now();
+		pick_cpu_ms = chrono::duration<double, milli>(end - start).count();
+	}
 
-	CHECK_GL_ERRORS;
+	if (option_compare_picking && gpuNode != cpuNode) {
+		cerr << "Pickers disagree: GPU picked "
+			 << (gpuNode ? gpuNode->m_name : string("nothing")) << ", CPU picked "
+			 << (cpuNode ? cpuNode->m_name : string("nothing")) << endl;
+	}
 
-	double xpos, ypos;
-	glfwGetCursorPos(m_window, &xpos, &ypos);
+	toggleSelection(pickingMode == GPU_READBACK ? gpuNode : cpuNode);
+}
+
+//----------------------------------------------------------------------------------------
+// Framebuffer pixel under a cursor position given in window coordinates.
+void Puppet::windowToFramebufferPixel(double xPos, double yPos, int & pixelX,
+		int & pixelY) const {
+	pixelX = int(xPos * double(m_framebufferWidth) / double(m_windowWidth));
+	pixelY = int((m_windowHeight - yPos) * double(m_framebufferHeight)
+			/ double(m_windowHeight));
+}
+
+//----------------------------------------------------------------------------------------
+// Bring m_flatSceneGraph.worldTransforms up to date for passes outside the frame.
+void Puppet::updateFlatWorldTransforms() {
+	// World transforms are only up to date in the flat copy when a flat path drew the
+	// last frame; the recursive path refreshes the SceneNode caches instead.
+	if (renderPath == RenderPath::RECURSIVE) {
+		m_flatSceneGraph.syncLocalTransforms();
+		m_flatSceneGraph.updateWorldTransforms();
+	} else {
+		m_flatSceneGraph.updateDirtyWorldTransforms();
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// Draw every GeometryNode's m_nodeId into m_idBuffer, limited by the scissor test to
+// the given framebuffer rectangle.  With frustum culling on, only GeometryNodes inside
+// the part of the frustum behind the rectangle are submitted.
+void Puppet::renderIdPass(int x, int y, int width, int height) {
+	updateFlatWorldTransforms();
+
+	const mat4 view = sceneViewTransform();
+	if (option_frustum_culling) {
+		// Scale and shift clip space so the rectangle fills [-1, 1]^2.
+		float x0 = 2.0f * x / m_framebufferWidth - 1.0f;
+		float x1 = 2.0f * (x + width) / m_framebufferWidth - 1.0f;
+		float y0 = 2.0f * y / m_framebufferHeight - 1.0f;
+		float y1 = 2.0f * (y + height) / m_framebufferHeight - 1.0f;
+		mat4 region = glm::scale(mat4(), vec3(2.0f / (x1 - x0), 2.0f / (y1 - y0), 1.0f))
+				* glm::translate(mat4(), vec3(-0.5f * (x0 + x1), -0.5f * (y0 + y1), 0.0f));
+
+		m_flatSceneGraph.updateSubtreeBounds();
+		m_flatSceneGraph.cull(Frustum(region * m_perpsective * view), m_idPassVisibleNodes);
+	} else {
+		m_idPassVisibleNodes.assign(m_flatSceneGraph.size(), 1);
+	}
+
+	m_idBuffer.resize(m_framebufferWidth, m_framebufferHeight);
+
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(x, y, width, height);
+	m_idBuffer.beginPass();
+
+	glEnable(GL_DEPTH_TEST);
+	handleCulling();
+
+	glBindVertexArray(m_vao_id);
+	m_shader_id.enable();
+	Uniforms::set(m_idUniforms.perspective, m_perpsective);
+	id_pass_draws = 0;
+	for (unsigned int i : m_flatSceneGraph.geometryIndices) {
+		if (!m_idPassVisibleNodes[i]) {
+			continue;
+		}
+		const GeometryNode * geometryNode =
+				static_cast<const GeometryNode *>(m_flatSceneGraph.nodes[i]);
+
+		Uniforms::set(m_idUniforms.modelView, view * m_flatSceneGraph.worldTransforms[i]
+				* m_meshRegistry->positionTransform(geometryNode->meshHandle));
+		Uniforms::set(m_idUniforms.nodeId, geometryNode->m_nodeId);
+
+		// Always the full mesh, the triangles m_pickingBvh holds, so both pickers agree.
+		const BatchInfo & batchInfo = m_meshRegistry->batchInfo(geometryNode->meshHandle);
+		glDrawElements(GL_TRIANGLES, batchInfo.numIndices, GL_UNSIGNED_INT,
+				indexBufferOffset(batchInfo));
+		++id_pass_draws;
+	}
+	m_shader_id.disable();
+	glBindVertexArray(0);
 
-	xpos *= double(m_framebufferWidth) / double(m_windowWidth);
-	ypos = m_windowHeight - ypos;
-	ypos *= double(m_framebufferHeight) / double(m_windowHeight);
+	m_idBuffer.endPass();
+	glDisable(GL_SCISSOR_TEST);
 
-	GLubyte buffer[ 4 ] = { 0, 0, 0, 0 };
-	// A bit ugly -- don't want to swap the just-drawn false colours
-	// to the screen, so read from the back buffer.
-	glReadBuffer( GL_BACK );
-	// Actually read the pixel at the mouse location.
-	glReadPixels( int(xpos), int(ypos), 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, buffer );
 	CHECK_GL_ERRORS;
+}
+
+//----------------------------------------------------------------------------------------
+// GeometryNode with the given m_nodeId, or nullptr.
+SceneNode * Puppet::geometryNodeById(uint32_t id) {
+	if (id == IdBuffer::NoId) {
+		return nullptr;
+	}
+	SceneNode * node = findSceneNodeById(m_rootNode.get(), id);
+	if (node && node->m_nodeType == NodeType::GeometryNode) {
+		return node;
+	}
+	return nullptr;
+}
+
+//----------------------------------------------------------------------------------------
+// Render the whole ID pass and read back the id under the cursor.  glReadPixels waits
+// for the GPU to finish the pass.
+SceneNode * Puppet::pickNodeGpu(double xpos, double ypos) {
+	renderIdPass(0, 0, m_framebufferWidth, m_framebufferHeight);
+
+	int pixelX, pixelY;
+	windowToFramebufferPixel(xpos, ypos, pixelX, pixelY);
+	vector<uint32_t> ids = m_idBuffer.readDistinctIds(pixelX, pixelY, 1, 1);
+	return ids.empty() ? nullptr : geometryNodeById(ids[0]);
+}
+
+//----------------------------------------------------------------------------------------
+// Select every JointNode with a GeometryNode child visible inside the rectangle
+// between two cursor positions, in window coordinates.  One ID pass limited to the
+// rectangle and one readback, however many joints it covers.
+void Puppet::boxSelect(double x0, double y0, double x1, double y1) {
+	auto start = chrono::high_resolution_clock::now();
+
+	int left, bottom, right, top;
+	windowToFramebufferPixel(std::min(x0, x1), std::max(y0, y1), left, bottom);
+	windowToFramebufferPixel(std::max(x0, x1), std::min(y0, y1), right, top);
+	left = std::max(left, 0);
+	bottom = std::max(bottom, 0);
+	right = std::min(right, m_framebufferWidth - 1);
+	top = std::min(top, m_framebufferHeight - 1);
+	if (right < left || top < bottom) {
+		return;
+	}
+	const int width = right - left + 1;
+	const int height = top - bottom + 1;
 
-	// Reassemble the object ID.
-	unsigned int pickedID = buffer[0] + (buffer[1] << 8) + (buffer[2] << 16);
+	renderIdPass(left, bottom, width, height);
+	vector<uint32_t> ids = m_idBuffer.readDistinctIds(left, bottom, width, height);
 
-	SceneNode* pickedNode = findSceneNodeById(m_rootNode.get(), pickedID);
-	if (pickedNode && pickedNode->m_nodeType == NodeType::GeometryNode) {
-		// Toggle the selection flag
-		pickedNode->isSelected = !pickedNode->isSelected;
-		// cout << "picked node id: " << pickedNode->m_nodeId << endl;
-		SceneNode* parent = pickedNode->m_parent;
-		// Sync parent (joint node)
+	box_select_joints = 0;
+	for (uint32_t id : ids) {
+		SceneNode * geometryNode = geometryNodeById(id);
+		if (geometryNode == nullptr) {
+			continue;
+		}
+		SceneNode * parent = geometryNode->m_parent;
 		if (parent && parent->m_nodeType == NodeType::JointNode) {
-			parent->isSelected = pickedNode->isSelected;
-			if (parent->isSelected) {
-				selected_nodes.insert(parent);
-			} else {
-				selected_nodes.erase(parent);
+			geometryNode->isSelected = true;
+			parent->isSelected = true;
+			// Counts each joint once, however many of its parts are in the box, and
+			// only if it was not selected already.
+			if (selected_nodes.insert(parent).second) {
+				++box_select_joints;
 			}
-		} 
+		}
+	}
+
+	auto end = chrono::high_resolution_clock::now();
+	box_select_ms = chrono::duration<double, milli>(end - start).count();
+	box_select_ids = unsigned(ids.size());
+	box_select_pixels = unsigned(width * height);
+}
+
+//----------------------------------------------------------------------------------------
+// Cast a ray through the centre of the framebuffer pixel pickNodeGpu() would read, and
+// return the GeometryNode of the closest triangle it hits.  Honours the face culling
+// options the same way the GPU does.
+SceneNode * Puppet::pickNodeCpu(double xpos, double ypos) {
+	updateFlatWorldTransforms();
+	pick_leaves_refit = m_pickingBvh.refit(m_flatSceneGraph);
+
+	double pixelX = floor(xpos * double(m_framebufferWidth) / double(m_windowWidth)) + 0.5;
+	double pixelY = floor((m_windowHeight - ypos) * double(m_framebufferHeight)
+			/ double(m_windowHeight)) + 0.5;
+	float ndcX = float(2.0 * pixelX / m_framebufferWidth - 1.0);
+	float ndcY = float(2.0 * pixelY / m_framebufferHeight - 1.0);
+
+	// Unproject onto the near and far planes, so t in [0, 1] covers what is drawn.
+	mat4 view = sceneViewTransform();
+	mat4 inverseViewProjection = inverse(m_perpsective * view);
+	vec4 nearPoint = inverseViewProjection * vec4(ndcX, ndcY, -1.0f, 1.0f);
+	vec4 farPoint = inverseViewProjection * vec4(ndcX, ndcY, 1.0f, 1.0f);
+
+	Ray ray;
+	ray.origin = vec3(nearPoint) / nearPoint.w;
+	ray.direction = vec3(farPoint) / farPoint.w - ray.origin;
+
+	RayCulling culling;
+	culling.backFaces = option_backface;
+	culling.frontFaces = option_frontface;
+	culling.handedness = (determinant(mat3(view)) < 0.0f) ? -1.0f : 1.0f;
+
+	RayHit hit;
+	if (!m_pickingBvh.intersect(ray, culling, hit)) {
+		return nullptr;
+	}
+	return m_flatSceneGraph.nodes[hit.flatIndex];
+}
+
+//----------------------------------------------------------------------------------------
+// Queue a GPU_ASYNC pick: render the ID pass for the cursor pixel only and start
+// copying that id into a pixel buffer object.  Nothing waits for the GPU here;
+// resolveAsyncPicks() picks the result up once the fence behind the copy has signalled.
+void Puppet::issueAsyncPick(double xpos, double ypos) {
+	int pixelX, pixelY;
+	windowToFramebufferPixel(xpos, ypos, pixelX, pixelY);
+
+	renderIdPass(pixelX, pixelY, 1, 1);
+
+	PendingPick pick;
+	if (m_freePickBuffers.empty()) {
+		glGenBuffers(1, &pick.pixelBuffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pick.pixelBuffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(uint32_t), nullptr, GL_STREAM_READ);
+	} else {
+		pick.pixelBuffer = m_freePickBuffers.back();
+		m_freePickBuffers.pop_back();
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pick.pixelBuffer);
 	}
-	do_picking = false;
+
+	// With a pack buffer bound, glReadPixels only queues the copy.
+	m_idBuffer.readIdToPixelBuffer(pixelX, pixelY);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	pick.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	pick.clickTime = chrono::high_resolution_clock::now();
+	pick.clickFrame = m_frameCount;
+	m_pendingPicks.push_back(pick);
+
 	CHECK_GL_ERRORS;
 }
 
+//----------------------------------------------------------------------------------------
+// Called once per frame.  Resolves queued GPU_ASYNC picks, oldest first, until one is
+// found whose pixel has not arrived yet.
+void Puppet::resolveAsyncPicks() {
+	while (!m_pendingPicks.empty()) {
+		PendingPick & pick = m_pendingPicks.front();
+
+		// Zero timeout: only poll.  The flush makes sure the fence gets submitted.
+		GLenum status = glClientWaitSync(pick.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (status == GL_TIMEOUT_EXPIRED) {
+			break;
+		}
+		if (status == GL_WAIT_FAILED) {
+			cerr << "Waiting on a picking fence failed" << endl;
+		}
+
+		uint32_t id = IdBuffer::NoId;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pick.pixelBuffer);
+		const void * data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(id),
+				GL_MAP_READ_BIT);
+		if (data) {
+			memcpy(&id, data, sizeof(id));
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glDeleteSync(pick.fence);
+		m_freePickBuffers.push_back(pick.pixelBuffer);
+
+		auto now = chrono::high_resolution_clock::now();
+		pick_async_latency_ms = chrono::duration<double, milli>(now - pick.clickTime).count();
+		pick_async_latency_frames = m_frameCount - pick.clickFrame;
+		m_pendingPicks.pop_front();
+
+		toggleSelection(geometryNodeById(id));
+
+		CHECK_GL_ERRORS;
+	}
+}
+
+//----------------------------------------------------------------------------------------
+void Puppet::toggleSelection(SceneNode * pickedNode) {
+	if (pickedNode == nullptr) {
+		return;
+	}
+	// Toggle the selection flag
+	pickedNode->isSelected = !pickedNode->isSelected;
+	// cout << "picked node id: " << pickedNode->m_nodeId << endl;
+	SceneNode* parent = pickedNode->m_parent;
+	// Sync parent (joint node)
+	if (parent && parent->m_nodeType == NodeType::JointNode) {
+		parent->isSelected = pickedNode->isSelected;
+		if (parent->isSelected) {
+			selected_nodes.insert(parent);
+		} else {
+			selected_nodes.erase(parent);
+		}
+	}
+}
+
 //----------------------------------------------------------------------------------------
 /*
  * Called once, after program is signaled to terminate.
  */
 void Puppet::cleanup()
 {
-
+	for (const PendingPick & pick : m_pendingPicks) {
+		glDeleteSync(pick.fence);
+		m_freePickBuffers.push_back(pick.pixelBuffer);
+	}
+	m_pendingPicks.clear();
+	if (!m_freePickBuffers.empty()) {
+		glDeleteBuffers(GLsizei(m_freePickBuffers.size()), m_freePickBuffers.data());
+		m_freePickBuffers.clear();
+	}
+	m_idBuffer.destroy();
 }
 
 //----------------------------------------------------------------------------------------
@@ -832,6 +2534,11 @@ bool Puppet::mouseMoveEvent (
 	} else if (interactionMode == InteractionMode::JOINT) {
 		eventHandled = true;
 		applyJointTransform(xPos, yPos);
+		if (mouse_left_down && !marquee_active) {
+			double dx = xPos - marquee_start_x;
+			double dy = yPos - marquee_start_y;
+			marquee_active = dx * dx + dy * dy > MarqueeThreshold * MarqueeThreshold;
+		}
 	}
 	prev_mouse_x = xPos;
 	prev_mouse_y = yPos;
@@ -856,22 +2563,24 @@ bool Puppet::mouseButtonInputEvent (
 			if (button == GLFW_MOUSE_BUTTON_LEFT) {
 				mouse_left_down = true;
 				if (interactionMode == InteractionMode::JOINT) {
-					pickingSetup();
+					// A click picks on release; dragging further than
+					// MarqueeThreshold turns it into a box selection.
+					glfwGetCursorPos(m_window, &marquee_start_x, &marquee_start_y);
+					marquee_active = false;
 				}
 				eventHandled = true;
 			}
 			if (button == GLFW_MOUSE_BUTTON_MIDDLE) {
 				mouse_middle_down = true;
 				if (interactionMode == InteractionMode::JOINT) {
-					// on push, we want to save the current state of selected nodes
-					saveState();
+					beginJointEdit();
 				}
 				eventHandled = true;
 			}
 			if (button == GLFW_MOUSE_BUTTON_RIGHT) {
 				mouse_right_down = true;
 				if (interactionMode == InteractionMode::JOINT) {
-					saveState();
+					beginJointEdit();
 				}
 				eventHandled = true;
 			}
@@ -882,23 +2591,26 @@ bool Puppet::mouseButtonInputEvent (
 			mouse_dragging = false;
 			if (button == GLFW_MOUSE_BUTTON_LEFT) {
 				mouse_left_down = false;
+				if (interactionMode == InteractionMode::JOINT) {
+					if (marquee_active) {
+						double xpos, ypos;
+						glfwGetCursorPos(m_window, &xpos, &ypos);
+						boxSelect(marquee_start_x, marquee_start_y, xpos, ypos);
+					} else {
+						pickingSetup();
+					}
+					marquee_active = false;
+				}
 				eventHandled = true;
 			}
 			if (button == GLFW_MOUSE_BUTTON_MIDDLE) {
 				mouse_middle_down = false;
-
-				// on release, we should push the last state to the undo stack
-				undo_stack.push(cur_node_info);
-				redo_stack = stack<vector<NodeInfo>>();
-
+				endJointEdit();
 				eventHandled = true;
 			}
 			if (button == GLFW_MOUSE_BUTTON_RIGHT) {
 				mouse_right_down = false;
-				// 
-				undo_stack.push(cur_node_info);
-				redo_stack = stack<vector<NodeInfo>>();
-
+				endJointEdit();
 				eventHandled = true;
 			}
 		}
@@ -1011,7 +2723,16 @@ bool Puppet::keyInputEvent (
                 option_frontface = !option_frontface;
                 eventHandled = true;
                 break;
+            case GLFW_KEY_SPACE:
+                toggleAnimation();
+                eventHandled = true;
+                break;
             default:
+                // Number keys switch among the first nine stored poses.
+                if (key >= GLFW_KEY_1 && key <= GLFW_KEY_9) {
+                    applyPose(size_t(key - GLFW_KEY_1));
+                    eventHandled = true;
+                }
                 break;
         }
     }
@@ -1033,26 +2754,18 @@ void Puppet::resetOrientation() {
 }
 
 void Puppet::resetJoints() {
-    // TODO: clear the undo/redo stack.
-
+	// Deltas in the history no longer lead anywhere from the initial pose.
+	m_history.clear();
+	m_jointEditStart.clear();
 
-	// reset selected_nodes set
-	// reset joint transforms
-	queue<SceneNode*> q;
-	q.push(m_rootNode.get());
-	while (!q.empty()) {
-		SceneNode* curNode = q.front();
-		q.pop();
-		if (selected_nodes.find(curNode) != selected_nodes.end()) {
-			curNode->isSelected = false;
-			selected_nodes.erase(curNode);
-		}
-		// apply the initial node info
-		idToInitialNodeInfo[curNode->m_nodeId]->apply();
-		for (auto c : curNode->children) {
-			q.push(c);
-		}
+	// Picked GeometryNodes are flagged as well as their joints.
+	for (SceneNode * node : m_flatSceneGraph.nodes) {
+		node->isSelected = false;
 	}
+	selected_nodes.clear();
+
+	m_restPose.apply(m_jointTable);
+	m_currentPose = -1;
 }
 
 void Puppet::resetAll() {
@@ -1074,46 +2787,281 @@ void Puppet::resetAll() {
 	resetOrientation();
 	resetPosition();
 	resetJoints();
+}
 
-	do_picking = false;
-
+// Remember the angles of the selected joints as a drag starts.  Another button going
+// down mid-drag keeps the first start, so the whole drag stays one edit.
+void Puppet::beginJointEdit() {
+	if (!m_jointEditStart.empty()) {
+		return;
+	}
+	for (SceneNode * node : selected_nodes) {
+		m_jointEditStart.push_back(JointEditStart{ node, node->current_angle_y,
+				node->current_angle_z });
+	}
 }
 
-// save current joint states
-void Puppet::saveState() {
-	cur_node_info.clear();
+// Record how far each joint turned during the drag.  Drags repeated on the same joints
+// in quick succession are coalesced by m_history.
+void Puppet::endJointEdit() {
+	if (m_jointEditStart.empty() || mouse_middle_down || mouse_right_down) {
+		return;
+	}
 
-	// save currently selected node states
-	for (auto node : selected_nodes) {
-		NodeInfo copy(node);
-		cur_node_info.push_back(copy);
+	m_jointEditDeltas.clear();
+	for (const JointEditStart & start : m_jointEditStart) {
+		JointDelta delta;
+		delta.nodeId = start.node->m_nodeId;
+		delta.axisY = 1;
+		delta.degrees = float(start.node->current_angle_y - start.angleY);
+		m_jointEditDeltas.push_back(delta);
+		delta.axisY = 0;
+		delta.degrees = float(start.node->current_angle_z - start.angleZ);
+		m_jointEditDeltas.push_back(delta);
 	}
+	m_jointEditStart.clear();
+
+	m_history.record(m_jointEditDeltas, glfwGetTime());
+	m_currentPose = -1;
 }
 
+// Joint rotations only add to the angles of a JointNode, so undoing the newest entry
+// subtracts its deltas.  Deltas are resolved through m_jointTable, one array lookup each.
 void Puppet::undo() {
-	if (undo_stack.empty()) return;
-	vector<NodeInfo> undo_info = undo_stack.top();
-	undo_stack.pop();
-	saveState(); // save current state before undo
-	redo_stack.push(cur_node_info);
-	for (auto info : undo_info) {
-		info.apply();
-	}
+	m_currentPose = -1;
+	m_history.undo([this](const JointDelta & delta, float sign) {
+		JointNode * joint = m_jointTable.findByNodeId(delta.nodeId);
+		if (joint) {
+			joint->rotate(delta.axis(), sign * delta.degrees);
+		}
+	});
 }
 
 void Puppet::redo() {
-	if (redo_stack.empty()) return;
-	vector<NodeInfo> redo_info = redo_stack.top();
-	redo_stack.pop();
-	saveState(); // save current state before undo
-	undo_stack.push(cur_node_info);
-	for (auto info : redo_info) {
-		info.apply();
+	m_currentPose = -1;
+	m_history.redo([this](const JointDelta & delta, float sign) {
+		JointNode * joint = m_jointTable.findByNodeId(delta.nodeId);
+		if (joint) {
+			joint->rotate(delta.axis(), sign * delta.degrees);
+		}
+	});
+}
+
+
+
+//----------------------------------------------------------------------------------------
+// Store the current joint angles as a new pose.
+void Puppet::storePose() {
+	Pose pose;
+	pose.capture(m_jointTable);
+	m_currentPose = int(m_poseLibrary.store("Pose " + to_string(m_poseLibrary.size() + 1),
+			pose));
+}
+
+//----------------------------------------------------------------------------------------
+// Switch every joint to a stored pose.  The switch is recorded in m_history like a
+// drag, so it can be undone.
+void Puppet::applyPose(size_t index) {
+	if (index >= m_poseLibrary.size()
+			|| m_poseLibrary.poses[index].numJoints() != m_jointTable.size()) {
+		return;
+	}
+	const Pose & pose = m_poseLibrary.poses[index];
+
+	auto start = chrono::high_resolution_clock::now();
+	m_previousPose.capture(m_jointTable);
+	pose.apply(m_jointTable);
+	auto end = chrono::high_resolution_clock::now();
+	pose_switch_us = chrono::duration<double, micro>(end - start).count();
+
+	m_jointEditStart.clear();
+	m_jointEditDeltas.clear();
+	for (size_t i = 0; i < m_jointTable.size(); ++i) {
+		JointDelta delta;
+		delta.nodeId = m_jointTable.joints[i]->m_nodeId;
+		delta.axisY = 1;
+		delta.degrees = pose.angles[2 * i] - m_previousPose.angles[2 * i];
+		m_jointEditDeltas.push_back(delta);
+		delta.axisY = 0;
+		delta.degrees = pose.angles[2 * i + 1] - m_previousPose.angles[2 * i + 1];
+		m_jointEditDeltas.push_back(delta);
+	}
+	m_history.record(m_jointEditDeltas, glfwGetTime());
+	m_currentPose = int(index);
+}
+
+//----------------------------------------------------------------------------------------
+void Puppet::savePoses() {
+	if (m_poseLibrary.save(m_poseFile, m_jointTable)) {
+		cout << "Saved " << m_poseLibrary.size() << " poses to " << m_poseFile << endl;
+	} else {
+		cerr << "Could not save poses to " << m_poseFile << endl;
+	}
+}
+
+//----------------------------------------------------------------------------------------
+void Puppet::loadPoses() {
+	if (m_poseLibrary.load(m_poseFile, m_jointTable, m_restPose)) {
+		cout << "Loaded " << m_poseLibrary.size() << " poses from " << m_poseFile << endl;
+		m_currentPose = -1;
+	} else {
+		cerr << "Could not load poses from " << m_poseFile << endl;
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// Key every joint at the playhead with its current angles.
+void Puppet::keyCurrentPose() {
+	Pose pose;
+	pose.capture(m_jointTable);
+	m_clip.setKeys(animation_time, pose);
+}
+
+//----------------------------------------------------------------------------------------
+void Puppet::toggleAnimation() {
+	if (m_clip.numKeys() == 0) {
+		animation_playing = false;
+		return;
+	}
+	animation_playing = !animation_playing;
+	if (animation_playing && animation_time >= m_clip.duration()) {
+		animation_time = 0.0f;
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// Advance the playhead by one frame and pose the joints for it.
+void Puppet::updateAnimation(double frameSeconds) {
+	if (!animation_playing) {
+		return;
 	}
+	animation_time += float(frameSeconds);
+	const float duration = m_clip.duration();
+	if (animation_time > duration) {
+		if (option_loop_animation && duration > 0.0f) {
+			animation_time = fmod(animation_time, duration);
+		} else {
+			animation_time = duration;
+			animation_playing = false;
+		}
+	}
+	showAnimationFrame();
+}
+
+//----------------------------------------------------------------------------------------
+// Evaluate every track at animation_time in one pass and apply the result.  Joints
+// without keys keep their current angles.
+void Puppet::showAnimationFrame() {
+	auto start = chrono::high_resolution_clock::now();
+	m_animatedPose.capture(m_jointTable);
+	m_clip.evaluate(animation_time, m_animatedPose);
+	m_animatedPose.apply(m_jointTable);
+	auto end = chrono::high_resolution_clock::now();
+	animation_eval_us = chrono::duration<double, micro>(end - start).count();
+	m_currentPose = -1;
 }
 
 
+//----------------------------------------------------------------------------------------
+// Headless counterpart of CS488Window::launch(): one init(), then for each job a pose,
+// a camera and one draw() into the offscreen framebuffer.  Rendering and writing the
+// images are timed apart, so a slow disk does not hide the renderer's throughput.
+int Puppet::renderBatch(OffscreenContext & context, const std::string & jobFile,
+		const std::string & outputDirectory)
+{
+	vector<RenderJob> jobs;
+	if (!readRenderJobs(jobFile, jobs)) {
+		return 1;
+	}
+	if (mkdir(outputDirectory.c_str(), 0755) == -1 && errno != EEXIST) {
+		cerr << "Could not create " << outputDirectory << ": " << strerror(errno) << endl;
+		return 1;
+	}
+
+	m_windowWidth = m_framebufferWidth = context.width();
+	m_windowHeight = m_framebufferHeight = context.height();
+	init();
+
+	// "*" renders every stored pose, named after the job and the pose.
+	vector<RenderJob> expanded;
+	for (const RenderJob & job : jobs) {
+		if (job.pose != "*") {
+			expanded.push_back(job);
+			continue;
+		}
+		for (const string & name : m_poseLibrary.names) {
+			expanded.push_back(job);
+			expanded.back().output = job.output + "_" + imageFileName(name);
+			expanded.back().pose = name;
+		}
+	}
+	unordered_map<string, size_t> poseIndices;
+	for (size_t i = 0; i < m_poseLibrary.size(); ++i) {
+		poseIndices.emplace(m_poseLibrary.names[i], i);
+	}
+
+	// Every camera orbits the centre of the scene as loaded, so the images line up.
+	m_flatSceneGraph.updateDirtyWorldTransforms();
+	m_flatSceneGraph.updateSubtreeBounds();
+	const vec3 centre = m_flatSceneGraph.subtreeBounds.empty() ? vec3(0.0f)
+			: m_flatSceneGraph.subtreeBounds[0].center;
+
+	vector<uint8_t> pixels;
+	double renderSeconds = 0.0;
+	double writeSeconds = 0.0;
+	unsigned int numImages = 0;
+	for (const RenderJob & job : expanded) {
+		if (job.pose == "rest") {
+			m_restPose.apply(m_jointTable);
+		} else {
+			auto pose = poseIndices.find(job.pose);
+			if (pose == poseIndices.end()) {
+				cerr << "No pose named \"" << job.pose << "\" in " << m_poseFile
+					 << ", skipping " << job.output << endl;
+				continue;
+			}
+			m_poseLibrary.poses[pose->second].apply(m_jointTable);
+		}
+		puppet_translation = glm::translate(mat4(1.0f), vec3(0.0f, 0.0f, -job.dolly));
+		puppet_rotation = glm::translate(mat4(1.0f), centre)
+				* glm::rotate(mat4(1.0f), degreesToRadians(job.pitch), vec3(1.0f, 0.0f, 0.0f))
+				* glm::rotate(mat4(1.0f), degreesToRadians(job.yaw), vec3(0.0f, 1.0f, 0.0f))
+				* glm::translate(mat4(1.0f), -centre);
+
+		auto start = chrono::high_resolution_clock::now();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		uploadCommonSceneUniforms();
+		draw();
+		glFinish();
+		auto rendered = chrono::high_resolution_clock::now();
+
+		context.readPixels(pixels);
+		const string path = outputDirectory + "/" + job.output + ".ppm";
+		if (!writePpm(path, context.width(), context.height(), pixels.data())) {
+			cerr << "Could not write " << path << endl;
+			cleanup();
+			return 1;
+		}
+		auto written = chrono::high_resolution_clock::now();
 
+		renderSeconds += chrono::duration<double>(rendered - start).count();
+		writeSeconds += chrono::duration<double>(written - rendered).count();
+		++numImages;
+	}
+	cleanup();
+
+	cout << "Rendered " << numImages << " of " << expanded.size() << " images at "
+		 << context.width() << "x" << context.height() << " on " << context.renderer()
+		 << endl;
+	if (numImages > 0) {
+		cout << "  render:         " << renderSeconds << " s, "
+			 << numImages / renderSeconds << " frames/s, "
+			 << 1000.0 * renderSeconds / numImages << " ms/frame" << endl;
+		cout << "  render + write: " << renderSeconds + writeSeconds << " s, "
+			 << numImages / (renderSeconds + writeSeconds) << " frames/s" << endl;
+	}
+	return (numImages == expanded.size()) ? 0 : 1;
+}
 
 // =========================================== TRACKBALL ===================================================
 
@@ -8,6 +8,21 @@
 #include "cs488-framework/MeshConsolidator.hpp"
 
 #include "SceneNode.hpp"
+#include "FlatSceneGraph.hpp"
+#include "DrawList.hpp"
+#include "MeshRegistry.hpp"
+#include "MeshLoader.hpp"
+#include "VertexCompression.hpp"
+#include "MeshSimplifier.hpp"
+#include "PickingBvh.hpp"
+#include "IdBuffer.hpp"
+#include "UndoHistory.hpp"
+#include "Pose.hpp"
+#include "Animation.hpp"
+#include "MatrixKernels.hpp"
+#include "SkinnedMesh.hpp"
+#include "UniformBinding.hpp"
+#include "OffscreenContext.hpp"
 
 #include <glm/glm.hpp>
 #include <memory>
@@ -23,28 +38,87 @@ enum InteractionMode {
 	JOINT
 };
 
-// for undo redo
-struct NodeInfo {
-	SceneNode* node;
-	double cur_angle_y;
-	double cur_angle_z;
-	bool isSelected;
-	glm::mat4 transform;
-
-	NodeInfo(SceneNode* node) {
-		this->node = node;
-		cur_angle_y = node->current_angle_y;
-		cur_angle_z = node->current_angle_z;
-		isSelected = node->isSelected;
-		transform = node->get_transform();
-	}
-
-	void apply() {
-		node->current_angle_z = cur_angle_z;
-		node->current_angle_y = cur_angle_y;
-		node->isSelected = isSelected;
-		node->set_transform(transform);
-	}
+// How the scene graph is submitted each frame.
+enum RenderPath {
+	RECURSIVE,      // Recursive walk over SceneNode::children.
+	FLATTENED,      // Linear loop over FlatSceneGraph, one draw per GeometryNode.
+	SORTED,         // DrawList sorted by state, redundant state changes skipped.
+	INSTANCED,      // One glDrawElementsInstanced per mesh.
+	INDIRECT,       // One glMultiDrawElementsIndirect for the whole scene (GL 4.3).
+	SKINNED         // One draw of m_skinnedMesh, skinned to the JointNodes on the GPU.
+};
+
+// How each GeometryNode's level of detail is chosen.
+enum LodPolicy {
+	LOD_FULL,           // Always the full mesh.
+	LOD_SCREEN_SIZE,    // One level coarser each time the projected area halves.
+	LOD_SCREEN_ERROR    // Coarsest level whose simplification error covers under a pixel.
+};
+const unsigned int NumLodPolicies = 3;
+
+// How a left click in joint mode finds the GeometryNode under the cursor.  Every mode
+// tests the rigid GeometryNode meshes, also on the SKINNED path, so a pick near a
+// blended joint may hit the part whose rigid mesh lies under the cursor rather than the
+// skin drawn there.
+enum PickingMode {
+	GPU_READBACK,   // Render false colours and glReadPixels the cursor pixel.
+	GPU_ASYNC,      // Scissored false-colour pass read into a PBO, resolved frames later.
+	RAY_CAST        // Cast a ray through m_pickingBvh on the CPU.
+};
+
+// A GPU_ASYNC pick whose pixel is still on its way into pixelBuffer.
+struct PendingPick {
+	GLuint pixelBuffer;
+	GLsync fence;
+	std::chrono::high_resolution_clock::time_point clickTime;
+	unsigned int clickFrame;
+};
+
+// Per-instance data of one GeometryNode.  Padded to std430 layout so the same array
+// feeds the instanced vertex attributes and the indirect path's storage buffer.
+struct InstanceData {
+	glm::mat4 modelView;
+	glm::vec4 normalMatrix[3];    // Columns of transpose(inverse(mat3(modelView)))
+	glm::vec4 kd;
+	glm::vec4 ks;                 // w = shininess
+};
+
+// Per-frame submission counters.  State changes count program and VAO binds plus
+// material uploads.
+struct RenderStats {
+	unsigned int drawCalls = 0;
+	unsigned int stateChanges = 0;
+	unsigned int triangles = 0;
+	unsigned int fullDetailTriangles = 0;   // What the same draws cost at level 0
+	unsigned int lodDraws[MeshSimplifier::MaxLevels] = {};   // GeometryNodes per level
+	unsigned int policyTriangles[NumLodPolicies] = {};   // What each LodPolicy would draw
+};
+
+// Command layout consumed by glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// GeometryNodes sharing one mesh, drawn together with a single instanced draw call.
+struct InstanceBatch {
+	int meshHandle;
+	BatchInfo batchInfo;
+	std::vector<unsigned int> flatIndices;   // Indices into FlatSceneGraph::nodes
+};
+
+// Point on the trackball sphere of diameter pixels under (x, y), relative to its centre.
+// Points outside the sphere are clamped to its silhouette.
+glm::vec3 mapToSphere(float x, float y, float diameter);
+
+// Joint angles when a joint drag started, to turn into UndoHistory deltas on release.
+struct JointEditStart {
+	SceneNode * node;
+	double angleY;
+	double angleZ;
 };
 
 class Puppet : public CS488Window {
@@ -54,6 +128,12 @@ public:
 
 	const float translationScale = 0.01f;
 
+	// Render every job of jobFile into the framebuffer of context and write each image
+	// to outputDirectory.  No window is needed: init() and draw() are called directly,
+	// events and the GUI are skipped.  Prints the throughput and returns the exit code.
+	int renderBatch(OffscreenContext & context, const std::string & jobFile,
+			const std::string & outputDirectory);
+
 protected:
 	virtual void init() override;
 	virtual void appLogic() override;
@@ -68,14 +148,48 @@ protected:
     void resetAll();
 
 	// undo redo
-	void saveState();
+	void beginJointEdit();
+	void endJointEdit();
     void undo();
     void redo();
 
-	// data for undo/redo
-	std::vector<NodeInfo> cur_node_info;
-	std::stack<std::vector<NodeInfo>> redo_stack;
-	std::stack<std::vector<NodeInfo>> undo_stack;
+	// Joint rotations as deltas, bounded to m_history.maxBytes().  A middle or right
+	// drag in joint mode is one edit, from beginJointEdit() to endJointEdit().
+	UndoHistory m_history;
+	std::vector<JointEditStart> m_jointEditStart;
+	std::vector<JointDelta> m_jointEditDeltas;   // Scratch for endJointEdit()
+
+	// Poses
+	void storePose();
+	void applyPose(size_t index);
+	void savePoses();
+	void loadPoses();
+
+	// Dense joint index over m_flatSceneGraph, the pose the scene was loaded in, and
+	// the stored poses, kept in m_poseFile next to the Lua scene.  Switching to a pose
+	// is one pass over a contiguous array of angles and is recorded as one edit.
+	JointTable m_jointTable;
+	Pose m_restPose;
+	Pose m_previousPose;                         // Scratch for applyPose()
+	PoseLibrary m_poseLibrary;
+	std::string m_poseFile;
+	int m_currentPose = -1;                      // -1 once joints are edited
+	double pose_switch_us = -1.0;
+
+	// Keyframe animation
+	void keyCurrentPose();
+	void toggleAnimation();
+	void updateAnimation(double frameSeconds);
+	void showAnimationFrame();
+
+	// One track per joint of m_jointTable, played back from appLogic().  Keys are set
+	// from the current joint angles at animation_time.
+	AnimationClip m_clip;
+	Pose m_animatedPose;
+	bool animation_playing = false;
+	bool option_loop_animation = true;
+	float animation_time = 0.0f;
+	double animation_eval_us = -1.0;
 
 	//-- Virtual callback methods
 	virtual bool cursorEnterWindowEvent(int entered) override;
@@ -88,17 +202,47 @@ protected:
 	//-- One time initialization methods:
 	void processLuaSceneFile(const std::string & filename);
 	void createShaderProgram();
+	void reloadShaders();
 	void enableVertexShaderInputSlots();
-	void uploadVertexDataToVbos(const MeshConsolidator & meshConsolidator);
+	void loadSceneMeshes();
+	void reloadMeshes();
+	void loadMeshes(BatchInfoMap & batchInfoMap,
+			std::unordered_map<std::string, glm::mat4> & positionTransforms,
+			std::unordered_map<std::string, BoundingSphere> & meshBounds,
+			LodBatchMap & lodBatchMap);
+	void uploadVertexDataToVbos(const std::vector<std::unique_ptr<LoadedMesh>> & meshes,
+			const std::vector<QuantizationBounds> & bounds, size_t numVertices,
+			size_t numIndices);
+	void createStreamingBuffers();
 	void mapVboDataToVertexShaderInputLocations();
+	void mapMeshVertexAttributes(GLint positionAttribLocation, GLint normalAttribLocation);
 	void initViewMatrix();
 	void initLightSources();
-	void initNodeInfo(SceneNode *node);
 
 	void initPerspectiveMatrix();
 	void uploadCommonSceneUniforms();
+	void uploadCommonSceneUniforms(const ShaderProgram & shader,
+			const MeshShaderUniforms & uniforms);
+	void buildInstanceBatches();
+	void buildIndirectCommands();
+	void gatherInstanceData(const glm::mat4 & viewTransform);
+	void updateModelViews(const glm::mat4 & viewTransform);
 	void renderSceneGraph(const SceneNode &node);
-	void renderSceneNode(const SceneNode* node, const glm::mat4 parentTransform);
+	void cullSceneGraph(const glm::mat4 & viewTransform);
+	unsigned int selectLod(const GeometryNode & node, const glm::mat4 & modelView) const;
+	float lodPixelsPerUnit(int meshHandle, const glm::mat4 & modelView) const;
+	unsigned int lodForScale(int meshHandle, float pixelsPerUnit, LodPolicy policy) const;
+	void countTriangles(int meshHandle, unsigned int level, unsigned int instances);
+	void countPolicyTriangles(const GeometryNode & node, const glm::mat4 & modelView,
+			unsigned int level);
+	void renderSceneNode(const SceneNode* node, const glm::mat4 viewTransform);
+	void renderFlatSceneGraph(const glm::mat4 & viewTransform);
+	void renderDrawList(const glm::mat4 & viewTransform);
+	void renderInstancedSceneGraph(const glm::mat4 & viewTransform);
+	void renderIndirectSceneGraph(const glm::mat4 & viewTransform);
+	void uploadSkinnedMesh();
+	void renderSkinnedMesh(const glm::mat4 & viewTransform);
+	void mapInstanceDataToVertexShaderInputLocations(size_t firstInstance);
 	void renderArcCircle();
 
 	// Helper methods
@@ -108,10 +252,22 @@ protected:
 	void handleInteractionMode();
 	void applyJointTransform(double xPos, double yPos);
 	void pickingSetup();
+	glm::mat4 sceneViewTransform() const;
+	SceneNode * pickNodeGpu(double xPos, double yPos);
+	SceneNode * pickNodeCpu(double xPos, double yPos);
+	void toggleSelection(SceneNode * pickedNode);
+	void windowToFramebufferPixel(double xPos, double yPos, int & pixelX, int & pixelY) const;
+	void updateFlatWorldTransforms();
+	void renderIdPass(int x, int y, int width, int height);
+	SceneNode * geometryNodeById(uint32_t id);
+	void boxSelect(double x0, double y0, double x1, double y1);
+	void renderMarquee();
+	void issueAsyncPick(double xPos, double yPos);
+	void resolveAsyncPicks();
+	void benchmarkTransformEvaluation();
 
 	std::unordered_set<SceneNode*> selected_nodes;
 	std::unordered_map<int, SceneNode*> idToSceneNode;
-	std::unordered_map<int, NodeInfo*> idToInitialNodeInfo;
 
 	glm::mat4 m_perpsective;
 	glm::mat4 m_view;
@@ -122,30 +278,133 @@ protected:
 	GLuint m_vao_meshData;
 	GLuint m_vbo_vertexPositions;
 	GLuint m_vbo_vertexNormals;
+	GLuint m_vbo_vertexCompact;      // Interleaved vertices of a compact vertexFormat
+	GLuint m_ibo_indices;            // Every mesh's triangles, as absolute vertex indices
 	GLint m_positionAttribLocation;
 	GLint m_normalAttribLocation;
 	ShaderProgram m_shader;
+	MeshShaderUniforms m_meshUniforms;
+
+	//-- GL resources for instanced mesh rendering:
+	GLuint m_vao_instanced;
+	GLuint m_vbo_instanceData;
+	GLint m_inst_positionAttribLocation;
+	GLint m_inst_normalAttribLocation;
+	GLint m_inst_modelViewAttribLocation;
+	GLint m_inst_normalMatrixAttribLocation;
+	GLint m_inst_kdAttribLocation;
+	GLint m_inst_ksAttribLocation;
+	GLint m_inst_shininessAttribLocation;
+	ShaderProgram m_shader_instanced;
+	MeshShaderUniforms m_instancedUniforms;
+	std::vector<InstanceBatch> m_instanceBatches;
+	// Unculled instances per batch and level of detail this frame, MaxLevels per batch.
+	// Records of one batch and level are contiguous in m_instanceData.
+	std::vector<GLuint> m_instanceCounts;
+	std::vector<InstanceData> m_instanceData;
+
+	//-- GL resources for multi-draw indirect rendering (GL 4.3 only):
+	bool m_supportsIndirect;
+	bool m_indirectCommandsDirty;    // Set whenever m_instanceBatches changes.
+	GLuint m_vao_indirect;
+	GLuint m_vbo_drawIndex;          // 0..n-1, read with divisor 1 as the draws[] index
+	GLuint m_ssbo_drawData;
+	GLuint m_buffer_indirectCommands;
+	GLint m_indirect_positionAttribLocation;
+	GLint m_indirect_normalAttribLocation;
+	GLint m_indirect_drawIndexAttribLocation;
+	ShaderProgram m_shader_indirect;
+	MeshShaderUniforms m_indirectUniforms;
+	std::vector<DrawElementsIndirectCommand> m_indirectCommands;
+
+	//-- GL resources for the skinned mesh.  The bone palette and part materials are
+	//-- streamed to texture buffers every frame:
+	SkinnedMesh m_skinnedMesh;
+	GLuint m_vao_skinned;
+	GLuint m_vbo_skinnedVertices;
+	GLuint m_ibo_skinnedIndices;
+	GLuint m_tbo_bonePalette;        // Storage of m_tex_bonePalette
+	GLuint m_tex_bonePalette;
+	GLuint m_tbo_materialPalette;    // Storage of m_tex_materialPalette
+	GLuint m_tex_materialPalette;
+	GLint m_skin_positionAttribLocation;
+	GLint m_skin_normalAttribLocation;
+	GLint m_skin_bonesAttribLocation;
+	GLint m_skin_weightsAttribLocation;
+	GLint m_skin_partAttribLocation;
+	ShaderProgram m_shader_skinned;
+	MeshShaderUniforms m_skinnedUniforms;
+	std::vector<glm::vec4> m_materialPalette;   // kd, then ks and shininess, per part
 
 	//-- GL resources for trackball circle geometry:
 	GLuint m_vbo_arcCircle;
 	GLuint m_vao_arcCircle;
 	GLint m_arc_positionAttribLocation;
 	ShaderProgram m_shader_arcCircle;
+	ArcShaderUniforms m_arcUniforms;
 
-	// BatchInfoMap is an associative container that maps a unique MeshId to a BatchInfo
-	// object. Each BatchInfo object contains an index offset and the number of indices
-	// required to render the mesh with identifier MeshId.
-	BatchInfoMap m_batchInfoMap;
+	//-- GL resources for the box selection outline, drawn with m_shader_arcCircle:
+	GLuint m_vao_marquee;
+	GLuint m_vbo_marquee;
+
+	//-- GL resources for the ID pass, used by GPU picking and box selection:
+	IdBuffer m_idBuffer;
+	GLuint m_vao_id;
+	GLint m_id_positionAttribLocation;
+	ShaderProgram m_shader_id;
+	IdShaderUniforms m_idUniforms;
+
+	// Maps each loaded mesh to a dense handle and its BatchInfo (index offset and number
+	// of indices).  GeometryNodes store the handle, resolved once after loading.  Shared
+	// so that several scenes can draw from the same mesh data.
+	std::shared_ptr<MeshRegistry> m_meshRegistry;
 
 	std::string m_luaSceneFile;
 
 	std::shared_ptr<SceneNode> m_rootNode;
 
+	// Linearized copy of m_rootNode, rebuilt whenever the scene is loaded.
+	FlatSceneGraph m_flatSceneGraph;
+
+	// ModelView and normal matrices of the frame being drawn, indexed like
+	// m_flatSceneGraph.nodes.  Filled by updateModelViews() for the flat paths.
+	std::vector<glm::mat4> m_modelViews;
+	std::vector<NormalMatrix> m_normalMatrices;
+
+	// Sorted GeometryNode draws over m_flatSceneGraph, rebuilt with it.
+	DrawList m_drawList;
+
+	// Culling of the frame being drawn.  m_visibleNodes is indexed like
+	// m_flatSceneGraph.nodes and set for every GeometryNode that the flat paths draw;
+	// the recursive path tests SceneNode::m_subtreeBounds against m_frustum instead.
+	Frustum m_frustum;
+	std::vector<char> m_visibleNodes;
+	std::vector<char> m_idPassVisibleNodes;
+	CullResult m_cullResult;
+
+	// World-space bounds of the GeometryNodes of m_flatSceneGraph plus a CPU copy of
+	// their triangles.  Rebuilt with the meshes, refit before every ray-cast pick.
+	PickingBvh m_pickingBvh;
+
+	// GPU_ASYNC picks in click order.  Only the front one may resolve, so selections
+	// toggle in the order the clicks happened.
+	std::deque<PendingPick> m_pendingPicks;
+	std::vector<GLuint> m_freePickBuffers;
+	unsigned int m_frameCount;
+	std::chrono::high_resolution_clock::time_point m_lastFrameTime;
+
 	// UI State
 	bool option_circle = false;
 	bool option_zbuffer = true;      // Default enabled.
 	bool option_backface = false;
 	bool option_frontface = false;
+	RenderPath renderPath = FLATTENED;
+	VertexFormat vertexFormat = VERTEX_FLOAT32;   // Changing it reloads every mesh.
+	bool option_cached_uniforms = true;  // Off: look uniforms up by name on every draw.
+	bool option_frustum_culling = true;
+	LodPolicy lodPolicy = LOD_SCREEN_SIZE;
+	PickingMode pickingMode = GPU_READBACK;
+	bool option_compare_picking = false;  // Run both pickers and report disagreements.
 	InteractionMode interactionMode = POSITION;
 
 	// Global transform (entire scene graph)
@@ -158,5 +417,65 @@ protected:
 	bool mouse_left_down, mouse_middle_down, mouse_right_down;
     double prev_mouse_x, prev_mouse_y;
 
+	// Box selection in joint mode.  A left drag becomes a box once the cursor has moved
+	// MarqueeThreshold pixels from where the button went down.
+	static constexpr double MarqueeThreshold = 4.0;
+	bool marquee_active = false;
+	double marquee_start_x = 0.0, marquee_start_y = 0.0;
+
+	// Level of detail selection.  LOD_SCREEN_SIZE draws the full mesh while its bounding
+	// sphere spans at least LodFullDetailPixels; LOD_SCREEN_ERROR keeps simplification
+	// error under LodMaxErrorPixels.  Both only switch once past the threshold by
+	// LodHysteresis.
+	static constexpr float LodFullDetailPixels = 256.0f;
+	static constexpr float LodMaxErrorPixels = 1.0f;
+	static constexpr float LodHysteresis = 0.15f;
+
+	// Vertices within this fraction of their part's radius of a joint are blended with
+	// the bone on the other side when the skinned mesh is built.
+	static constexpr float SkinBlendFraction = 0.25f;
+
+	// Average time (microseconds) of one full transform evaluation, per path.
+	double bench_recursive_us = 0.0;
+	double bench_flat_us = 0.0;
+
+	size_t vertex_buffer_bytes = 0;
+
+	// Time (microseconds) to build and stream the bone palette of the last SKINNED frame.
+	double skin_palette_us = -1.0;
+
+	// Latency (milliseconds) of the most recent pick with each PickingMode, -1 before
+	// the first one.
+	double pick_gpu_ms = -1.0;
+	double pick_cpu_ms = -1.0;
+	unsigned int pick_leaves_refit = 0;
+
+	// GPU_ASYNC: time spent in the click handler, and click-to-selection latency.
+	double pick_async_issue_ms = -1.0;
+	double pick_async_latency_ms = -1.0;
+	unsigned int pick_async_latency_frames = 0;
+
+	// Last box selection: joints selected, distinct ids read back, pixels covered.
+	double box_select_ms = -1.0;
+	unsigned int box_select_joints = 0;
+	unsigned int box_select_ids = 0;
+	unsigned int box_select_pixels = 0;
+
+	// Draw calls of the last ID pass.  Kept out of m_renderStats so picks do not skew
+	// the render path comparison.
+	unsigned int id_pass_draws = 0;
+
+	// Duration of the last frame that handled a pick, against a running average of
+	// all frames, to show the stall a pick adds.
+	bool pick_in_frame = false;
+	double pick_frame_ms = -1.0;
+	double average_frame_ms = 0.0;
+
+	unsigned int recomputed_nodes_last_frame = 0;
+	unsigned int uniform_uploads_last_frame = 0;
+	unsigned int uniform_lookups_last_frame = 0;
+	RenderStats m_renderStats;
+	RenderStats render_stats_last_frame;
+
 
 };